@@ -0,0 +1,417 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <glad/glad.h>
+#include <glfw3.h>
+
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "mesh.h"
+#include "mesh_file.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// background asset loading
+// ------------------------
+// load() only queues the file; the frame never waits for it. Reader threads map it, validate it,
+// fault its pages in and build the CPU side (describeMesh), at most READ_AHEAD assets ahead of the
+// uploads. One upload thread owns a second context, shared with the window's, on a hidden 1x1
+// window: it fills the vertex and index buffers there in UPLOAD_CHUNK_BYTES pieces, flushing after
+// each so the copies interleave with the frames' work instead of arriving as one big batch, paced to
+// uploadBytesPerSecond, and ends every asset with a fence. poll() on the GL thread checks those
+// fences without waiting: an asset whose fence has signalled gets its GpuBuffers and its VAO (VAOs
+// aren't shared between contexts) and is usable from that frame on. At most MAX_IN_FLIGHT assets sit
+// uploaded but not yet picked up, so a stalled GL thread holds the uploads back too.
+//
+// The upload context sees none of glState (the cache shadows the window's context only) and makes
+// its own raw binds; the GL entry points glad loaded for the window's context serve it as well,
+// both having the same pixel format on the same driver. start() and stop() belong to the main
+// thread (GLFW creates and destroys windows only there), poll() and release() to the GL thread;
+// mesh() and state() can be asked from any thread.
+class AssetLoader
+{
+public:
+	static const uint32_t INVALID_ASSET = 0xFFFFFFFFu;
+	static const size_t UPLOAD_CHUNK_BYTES = 1 << 20;
+	static const size_t READ_AHEAD = 4;
+	static const size_t MAX_IN_FLIGHT = 4;
+
+	enum AssetState
+	{
+		ASSET_LOADING,
+		ASSET_READY,
+		ASSET_FAILED,
+		ASSET_RELEASED
+	};
+
+	struct Stats
+	{
+		uint32_t requested = 0;
+		uint32_t ready = 0;
+		uint32_t failed = 0;
+		uint64_t readBytes = 0;
+		uint64_t uploadedBytes = 0;
+	};
+
+	// with shareWith's context current; false when no shared context could be made
+	bool start(GLFWwindow* shareWith, int readerThreads, size_t uploadBytesPerSecond)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		uploadWindow = glfwCreateWindow(1, 1, "uploads", NULL, shareWith);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (uploadWindow == NULL)
+		{
+			std::cout << "ERROR::ASSET_LOADER::SHARED_CONTEXT_FAILED" << std::endl;
+			return false;
+		}
+		bytesPerSecond = uploadBytesPerSecond;
+		quit = false;
+		uploaded.reserve(MAX_IN_FLIGHT);
+		for (int i = 0; i < (readerThreads > 0 ? readerThreads : 1); i++)
+		{
+			readers.emplace_back([this] { readLoop(); });
+		}
+		uploader = std::thread([this] { uploadLoop(); });
+		return true;
+	}
+
+	// with the window's context current again: whatever is still queued is dropped, every mesh goes
+	void stop()
+	{
+		if (uploadWindow == NULL)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		changed.notify_all();
+		for (std::thread& reader : readers)
+		{
+			reader.join();
+		}
+		readers.clear();
+		uploader.join();
+
+		// uploads nobody picked up: their buffers never became GpuObjects
+		for (Asset* asset : uploaded)
+		{
+			glDeleteSync(asset->fence);
+			glState.deleteBuffers(2, asset->buffers);
+		}
+		uploaded.clear();
+		readQueue.clear();
+		uploadQueue.clear();
+		for (std::unique_ptr<Asset>& asset : assets)
+		{
+			destroyMesh(asset->mesh);
+		}
+		assets.clear();
+		glfwDestroyWindow(uploadWindow);
+		uploadWindow = NULL;
+	}
+
+	// queue a .crmesh; its handle reads ASSET_LOADING until poll() has made it usable (or it failed)
+	uint32_t loadMesh(const std::string& path)
+	{
+		if (uploadWindow == NULL)
+		{
+			return INVALID_ASSET;
+		}
+		std::unique_ptr<Asset> asset(new Asset());
+		asset->path = path;
+		std::lock_guard<std::mutex> lock(mutex);
+		readQueue.push_back(asset.get());
+		assets.push_back(std::move(asset));
+		requested++;
+		pending.fetch_add(1, std::memory_order_relaxed);
+		changed.notify_all();
+		return (uint32_t)assets.size() - 1;
+	}
+
+	// GL thread, once per frame: adopt every upload the GPU is done with; how many became usable
+	int poll()
+	{
+		int arrived = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < uploaded.size();)
+		{
+			Asset* asset = uploaded[i];
+			GLenum status = glClientWaitSync(asset->fence, 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED)
+			{
+				i++;
+				continue;
+			}
+			uploaded.erase(uploaded.begin() + i);
+			glDeleteSync(asset->fence);
+			asset->fence = NULL;
+			if (status == GL_WAIT_FAILED)
+			{
+				glState.deleteBuffers(2, asset->buffers);
+				fail(*asset);
+				continue;
+			}
+			finish(*asset);
+			arrived++;
+		}
+		if (arrived > 0)
+		{
+			changed.notify_all();
+		}
+		return arrived;
+	}
+
+	// GL thread: the mesh is retired (once frames drawing it are done); one still loading goes when it arrives
+	void release(uint32_t handle)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (handle >= assets.size())
+		{
+			return;
+		}
+		Asset& asset = *assets[handle];
+		asset.released = true;
+		if (asset.state.load(std::memory_order_acquire) == ASSET_READY)
+		{
+			destroyMesh(asset.mesh);
+			asset.state.store(ASSET_RELEASED, std::memory_order_release);
+		}
+	}
+
+	AssetState state(uint32_t handle) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return handle < assets.size() ? (AssetState)assets[handle]->state.load(std::memory_order_acquire) : ASSET_FAILED;
+	}
+
+	// the mesh once it is ready, NULL until then (it stays put until release() or stop())
+	const Mesh* mesh(uint32_t handle) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (handle >= assets.size() || assets[handle]->state.load(std::memory_order_acquire) != ASSET_READY)
+		{
+			return NULL;
+		}
+		return &assets[handle]->mesh;
+	}
+
+	// nothing queued, reading or uploading
+	bool isIdle() const
+	{
+		return pending.load(std::memory_order_acquire) == 0;
+	}
+
+	Stats stats() const
+	{
+		Stats result;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			result.requested = requested;
+		}
+		result.ready = ready.load(std::memory_order_relaxed);
+		result.failed = failed.load(std::memory_order_relaxed);
+		result.readBytes = readBytes.load(std::memory_order_relaxed);
+		result.uploadedBytes = uploadedBytes.load(std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	static const size_t PAGE_BYTES = 4096;
+
+	struct Asset
+	{
+		std::string path;
+		MeshFile file;					// mapped from the read until the upload is done
+		MeshFileHeader info = {};
+		Mesh mesh;
+		unsigned int buffers[2] = {};	// vertex, index: named on the upload context, adopted by poll()
+		size_t bytes[2] = {};
+		GLsync fence = NULL;
+		std::atomic<int> state { ASSET_LOADING };
+		bool released = false;			// GL thread
+	};
+
+	GLFWwindow* uploadWindow = NULL;
+	size_t bytesPerSecond = 0;
+	std::vector<std::unique_ptr<Asset>> assets;
+	std::deque<Asset*> readQueue;
+	std::deque<Asset*> uploadQueue;		// read, waiting for the upload thread
+	std::vector<Asset*> uploaded;		// fenced, waiting for poll()
+	size_t reading = 0;
+	uint32_t requested = 0;
+	bool quit = false;
+	std::atomic<uint32_t> pending { 0 };
+	std::atomic<uint32_t> ready { 0 };
+	std::atomic<uint32_t> failed { 0 };
+	std::atomic<uint64_t> readBytes { 0 };
+	std::atomic<uint64_t> uploadedBytes { 0 };
+
+	std::vector<std::thread> readers;
+	std::thread uploader;
+	mutable std::mutex mutex;
+	std::condition_variable changed;
+
+	// GL thread, under the lock: the buffers are complete, give them owners and a VAO
+	void finish(Asset& asset)
+	{
+		Mesh& mesh = asset.mesh;
+		mesh.VBO.adopt(asset.buffers[0], GPU_CATEGORY_MESH, asset.bytes[0]);
+		mesh.EBO.adopt(asset.buffers[1], GPU_CATEGORY_MESH, asset.bytes[1]);
+		createMeshVertexArray(asset.info, mesh);
+		ready.fetch_add(1, std::memory_order_relaxed);
+		if (asset.released)
+		{
+			destroyMesh(mesh);
+			asset.state.store(ASSET_RELEASED, std::memory_order_release);
+		}
+		else
+		{
+			asset.state.store(ASSET_READY, std::memory_order_release);
+		}
+		pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	void fail(Asset& asset)
+	{
+		asset.file.close();
+		failed.fetch_add(1, std::memory_order_relaxed);
+		asset.state.store(ASSET_FAILED, std::memory_order_release);
+		pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	// touch every page, so the upload thread's copies don't wait on the disk
+	static void prefetch(const void* data, size_t size)
+	{
+		const volatile unsigned char* bytes = (const volatile unsigned char*)data;
+		for (size_t i = 0; i < size; i += PAGE_BYTES)
+		{
+			(void)bytes[i];
+		}
+	}
+
+	void readLoop()
+	{
+		while (true)
+		{
+			Asset* asset = NULL;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return quit || (!readQueue.empty() && uploadQueue.size() + reading < READ_AHEAD); });
+				if (quit)
+				{
+					return;
+				}
+				asset = readQueue.front();
+				readQueue.pop_front();
+				reading++;
+			}
+
+			bool opened = asset->file.open(asset->path);
+			if (opened)
+			{
+				asset->info = asset->file.info();
+				describeMesh(asset->file, asset->mesh);
+				asset->bytes[0] = asset->file.vertexBytes();
+				asset->bytes[1] = asset->file.indexBytes();
+				prefetch(asset->file.vertexData(), asset->bytes[0]);
+				prefetch(asset->file.indexData(), asset->bytes[1]);
+				readBytes.fetch_add(asset->bytes[0] + asset->bytes[1], std::memory_order_relaxed);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				reading--;
+				if (opened)
+				{
+					uploadQueue.push_back(asset);
+				}
+				else
+				{
+					fail(*asset);
+				}
+			}
+			changed.notify_all();
+		}
+	}
+
+	void uploadLoop()
+	{
+		glfwMakeContextCurrent(uploadWindow);
+		Clock::time_point paced = Clock::now();
+		while (true)
+		{
+			Asset* asset = NULL;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return quit || (!uploadQueue.empty() && uploaded.size() < MAX_IN_FLIGHT); });
+				if (quit)
+				{
+					break;
+				}
+				asset = uploadQueue.front();
+				uploadQueue.pop_front();
+			}
+			changed.notify_all();
+
+			const unsigned char* streams[2] = { (const unsigned char*)asset->file.vertexData(), (const unsigned char*)asset->file.indexData() };
+			glGenBuffers(2, asset->buffers);
+			for (int i = 0; i < 2; i++)
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, asset->buffers[i]);
+				glBufferData(GL_COPY_WRITE_BUFFER, asset->bytes[i], NULL, GL_STATIC_DRAW);
+				for (size_t offset = 0; offset < asset->bytes[i]; offset += UPLOAD_CHUNK_BYTES)
+				{
+					size_t count = asset->bytes[i] - offset < UPLOAD_CHUNK_BYTES ? asset->bytes[i] - offset : UPLOAD_CHUNK_BYTES;
+					pace(paced, count);
+					glBufferSubData(GL_COPY_WRITE_BUFFER, offset, count, streams[i] + offset);
+					glFlush();
+					uploadedBytes.fetch_add(count, std::memory_order_relaxed);
+				}
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			// glBufferSubData has taken its copy, the mapping can go
+			asset->file.close();
+			asset->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			// another context only ever sees the fence signal once it has been flushed to the GPU
+			glFlush();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			uploaded.push_back(asset);
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+
+	// hold the uploads to bytesPerSecond on average (0: as fast as they go); idle time is banked for
+	// at most a tenth of a second, so a burst after a quiet spell stays short
+	void pace(Clock::time_point& budget, size_t bytes)
+	{
+		if (bytesPerSecond == 0)
+		{
+			return;
+		}
+		Clock::time_point now = Clock::now();
+		Clock::time_point earliest = now - std::chrono::milliseconds(100);
+		budget = budget < earliest ? earliest : budget;
+		budget += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double)bytes / bytesPerSecond));
+		if (budget > now)
+		{
+			std::this_thread::sleep_until(budget);
+		}
+	}
+};
+
+#endif
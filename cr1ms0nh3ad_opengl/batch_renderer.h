@@ -0,0 +1,517 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "gpu_culling.h"
+#include "mesh_file.h"
+#include "ring_buffer.h"
+#include "staging_buffer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// first-fit allocator over [0, capacity) with free range merging
+// ---------------------------------------------------------------
+class RangeAllocator
+{
+public:
+	static const uint32_t INVALID = 0xFFFFFFFFu;
+
+	void init(uint32_t size)
+	{
+		capacity = size;
+		available.clear();
+		available.push_back({ 0, size });
+	}
+
+	uint32_t allocate(uint32_t count)
+	{
+		for (size_t i = 0; i < available.size(); i++)
+		{
+			Range& range = available[i];
+			if (range.count >= count)
+			{
+				uint32_t offset = range.offset;
+				range.offset += count;
+				range.count -= count;
+				if (range.count == 0)
+				{
+					available.erase(available.begin() + i);
+				}
+				return offset;
+			}
+		}
+		return INVALID;
+	}
+
+	void release(uint32_t offset, uint32_t count)
+	{
+		size_t i = 0;
+		while (i < available.size() && available[i].offset < offset)
+		{
+			i++;
+		}
+		available.insert(available.begin() + i, { offset, count });
+
+		// merge with the neighbours on either side
+		if (i + 1 < available.size() && available[i].offset + available[i].count == available[i + 1].offset)
+		{
+			available[i].count += available[i + 1].count;
+			available.erase(available.begin() + i + 1);
+		}
+		if (i > 0 && available[i - 1].offset + available[i - 1].count == available[i].offset)
+		{
+			available[i - 1].count += available[i].count;
+			available.erase(available.begin() + i);
+		}
+	}
+
+private:
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+	uint32_t capacity = 0;
+	std::vector<Range> available;
+};
+
+// GL's indirect draw record, laid out exactly as glMultiDrawElementsIndirect reads it
+// -----------------------------------------------------------------------------------
+struct DrawElementsIndirectCommand
+{
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// per-draw data, std430 layout, read by the batch vertex shader as draws[drawId]
+// ------------------------------------------------------------------------------
+struct BatchDrawData
+{
+	float transform[4];		// x, y, scale, rotation
+	float color[4];
+	uint32_t texture;		// TextureTable entry, TextureTable::NO_TEXTURE for plain color
+	uint32_t padding[3];
+};
+
+// multi-draw indirect batch renderer
+// ----------------------------------
+// All meshes share one vertex buffer and one (16 bit) index buffer, suballocated per mesh, so any
+// mix of them can go out in a single glMultiDrawElementsIndirect. Each frame begin() takes room for
+// the indirect commands and the BatchDrawData array from the frame ring buffer, add() writes one of
+// each straight into it, and submit() just binds those ranges and issues one call. The draw
+// id is the old base-instance trick: command i has baseInstance = i and a divisor-1 attribute
+// (location 3) reads a 0, 1, 2... buffer, so the shader gets i without ARB_shader_draw_parameters
+// and indexes the per-draw SSBO (binding 0) with it. CPU cost per object is two struct writes.
+// With culling (begin(ring, true), when GL 4.3 compute is there) add() only writes the object, and
+// cull() lets GpuCuller build the commands on the GPU from what survives the frustum and the depth
+// pyramid; the batch then draws with depth testing so the pyramid has something to work with.
+// Meshes keep their levels of detail (from the mesh file) and every object draws the one selectLod()
+// picks for its scale, on the CPU or in the cull pass; while it cross-fades it takes two draws, so
+// the command space is twice maxDraws and the fragment shader has to honour the dither coverage in
+// the color's alpha (see selectLod). Textures are picked the same way, by a TextureTable entry in the
+// per-draw data, so a textured batch still binds nothing between draws. Vertices are half float
+// positions as they are, not relative to each mesh's box: the batch has one layout for every mesh,
+// and its shapes are unit sized, where halves are finer than a pixel.
+// Needs GL 4.3; isSupported() is false otherwise and nothing is created.
+class BatchRenderer
+{
+public:
+	static const unsigned int DRAW_ID_LOCATION = 3;
+	static const unsigned int DRAW_DATA_BINDING = 0;
+	static const uint32_t VERTEX_STRIDE = 4 * sizeof(uint16_t);	// position only, half floats (+ padding)
+	static const uint32_t INVALID_MESH = 0xFFFFFFFFu;
+
+	struct MeshRange
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		uint32_t baseVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t lodCount = 0;
+		MeshLod lods[MESH_MAX_LODS] = {};	// firstIndex absolute in the shared index buffer
+		float radius = 0.0f;				// bounding sphere around the mesh origin
+		bool live = false;
+	};
+
+	bool init(uint32_t maxVertices, uint32_t maxIndices, uint32_t maxDraws, StagingBuffer& stagingBuffer)
+	{
+		if (!glext::multiDrawIndirect)
+		{
+			std::cout << "BATCH_RENDERER::UNSUPPORTED (needs GL 4.3)" << std::endl;
+			return false;
+		}
+		staging = &stagingBuffer;
+		drawCapacity = maxDraws;
+		commandCapacity = maxDraws * 2;
+		vertexSpace.init(maxVertices);
+		indexSpace.init(maxIndices);
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		storageAlignment = alignment > 0 ? (size_t)alignment : 256;
+
+		VAO.create(GPU_CATEGORY_MESH);
+		VBO.create(GPU_CATEGORY_MESH, (size_t)maxVertices * VERTEX_STRIDE);
+		EBO.create(GPU_CATEGORY_MESH, (size_t)maxIndices * sizeof(uint16_t));
+		drawIdVBO.create(GPU_CATEGORY_MESH, commandCapacity * sizeof(uint32_t));
+
+		allocateStatic(VBO.get(), VBO.size());
+		allocateStatic(EBO.get(), EBO.size());
+
+		std::vector<uint32_t> drawIds(commandCapacity);
+		for (uint32_t i = 0; i < commandCapacity; i++)
+		{
+			drawIds[i] = i;
+		}
+		glbuffers::data(drawIdVBO.get(), commandCapacity * sizeof(uint32_t), drawIds.data(), GL_STATIC_DRAW);
+
+		glbuffers::elementBuffer(VAO.get(), EBO.get());
+		glbuffers::attribute(VAO.get(), 0, VBO.get(), 3, GL_HALF_FLOAT, false, VERTEX_STRIDE, 0);
+		glbuffers::attribute(VAO.get(), DRAW_ID_LOCATION, drawIdVBO.get(), 1, GL_UNSIGNED_INT, false, sizeof(uint32_t), 0, 1, true);
+		glState.bindVertexArray(0);
+
+		culler.init(maxDraws);
+		supported = true;
+		return true;
+	}
+
+	void destroy()
+	{
+		if (!supported)
+		{
+			return;
+		}
+		VAO.reset();
+		VBO.reset();
+		EBO.reset();
+		drawIdVBO.reset();
+		culler.destroy();
+		supported = false;
+	}
+
+	bool isSupported() const
+	{
+		return supported;
+	}
+
+	bool isCullingSupported() const
+	{
+		return culler.isSupported();
+	}
+
+	GpuCuller& gpuCuller()
+	{
+		return culler;
+	}
+
+	// copy a mesh (xyz float positions) into the shared buffers, returns its handle (INVALID_MESH when
+	// it doesn't fit); lods index ranges are relative to indices, without them the whole range is the only level
+	uint32_t addMesh(const float* positions, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount, const MeshLod* lods = NULL, uint32_t lodCount = 0)
+	{
+		MeshRange range;
+		range.baseVertex = vertexSpace.allocate(vertexCount);
+		range.firstIndex = indexSpace.allocate(indexCount);
+		if (range.baseVertex == RangeAllocator::INVALID || range.firstIndex == RangeAllocator::INVALID)
+		{
+			if (range.baseVertex != RangeAllocator::INVALID)
+			{
+				vertexSpace.release(range.baseVertex, vertexCount);
+			}
+			if (range.firstIndex != RangeAllocator::INVALID)
+			{
+				indexSpace.release(range.firstIndex, indexCount);
+			}
+			std::cout << "ERROR::BATCH_RENDERER::OUT_OF_SPACE" << std::endl;
+			return INVALID_MESH;
+		}
+		range.vertexCount = vertexCount;
+		range.indexCount = indexCount;
+		range.lodCount = lodCount > 0 ? (lodCount < (uint32_t)MESH_MAX_LODS ? lodCount : (uint32_t)MESH_MAX_LODS) : 1;
+		for (uint32_t i = 0; i < range.lodCount; i++)
+		{
+			range.lods[i] = lodCount > 0 ? lods[i] : MeshLod { 0, indexCount, 0.0f, 0 };
+			range.lods[i].firstIndex += range.firstIndex;
+		}
+		range.live = true;
+		// the origin is what the batch transform rotates about, so the sphere is centered there
+		std::vector<uint16_t> halves((size_t)vertexCount * 4, 0);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const float* position = positions + (size_t)i * 3;
+			float length = sqrtf(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+			range.radius = length > range.radius ? length : range.radius;
+			for (int k = 0; k < 3; k++)
+			{
+				halves[(size_t)i * 4 + k] = floatToHalf(position[k]);
+			}
+		}
+
+		upload(VBO.get(), (size_t)range.baseVertex * VERTEX_STRIDE, halves.data(), halves.size() * sizeof(uint16_t));
+		upload(EBO.get(), (size_t)range.firstIndex * sizeof(uint16_t), indices, (size_t)indexCount * sizeof(uint16_t));
+
+		uint32_t handle = 0;
+		while (handle < meshes.size() && meshes[handle].live)
+		{
+			handle++;
+		}
+		if (handle == meshes.size())
+		{
+			meshes.push_back(range);
+		}
+		meshes[handle] = range;
+
+		if (culler.isSupported())
+		{
+			CullMesh cullMesh = { range.lodCount, (int32_t)range.baseVertex, range.radius, 0, {} };
+			memcpy(cullMesh.lods, range.lods, sizeof(cullMesh.lods));
+			culler.setMesh(handle, cullMesh);
+		}
+		return handle;
+	}
+
+	// meshes from a mapped file: the positions are taken out of whatever layout it has (decoded when
+	// quantized), other attributes are dropped; the batch needs 16 bit indices
+	uint32_t addMesh(const MeshFile& file)
+	{
+		const MeshFileHeader& info = file.info();
+		const MeshAttribute* position = NULL;
+		for (uint32_t i = 0; i < info.attributeCount; i++)
+		{
+			position = info.attributes[i].location == MESH_POSITION_LOCATION ? &info.attributes[i] : position;
+		}
+		bool readable = position != NULL && position->components == 3 && (position->type == GL_FLOAT || position->type == GL_HALF_FLOAT);
+		if (!readable || info.indexType != GL_UNSIGNED_SHORT)
+		{
+			std::cout << "ERROR::BATCH_RENDERER::INCOMPATIBLE_MESH (needs float or half positions and 16 bit indices)" << std::endl;
+			return INVALID_MESH;
+		}
+
+		float center[3] = {}, extent[3] = { 1.0f, 1.0f, 1.0f };
+		if (info.flags & MESH_FLAG_QUANTIZED)
+		{
+			boundsDecode(info.boundsMin, info.boundsMax, center, extent);
+		}
+		std::vector<float> positions((size_t)info.vertexCount * 3);
+		for (uint32_t v = 0; v < info.vertexCount; v++)
+		{
+			const unsigned char* vertex = (const unsigned char*)file.vertexData() + (size_t)v * info.vertexStride + position->offset;
+			for (int k = 0; k < 3; k++)
+			{
+				float stored;
+				if (position->type == GL_HALF_FLOAT)
+				{
+					uint16_t half;
+					memcpy(&half, vertex + k * sizeof(uint16_t), sizeof(half));
+					stored = halfToFloat(half);
+				}
+				else
+				{
+					memcpy(&stored, vertex + k * sizeof(float), sizeof(stored));
+				}
+				positions[(size_t)v * 3 + k] = center[k] + stored * extent[k];
+			}
+		}
+		return addMesh(positions.data(), info.vertexCount, (const uint16_t*)file.indexData(), info.indexCount, file.lods(), info.lodCount);
+	}
+
+	void removeMesh(uint32_t handle)
+	{
+		MeshRange& range = meshes[handle];
+		vertexSpace.release(range.baseVertex, range.vertexCount);
+		indexSpace.release(range.firstIndex, range.indexCount);
+		range.live = false;
+	}
+
+	const MeshRange& mesh(uint32_t handle) const
+	{
+		return meshes[handle];
+	}
+
+	// level of detail: pixelsPerUnit converts mesh units at scale 1 to pixels (0 draws full detail),
+	// threshold is the screen-space error allowed in pixels, fadeBand the cross-fade width (0: none)
+	void setLodSelection(float pixelsPerUnit, float threshold, float fadeBand)
+	{
+		lodPixels = pixelsPerUnit;
+		lodThreshold = threshold;
+		lodFadeBand = fadeBand;
+		culler.setLodSelection(pixelsPerUnit, threshold, fadeBand);
+	}
+
+	// per frame: begin(), add() every object, then once the ring has been committed cull() (only
+	// does anything when culling) and submit()
+	void begin(FrameRingBuffer& ring, bool cull = false)
+	{
+		frameRing = &ring;
+		draws = 0;
+		culling = cull && culler.isSupported();
+		if (culling)
+		{
+			objects = ring.allocate(drawCapacity * sizeof(CullObject), storageAlignment);
+			return;
+		}
+		commands = ring.allocate(commandCapacity * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand));
+		drawData = ring.allocate(commandCapacity * sizeof(BatchDrawData), storageAlignment);
+	}
+
+	void add(uint32_t meshHandle, const BatchDrawData& data)
+	{
+		if (culling)
+		{
+			if (draws == drawCapacity || objects.data == NULL)
+			{
+				return;
+			}
+			CullObject& object = ((CullObject*)objects.data)[draws];
+			object.mesh = meshHandle;
+			memcpy(object.transform, data.transform, sizeof(object.transform));
+			memcpy(object.color, data.color, sizeof(object.color));
+			object.texture = data.texture;
+			draws++;
+			return;
+		}
+		if (draws + 2 > commandCapacity || commands.data == NULL || drawData.data == NULL)
+		{
+			return;
+		}
+		const MeshRange& range = meshes[meshHandle];
+		LodSelection selection = selectLod(range.lods, range.lodCount, data.transform[2], lodPixels, lodThreshold, lodFadeBand);
+		if (selection.fade <= 0.0f)
+		{
+			addCommand(range, range.lods[selection.lod], data);
+			return;
+		}
+		BatchDrawData faded = data;
+		faded.color[3] = selection.fade - 1.0f;
+		addCommand(range, range.lods[selection.lod], faded);
+		faded.color[3] = selection.fade;
+		addCommand(range, range.lods[selection.lod + 1], faded);
+	}
+
+	// culling: turn this frame's objects into indirect draws on the GPU (before submit, outside the
+	// batch program: it runs a compute program)
+	void cull()
+	{
+		if (culling)
+		{
+			culler.cull(frameRing->buffer(), objects.offset, draws);
+		}
+	}
+
+	// the depth the batch left behind becomes next frame's occlusion pyramid (after the scene is drawn
+	// into framebuffer, 0 for the window)
+	void buildDepthPyramid(int width, int height, unsigned int framebuffer = 0)
+	{
+		if (culling)
+		{
+			culler.buildDepthPyramid(width, height, framebuffer);
+		}
+	}
+
+	bool isCulling() const
+	{
+		return culling;
+	}
+
+	// draw everything written this frame with one call (program must be in use)
+	void submit()
+	{
+		if (draws == 0)
+		{
+			return;
+		}
+		if (culling)
+		{
+			glState.setEnabled(GL_DEPTH_TEST, true);
+			glState.depthFunc(GL_LEQUAL);
+			culler.draw(VAO.get(), DRAW_DATA_BINDING, GL_TRIANGLES, GL_UNSIGNED_SHORT);
+			glState.setEnabled(GL_DEPTH_TEST, false);
+			return;
+		}
+		unsigned int buffer = frameRing->buffer();
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, buffer, drawData.offset, draws * sizeof(BatchDrawData));
+		glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+
+		glState.bindVertexArray(VAO.get());
+		glext::MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)commands.offset, (GLsizei)draws, 0);
+	}
+
+	// objects added this frame when culling, indirect draws otherwise
+	size_t drawCount() const
+	{
+		return draws;
+	}
+
+private:
+	bool supported = false;
+	StagingBuffer* staging = NULL;
+	uint32_t drawCapacity = 0;
+	uint32_t commandCapacity = 0;
+	size_t storageAlignment = 256;
+
+	GpuVertexArray VAO;
+	GpuBuffer VBO;
+	GpuBuffer EBO;
+	GpuBuffer drawIdVBO;
+
+	FrameRingBuffer* frameRing = NULL;
+	FrameRingBuffer::Allocation commands;
+	FrameRingBuffer::Allocation drawData;
+	FrameRingBuffer::Allocation objects;
+	uint32_t draws = 0;
+	bool culling = false;
+	GpuCuller culler;
+	float lodPixels = 0.0f;
+	float lodThreshold = 0.0f;
+	float lodFadeBand = 0.0f;
+
+	RangeAllocator vertexSpace;
+	RangeAllocator indexSpace;
+	std::vector<MeshRange> meshes;
+
+	void addCommand(const MeshRange& range, const MeshLod& lod, const BatchDrawData& data)
+	{
+		DrawElementsIndirectCommand& command = ((DrawElementsIndirectCommand*)commands.data)[draws];
+		command.count = lod.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = lod.firstIndex;
+		command.baseVertex = (int32_t)range.baseVertex;
+		command.baseInstance = draws;
+		((BatchDrawData*)drawData.data)[draws] = data;
+		draws++;
+	}
+
+	void allocateStatic(unsigned int buffer, size_t size)
+	{
+		if (staging->isAvailable())
+		{
+			glbuffers::storage(buffer, size, NULL, 0);
+		}
+		else
+		{
+			glbuffers::data(buffer, size, NULL, GL_STATIC_DRAW);
+		}
+	}
+
+	void upload(unsigned int buffer, size_t offset, const void* data, size_t size)
+	{
+		if (staging->isAvailable())
+		{
+			staging->upload(buffer, offset, data, size);
+			return;
+		}
+		glbuffers::subData(buffer, offset, size, data);
+	}
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// linear command buffer
+// ---------------------
+// Packets are a small header followed by a fixed struct and optional variable payload, appended
+// back to back into one preallocated block: recording is a bump of the write head and a struct
+// write, with no allocation and no locking since each recording thread owns its buffer. Packets
+// never name GL objects or GL functions, only engine handles; a backend replays them (see
+// frame_renderer.h), so recording doesn't need a context and can happen on any thread.
+class CommandBuffer
+{
+public:
+	static const size_t ALIGNMENT = 16;
+
+	struct Header
+	{
+		uint16_t type;
+		uint16_t reserved;
+		uint32_t size;			// whole packet including this header, multiple of ALIGNMENT
+	};
+
+	// dropped pushes since reset(), i.e. the buffer was too small for the frame
+	unsigned int overflows = 0;
+
+	void init(size_t capacity)
+	{
+		storage.resize(capacity + ALIGNMENT);
+		size_t misalignment = (size_t)storage.data() % ALIGNMENT;
+		base = storage.data() + (misalignment ? ALIGNMENT - misalignment : 0);
+		limit = capacity;
+		head = 0;
+	}
+
+	void reset()
+	{
+		head = 0;
+		overflows = 0;
+	}
+
+	// append a packet whose fixed part is T followed by payloadBytes of payload (see payload());
+	// returns NULL when full
+	template <typename T>
+	T* push(uint16_t type, size_t payloadBytes = 0)
+	{
+		size_t size = align(align(sizeof(Header)) + sizeof(T) + payloadBytes);
+		if (head + size > limit)
+		{
+			if (overflows++ == 0)
+			{
+				std::cout << "ERROR::COMMAND_BUFFER::FULL" << std::endl;
+			}
+			return NULL;
+		}
+		unsigned char* packet = base + head;
+		Header* header = (Header*)packet;
+		header->type = type;
+		header->reserved = 0;
+		header->size = (uint32_t)size;
+		head += size;
+		return new (packet + align(sizeof(Header))) T();
+	}
+
+	// the bytes following a packet's fixed part
+	template <typename P, typename T>
+	static P* payload(T* packet)
+	{
+		return (P*)(packet + 1);
+	}
+
+	// walk: for (const Header* h = first(); h != NULL; h = next(h)) ... body<T>(h)
+	const Header* first() const
+	{
+		return head == 0 ? NULL : (const Header*)base;
+	}
+
+	const Header* next(const Header* header) const
+	{
+		const unsigned char* following = (const unsigned char*)header + header->size;
+		return following < base + head ? (const Header*)following : NULL;
+	}
+
+	template <typename T>
+	static const T* body(const Header* header)
+	{
+		return (const T*)((const unsigned char*)header + align(sizeof(Header)));
+	}
+
+	size_t used() const
+	{
+		return head;
+	}
+
+private:
+	std::vector<unsigned char> storage;
+	unsigned char* base = NULL;
+	size_t limit = 0;
+	size_t head = 0;
+
+	static size_t align(size_t size)
+	{
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// background file watcher: polls modification times
+// --------------------------------------------------
+// A thread stats the watched files every interval and queues the ones whose time changed (a file
+// that disappears counts once it comes back, so editors that save by delete + rename still
+// register). Polling keeps it portable and a few dozen stats per interval cost nothing; the owner
+// collects the changes with takeChanged() on its own thread, onChange just gets it to look soon.
+class FileWatcher
+{
+public:
+	typedef std::filesystem::file_time_type Time;
+
+	FileWatcher() = default;
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// an owner that returns early must not leave the polling thread joinable
+	~FileWatcher()
+	{
+		stop();
+	}
+
+	void start(std::chrono::milliseconds pollInterval, std::function<void()> onChange = nullptr)
+	{
+		interval = pollInterval;
+		notify = onChange;
+		running = true;
+		thread = std::thread([this]() { run(); });
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_all();
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	// replace the watched set; files already watched keep their last seen time
+	void watch(const std::vector<std::string>& paths)
+	{
+		std::map<std::string, Time> next;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const std::string& path : paths)
+			{
+				auto known = times.find(path);
+				if (known != times.end())
+				{
+					next[path] = known->second;
+				}
+			}
+		}
+		for (const std::string& path : paths)
+		{
+			if (next.find(path) == next.end())
+			{
+				next[path] = modified(path);
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		times.swap(next);
+	}
+
+	// files that changed since the last call
+	std::vector<std::string> takeChanged()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::string> result;
+		result.swap(changed);
+		return result;
+	}
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool running = false;
+	std::chrono::milliseconds interval { 250 };
+	std::function<void()> notify;
+	std::map<std::string, Time> times;
+	std::vector<std::string> changed;
+
+	static Time modified(const std::string& path)
+	{
+		std::error_code error;
+		Time time = std::filesystem::last_write_time(path, error);
+		return error ? Time::min() : time;
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (running)
+		{
+			wake.wait_for(lock, interval, [this]() { return !running; });
+			if (!running)
+			{
+				break;
+			}
+			std::vector<std::string> paths;
+			for (const auto& entry : times)
+			{
+				paths.push_back(entry.first);
+			}
+
+			// stat without the lock, watch() may be replacing the set meanwhile
+			lock.unlock();
+			std::vector<Time> now;
+			for (const std::string& path : paths)
+			{
+				now.push_back(modified(path));
+			}
+			lock.lock();
+
+			bool any = false;
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				auto entry = times.find(paths[i]);
+				if (entry == times.end() || entry->second == now[i])
+				{
+					continue;
+				}
+				entry->second = now[i];
+				if (now[i] != Time::min())
+				{
+					changed.push_back(paths[i]);
+					any = true;
+				}
+			}
+			if (any && notify)
+			{
+				lock.unlock();
+				notify();
+				lock.lock();
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// linear arena
+// ------------
+// One preallocated block handed out by bumping an offset; nothing is freed on its own, reset()
+// drops everything at once. That fits data that lives for one frame (or one call, with mark() and
+// rewind()): no per-object bookkeeping, no fragmentation, and no lock since each arena has a
+// single owner thread. Only trivially destructible types belong here, nothing gets destroyed.
+// allocate() returns NULL when full, like a full CommandBuffer; highWater() is the most any
+// frame used, which is what capacity should be sized from.
+class LinearArena
+{
+public:
+	static const size_t ALIGNMENT = 16;
+
+	// dropped allocations since reset(), i.e. the arena was too small for the frame
+	unsigned int overflows = 0;
+
+	void init(size_t capacity)
+	{
+		storage.resize(capacity + ALIGNMENT);
+		size_t misalignment = (size_t)storage.data() % ALIGNMENT;
+		base = storage.data() + (misalignment ? ALIGNMENT - misalignment : 0);
+		limit = capacity;
+		head = 0;
+		peak = 0;
+	}
+
+	void reset()
+	{
+		head = 0;
+		overflows = 0;
+	}
+
+	void* allocate(size_t bytes, size_t alignment = ALIGNMENT)
+	{
+		size_t start = (head + alignment - 1) & ~(alignment - 1);
+		if (start + bytes > limit)
+		{
+			if (overflows++ == 0)
+			{
+				std::cout << "ERROR::LINEAR_ARENA::FULL" << std::endl;
+			}
+			return NULL;
+		}
+		head = start + bytes;
+		peak = head > peak ? head : peak;
+		return base + start;
+	}
+
+	// count default constructed Ts, NULL when they don't fit
+	template <typename T>
+	T* allocate(size_t count = 1)
+	{
+		void* memory = allocate(count * sizeof(T), alignof(T));
+		if (memory == NULL)
+		{
+			return NULL;
+		}
+		T* objects = (T*)memory;
+		for (size_t i = 0; i < count; i++)
+		{
+			new (objects + i) T();
+		}
+		return objects;
+	}
+
+	// scoped use inside a frame: everything allocated after mark() goes with rewind(mark)
+	size_t mark() const
+	{
+		return head;
+	}
+
+	void rewind(size_t marker)
+	{
+		head = marker < head ? marker : head;
+	}
+
+	size_t used() const
+	{
+		return head;
+	}
+
+	size_t highWater() const
+	{
+		return peak;
+	}
+
+	size_t capacity() const
+	{
+		return limit;
+	}
+
+private:
+	std::vector<unsigned char> storage;
+	unsigned char* base = NULL;
+	size_t limit = 0;
+	size_t head = 0;
+	size_t peak = 0;
+};
+
+// fixed-size object pool
+// ----------------------
+// Room for N objects of type T inside the pool itself, with a free list threaded through the
+// empty slots: acquire() and release() are a pointer swap, objects never move (so pointers to
+// them stay good for their whole life) and the heap is never touched. Meant for long-lived
+// wrappers that other code holds pointers to; single threaded, and whatever is still acquired
+// when the pool goes is not destroyed.
+template <typename T, size_t N>
+class FixedPool
+{
+public:
+	FixedPool()
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			slots[i].next = i + 1 < N ? &slots[i + 1] : NULL;
+		}
+		freeList = &slots[0];
+	}
+
+	FixedPool(const FixedPool&) = delete;
+	FixedPool& operator=(const FixedPool&) = delete;
+
+	// a default constructed T, NULL when all N are in use
+	T* acquire()
+	{
+		if (freeList == NULL)
+		{
+			std::cout << "ERROR::FIXED_POOL::EXHAUSTED (" << N << " objects)" << std::endl;
+			return NULL;
+		}
+		Slot* slot = freeList;
+		freeList = slot->next;
+		count++;
+		peak = count > peak ? count : peak;
+		return new (slot->storage) T();
+	}
+
+	void release(T* object)
+	{
+		if (object == NULL)
+		{
+			return;
+		}
+		object->~T();
+		Slot* slot = (Slot*)object;
+		slot->next = freeList;
+		freeList = slot;
+		count--;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	size_t highWater() const
+	{
+		return peak;
+	}
+
+	static size_t capacity()
+	{
+		return N;
+	}
+
+private:
+	union Slot
+	{
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	Slot slots[N];
+	Slot* freeList = NULL;
+	size_t count = 0;
+	size_t peak = 0;
+};
+
+// heap allocation counting
+// ------------------------
+// main.cpp replaces the global operator new with one that calls countHeapAllocation(). Only
+// threads inside a HeapAllocationScope count, so the frame path (main loop, render thread,
+// recording jobs) can be checked for allocations without background threads (file watcher,
+// driver) showing up. Steady state should read zero; anything else is a frame-path allocation to
+// move onto an arena or a preallocated array.
+inline std::atomic<uint64_t>& heapAllocationCounter()
+{
+	static std::atomic<uint64_t> counter { 0 };
+	return counter;
+}
+
+inline int& heapAllocationScopeDepth()
+{
+	thread_local int depth = 0;
+	return depth;
+}
+
+inline void countHeapAllocation()
+{
+	if (heapAllocationScopeDepth() > 0)
+	{
+		heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// counted allocations since startup
+inline uint64_t heapAllocations()
+{
+	return heapAllocationCounter().load(std::memory_order_relaxed);
+}
+
+class HeapAllocationScope
+{
+public:
+	HeapAllocationScope()
+	{
+		heapAllocationScopeDepth()++;
+	}
+
+	~HeapAllocationScope()
+	{
+		heapAllocationScopeDepth()--;
+	}
+
+	HeapAllocationScope(const HeapAllocationScope&) = delete;
+	HeapAllocationScope& operator=(const HeapAllocationScope&) = delete;
+};
+
+#endif
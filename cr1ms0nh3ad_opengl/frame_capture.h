@@ -0,0 +1,497 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum CaptureFormat
+{
+	CAPTURE_PNG,		// numbered PNG files in a directory
+	CAPTURE_YUV			// raw I420 frames appended to one file or pipe
+};
+
+// PNG writer: RGBA8, rows given bottom up (as GL reads them)
+// ----------------------------------------------------------
+// No zlib here, so the image data goes in stored (uncompressed) deflate blocks: any decoder reads
+// it, the files are just about as big as the raw pixels. Good for a monitoring feed, not an archive.
+inline uint32_t pngCrc(const unsigned char* data, size_t size, uint32_t crc = 0xFFFFFFFFu)
+{
+	static uint32_t table[256];
+	static bool built = false;
+	if (!built)
+	{
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		built = true;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+inline bool writePng(const std::string& path, const unsigned char* rgba, int width, int height)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	auto put32 = [](unsigned char* out, uint32_t value)
+	{
+		out[0] = (unsigned char)(value >> 24);
+		out[1] = (unsigned char)(value >> 16);
+		out[2] = (unsigned char)(value >> 8);
+		out[3] = (unsigned char)value;
+	};
+	auto chunk = [&](const char* type, const unsigned char* data, size_t size)
+	{
+		unsigned char header[8];
+		put32(header, (uint32_t)size);
+		memcpy(header + 4, type, 4);
+		uint32_t crc = pngCrc(header + 4, 4);
+		crc = pngCrc(data, size, crc) ^ 0xFFFFFFFFu;
+		unsigned char trailer[4];
+		put32(trailer, crc);
+		fwrite(header, 1, 8, file);
+		fwrite(data, 1, size, file);
+		fwrite(trailer, 1, 4, file);
+	};
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, 8, file);
+	unsigned char ihdr[13] = {};
+	put32(ihdr, (uint32_t)width);
+	put32(ihdr + 4, (uint32_t)height);
+	ihdr[8] = 8;		// bits per channel
+	ihdr[9] = 6;		// RGBA
+	chunk("IHDR", ihdr, sizeof(ihdr));
+
+	// zlib stream: header, stored blocks of at most 65535 bytes over the filtered rows, adler32
+	size_t rowBytes = (size_t)width * 4 + 1;
+	size_t rawBytes = rowBytes * height;
+	size_t blocks = (rawBytes + 65534) / 65535;
+	std::vector<unsigned char> idat;
+	idat.reserve(2 + rawBytes + blocks * 5 + 4);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	uint32_t a = 1, b = 0;
+	size_t produced = 0;
+	std::vector<unsigned char> raw(rawBytes);
+	for (int y = 0; y < height; y++)
+	{
+		unsigned char* row = raw.data() + (size_t)y * rowBytes;
+		row[0] = 0;		// filter: none
+		memcpy(row + 1, rgba + (size_t)(height - 1 - y) * width * 4, (size_t)width * 4);
+	}
+	while (produced < rawBytes)
+	{
+		size_t size = rawBytes - produced < 65535 ? rawBytes - produced : 65535;
+		bool last = produced + size == rawBytes;
+		idat.push_back(last ? 1 : 0);
+		idat.push_back((unsigned char)size);
+		idat.push_back((unsigned char)(size >> 8));
+		idat.push_back((unsigned char)~size);
+		idat.push_back((unsigned char)(~size >> 8));
+		idat.insert(idat.end(), raw.begin() + produced, raw.begin() + produced + size);
+		for (size_t i = produced; i < produced + size; i++)
+		{
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		produced += size;
+	}
+	unsigned char adler[4];
+	put32(adler, (b << 16) | a);
+	idat.insert(idat.end(), adler, adler + 4);
+	chunk("IDAT", idat.data(), idat.size());
+	chunk("IEND", NULL, 0);
+	bool written = ferror(file) == 0;
+	fclose(file);
+	return written;
+}
+
+// RGBA8 rows bottom up to I420 (BT.601, limited range), top down; odd sizes lose the last row / column
+inline void rgbaToI420(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& out)
+{
+	int w = width & ~1, h = height & ~1;
+	out.resize((size_t)w * h * 3 / 2);
+	unsigned char* planeY = out.data();
+	unsigned char* planeU = planeY + (size_t)w * h;
+	unsigned char* planeV = planeU + (size_t)w * h / 4;
+	for (int y = 0; y < h; y++)
+	{
+		const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+		for (int x = 0; x < w; x++)
+		{
+			const unsigned char* p = row + x * 4;
+			planeY[(size_t)y * w + x] = (unsigned char)((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) / 256 + 16);
+		}
+	}
+	for (int y = 0; y < h / 2; y++)
+	{
+		const unsigned char* row0 = rgba + (size_t)(height - 1 - 2 * y) * width * 4;
+		const unsigned char* row1 = rgba + (size_t)(height - 2 - 2 * y) * width * 4;
+		for (int x = 0; x < w / 2; x++)
+		{
+			int r = 0, g = 0, b = 0;
+			for (int k = 0; k < 2; k++)
+			{
+				const unsigned char* p0 = row0 + (2 * x + k) * 4;
+				const unsigned char* p1 = row1 + (2 * x + k) * 4;
+				r += p0[0] + p1[0];
+				g += p0[1] + p1[1];
+				b += p0[2] + p1[2];
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+			planeU[(size_t)y * (w / 2) + x] = (unsigned char)((-38 * r - 74 * g + 112 * b + 128) / 256 + 128);
+			planeV[(size_t)y * (w / 2) + x] = (unsigned char)((112 * r - 94 * g - 18 * b + 128) / 256 + 128);
+		}
+	}
+}
+
+// asynchronous frame capture: pixel pack buffers, fences and an encoder thread
+// -----------------------------------------------------------------------------
+// capture() (GL thread, after the frame's last draw) only queues a glReadPixels into the next of
+// SLOTS pixel pack buffers and fences it, so the copy runs on the GPU behind the frame. collect()
+// (GL thread, once per frame) hands every slot whose fence has signalled, in capture order, to the
+// encoder thread; that is usually one or two frames later and it never waits. The encoder reads
+// the pixels straight out of the mapped buffer (kept persistently mapped with GL 4.4 buffer
+// storage, mapped in collect() and unmapped once encoded otherwise), so the render thread copies
+// nothing. When every slot is still being read back or encoded the frame is dropped rather than
+// stalling the render loop; stats() says how many were.
+//
+// PNG writes <path>/frame_000000.png onwards. YUV appends raw I420 frames to the file at path
+// (which can be a named pipe into an encoder); the size is that of the first frame, later frames of
+// another size are dropped since a raw stream can't say so.
+class FrameCapture
+{
+public:
+	static const int SLOTS = 4;
+
+	struct Stats
+	{
+		uint32_t captured = 0;		// readbacks queued
+		uint32_t dropped = 0;		// frames skipped because no slot was free
+		uint32_t written = 0;		// frames the encoder finished
+		uint32_t failed = 0;		// frames the encoder couldn't write
+	};
+
+	// GL thread, context current; false when the output can't be opened
+	bool start(CaptureFormat captureFormat, const std::string& outputPath)
+	{
+		format = captureFormat;
+		path = outputPath;
+		if (format == CAPTURE_PNG)
+		{
+			std::error_code error;
+			std::filesystem::create_directories(path, error);
+			if (error)
+			{
+				std::cout << "ERROR::FRAME_CAPTURE::CANT_CREATE " << path << ": " << error.message() << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			stream = fopen(path.c_str(), "wb");
+			if (stream == NULL)
+			{
+				std::cout << "ERROR::FRAME_CAPTURE::CANT_OPEN " << path << std::endl;
+				return false;
+			}
+		}
+		persistent = glext::bufferStorage;
+		quit = false;
+		encoder = std::thread([this]() { encode(); });
+		active = true;
+		std::cout << "capturing to " << path << (format == CAPTURE_PNG ? " (PNG)" : " (I420)") << std::endl;
+		return true;
+	}
+
+	// GL thread: everything still in flight is read back and encoded, then the buffers go
+	void stop()
+	{
+		if (!active)
+		{
+			return;
+		}
+		for (int i = 0; i < SLOTS; i++)
+		{
+			Slot& slot = slots[(readHead + i) % SLOTS];
+			if (slot.state.load(std::memory_order_acquire) == SLOT_READING)
+			{
+				glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull * 10);
+			}
+		}
+		collect();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		encoder.join();
+		for (Slot& slot : slots)
+		{
+			if (slot.fence != NULL)
+			{
+				glDeleteSync(slot.fence);
+				slot.fence = NULL;
+			}
+			release(slot);
+			slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+		}
+		if (stream != NULL)
+		{
+			fclose(stream);
+			stream = NULL;
+		}
+		active = false;
+		std::cout << "CAPTURE::DONE " << statistics.written << " frames written, " << statistics.dropped << " dropped, "
+			<< statistics.failed << " failed" << std::endl;
+	}
+
+	bool isActive() const
+	{
+		return active;
+	}
+
+	// GL thread, after the frame's last draw: read framebuffer (0: the window's back buffer) back
+	void capture(unsigned int framebuffer, int width, int height)
+	{
+		if (!active || width <= 0 || height <= 0)
+		{
+			return;
+		}
+		Slot& slot = slots[writeHead];
+		if (slot.state.load(std::memory_order_acquire) == SLOT_ENCODED)
+		{
+			finish(slot);
+		}
+		if (slot.state.load(std::memory_order_acquire) != SLOT_FREE)
+		{
+			statistics.dropped++;
+			return;
+		}
+		size_t bytes = (size_t)width * height * 4;
+		if (bytes != slot.pixels.size())
+		{
+			allocate(slot, bytes);
+		}
+		if (!slot.pixels)
+		{
+			statistics.dropped++;
+			return;
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixels.get());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.width = width;
+		slot.height = height;
+		slot.number = frameNumber++;
+		slot.state.store(SLOT_READING, std::memory_order_release);
+		writeHead = (writeHead + 1) % SLOTS;
+		statistics.captured++;
+	}
+
+	// GL thread, once per frame: finished readbacks go to the encoder, encoded slots come back
+	void collect()
+	{
+		if (!active)
+		{
+			return;
+		}
+		for (int i = 0; i < SLOTS; i++)
+		{
+			Slot& slot = slots[readHead];
+			if (slot.state.load(std::memory_order_acquire) != SLOT_READING
+				|| glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				break;
+			}
+			glDeleteSync(slot.fence);
+			slot.fence = NULL;
+			if (!persistent)
+			{
+				slot.mapped = (const unsigned char*)glbuffers::mapRange(slot.pixels.get(), 0, slot.pixels.size(), GL_MAP_READ_BIT);
+			}
+			slot.state.store(SLOT_ENCODING, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue[queueTail++ % SLOTS] = readHead;
+			}
+			wake.notify_one();
+			readHead = (readHead + 1) % SLOTS;
+		}
+		for (Slot& slot : slots)
+		{
+			if (slot.state.load(std::memory_order_acquire) == SLOT_ENCODED)
+			{
+				finish(slot);
+			}
+		}
+	}
+
+	Stats stats() const
+	{
+		Stats result = statistics;
+		result.written = written.load(std::memory_order_relaxed);
+		result.failed = failed.load(std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	enum SlotState { SLOT_FREE, SLOT_READING, SLOT_ENCODING, SLOT_ENCODED };
+
+	struct Slot
+	{
+		GpuBuffer pixels;
+		const unsigned char* mapped = NULL;
+		GLsync fence = NULL;
+		int width = 0;
+		int height = 0;
+		uint32_t number = 0;
+		std::atomic<int> state { SLOT_FREE };
+	};
+
+	CaptureFormat format = CAPTURE_PNG;
+	std::string path;
+	FILE* stream = NULL;
+	bool persistent = false;
+	bool active = false;
+	Slot slots[SLOTS];
+	int writeHead = 0;
+	int readHead = 0;
+	uint32_t frameNumber = 0;
+	Stats statistics;
+	std::atomic<uint32_t> written { 0 };
+	std::atomic<uint32_t> failed { 0 };
+
+	std::thread encoder;
+	std::mutex mutex;
+	std::condition_variable wake;
+	int queue[SLOTS] = {};
+	uint32_t queueHead = 0;
+	uint32_t queueTail = 0;
+	bool quit = false;
+
+	void allocate(Slot& slot, size_t bytes)
+	{
+		release(slot);
+		slot.pixels.create(GPU_CATEGORY_STREAMING, bytes);
+		if (persistent)
+		{
+			const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glbuffers::storage(slot.pixels.get(), bytes, NULL, flags | GL_CLIENT_STORAGE_BIT);
+			slot.mapped = (const unsigned char*)glbuffers::mapRange(slot.pixels.get(), 0, bytes, flags);
+			if (slot.mapped == NULL)
+			{
+				slot.pixels.reset();
+				return;
+			}
+		}
+		else
+		{
+			glbuffers::data(slot.pixels.get(), bytes, NULL, GL_STREAM_READ);
+		}
+	}
+
+	// unmap (when mapped) and retire the slot's buffer
+	void release(Slot& slot)
+	{
+		if (slot.pixels && slot.mapped != NULL)
+		{
+			glbuffers::unmap(slot.pixels.get());
+		}
+		slot.mapped = NULL;
+		slot.pixels.reset();
+	}
+
+	// the encoder is done with slot: unmap it unless it stays mapped, and make it reusable
+	void finish(Slot& slot)
+	{
+		if (!persistent && slot.mapped != NULL)
+		{
+			glbuffers::unmap(slot.pixels.get());
+			slot.mapped = NULL;
+		}
+		slot.state.store(SLOT_FREE, std::memory_order_release);
+	}
+
+	void encode()
+	{
+		std::vector<unsigned char> yuv;
+		int streamWidth = 0, streamHeight = 0;
+		char name[32];
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return quit || queueHead != queueTail; });
+			if (queueHead == queueTail)
+			{
+				break;
+			}
+			Slot& slot = slots[queue[queueHead++ % SLOTS]];
+			lock.unlock();
+
+			bool ok = slot.mapped != NULL;
+			if (ok && format == CAPTURE_PNG)
+			{
+				snprintf(name, sizeof(name), "frame_%06u.png", slot.number);
+				ok = writePng((std::filesystem::path(path) / name).string(), slot.mapped, slot.width, slot.height);
+			}
+			else if (ok)
+			{
+				if (streamWidth == 0)
+				{
+					streamWidth = slot.width;
+					streamHeight = slot.height;
+					std::cout << "CAPTURE::YUV " << (streamWidth & ~1) << "x" << (streamHeight & ~1) << " I420" << std::endl;
+				}
+				ok = slot.width == streamWidth && slot.height == streamHeight;
+				if (ok)
+				{
+					rgbaToI420(slot.mapped, slot.width, slot.height, yuv);
+					ok = fwrite(yuv.data(), 1, yuv.size(), stream) == yuv.size();
+					fflush(stream);
+				}
+			}
+			(ok ? written : failed).fetch_add(1, std::memory_order_relaxed);
+			slot.state.store(SLOT_ENCODED, std::memory_order_release);
+
+			lock.lock();
+		}
+	}
+};
+
+#endif
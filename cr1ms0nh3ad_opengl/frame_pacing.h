@@ -0,0 +1,186 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <glfw3.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// presentation modes
+// ------------------
+// UNCAPPED swaps immediately (interval 0, tears). VSYNC waits for the vertical blank (interval 1).
+// ADAPTIVE is EXT_swap_control_tear (interval -1): synced while the frame rate keeps up and tearing
+// instead of dropping to half rate when a frame misses the blank. LIMITED doesn't sync and paces
+// the main thread to a target rate instead.
+enum PresentMode
+{
+	PRESENT_UNCAPPED,
+	PRESENT_VSYNC,
+	PRESENT_ADAPTIVE,
+	PRESENT_LIMITED,
+	PRESENT_MODE_COUNT
+};
+
+inline const char* presentModeName(PresentMode mode)
+{
+	static const char* names[PRESENT_MODE_COUNT] = { "uncapped", "vsync", "adaptive", "limited" };
+	return mode < PRESENT_MODE_COUNT ? names[mode] : "?";
+}
+
+inline bool parsePresentMode(const char* name, PresentMode& mode)
+{
+	for (int i = 0; i < PRESENT_MODE_COUNT; i++)
+	{
+		if (strcmp(name, presentModeName((PresentMode)i)) == 0)
+		{
+			mode = (PresentMode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// frame pacing
+// ------------
+// Threading: init() and applySwapInterval() need the context current and run on whichever thread
+// owns it; wait() runs on the main thread before it samples input. addLatency() / latencyMs()
+// belong to the thread that presents.
+//
+// The limiter sleeps while the remaining time is comfortably longer than a sleep has been observed
+// to take (tracked as a running estimate, so a coarse 15 ms scheduler tick is handled as well as a
+// 1 ms one) and spins out the rest, so the deadline is met to within microseconds without burning a
+// core for the whole frame. Deadlines advance by whole periods; after a hitch the schedule restarts
+// from now instead of racing to catch up.
+//
+// Latency is estimated per frame as the time from sampling input to glfwSwapBuffers returning,
+// plus half a refresh for the synced modes (the image goes out on the blank after the swap and is
+// scanned out top to bottom; half a refresh is the middle of the screen). It ignores the display's
+// own processing, so it is a lower bound, but it moves the right way when pacing changes.
+class FramePacer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// query what the platform offers (call with the context current)
+	void init(GLFWmonitor* monitor)
+	{
+		adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+		const GLFWvidmode* videoMode = monitor != NULL ? glfwGetVideoMode(monitor) : NULL;
+		refreshHz = videoMode != NULL && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60;
+	}
+
+	bool isAdaptiveSupported() const
+	{
+		return adaptiveSupported;
+	}
+
+	int refreshRate() const
+	{
+		return refreshHz;
+	}
+
+	// the mode that is really used for a requested one (adaptive degrades to vsync without the extension)
+	PresentMode resolve(PresentMode mode) const
+	{
+		return mode == PRESENT_ADAPTIVE && !adaptiveSupported ? PRESENT_VSYNC : mode;
+	}
+
+	// set the swap interval for mode if it changed (context thread)
+	void applySwapInterval(PresentMode mode)
+	{
+		mode = resolve(mode);
+		if (mode == appliedMode)
+		{
+			return;
+		}
+		glfwSwapInterval(mode == PRESENT_VSYNC ? 1 : (mode == PRESENT_ADAPTIVE ? -1 : 0));
+		appliedMode = mode;
+		std::cout << "present mode " << presentModeName(mode) << std::endl;
+	}
+
+	// LIMITED: block until the next frame is due at targetHz, returns the milliseconds waited
+	float wait(PresentMode mode, double targetHz)
+	{
+		if (mode != PRESENT_LIMITED || targetHz <= 0.0)
+		{
+			scheduled = false;
+			return 0.0f;
+		}
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetHz));
+		Clock::time_point start = Clock::now();
+		if (!scheduled || start > deadline + period)
+		{
+			deadline = start;
+			scheduled = true;
+		}
+
+		while (true)
+		{
+			Clock::time_point now = Clock::now();
+			if (now >= deadline)
+			{
+				break;
+			}
+			double remaining = seconds(deadline - now);
+			if (remaining > sleepEstimate * 2.0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				double slept = seconds(Clock::now() - now);
+				sleepEstimate = slept > sleepEstimate ? slept : sleepEstimate * 0.99 + slept * 0.01;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		deadline += period;
+		return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	}
+
+	// presenting thread: inputSampled is when the frame's input was read, swapped when the swap returned
+	void addLatency(Clock::time_point inputSampled, Clock::time_point swapped)
+	{
+		double ms = seconds(swapped - inputSampled) * 1000.0;
+		if (appliedMode == PRESENT_VSYNC || appliedMode == PRESENT_ADAPTIVE)
+		{
+			ms += 500.0 / refreshHz;
+		}
+		latencySumMs += ms;
+		latencyFrames++;
+	}
+
+	// average estimate since the last call (0 when no frame was presented)
+	float latencyMs()
+	{
+		float average = latencyFrames ? (float)(latencySumMs / latencyFrames) : 0.0f;
+		latencySumMs = 0.0;
+		latencyFrames = 0;
+		return average;
+	}
+
+	PresentMode currentMode() const
+	{
+		return appliedMode;
+	}
+
+private:
+	bool adaptiveSupported = false;
+	int refreshHz = 60;
+	PresentMode appliedMode = PRESENT_MODE_COUNT;
+
+	bool scheduled = false;
+	Clock::time_point deadline;
+	double sleepEstimate = 0.001;
+
+	double latencySumMs = 0.0;
+	int latencyFrames = 0;
+
+	static double seconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+};
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef FRAME_RENDERER_H
+#define FRAME_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "batch_renderer.h"
+#include "command_buffer.h"
+#include "frame_arena.h"
+#include "frame_pacing.h"
+#include "instancing.h"
+#include "mesh.h"
+#include "render_queue.h"
+#include "render_scale.h"
+#include "ring_buffer.h"
+#include "scene_store.h"
+#include "shader_manager.h"
+#include "texture_streamer.h"
+#include "texture_table.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// frame command packets
+// ---------------------
+// Programs are ShaderManager handles and meshes are engine objects, so recording never touches GL.
+// *_BEGIN / *_VIEW packets carry per-frame data and are replayed in the stream phase (before the
+// ring is committed); the *_DRAW packets are replayed afterwards as sorted render queue items.
+// Views point into a SceneStore frame slot, which stays untouched until the frame is replayed.
+enum FrameCommand : uint16_t
+{
+	CMD_DRAW_MESH,			// DrawMeshPacket
+	CMD_SPRITES_VIEW,		// ScenePacket: one instance per entity
+	CMD_SPRITES_DRAW,		// DrawPacket
+	CMD_BATCH_BEGIN,		// BatchBeginPacket
+	CMD_BATCH_VIEW,			// ScenePacket: one batch draw per entity
+	CMD_BATCH_DRAW,			// DrawPacket
+	CMD_DRAW_TEXTURED		// DrawTexturedPacket: requests its texture in the stream phase, draws in the draw phase
+};
+
+struct DrawPacket
+{
+	int program;
+	uint32_t pass;
+	float depth;
+};
+
+struct DrawMeshPacket
+{
+	DrawPacket draw;
+	const Mesh* mesh;
+};
+
+// a mesh with one streamed texture; the program takes uTransform (xy offset, z scale) and samples unit 0
+struct DrawTexturedPacket
+{
+	DrawPacket draw;
+	const Mesh* mesh;
+	uint32_t texture;		// TextureStreamer handle
+	float transform[4];
+	float screenPixels;		// how big it shows, for the texture's mip residency
+};
+
+struct ScenePacket
+{
+	SceneView view;
+};
+
+struct BatchBeginPacket
+{
+	uint32_t cull;			// nonzero: cull on the GPU (when supported)
+	float lodThreshold;		// screen-space error allowed in pixels, 0 draws full detail
+	float lodFadeBand;		// cross-fade width between levels, in thresholds (0: switch)
+};
+
+// one frame's worth of recorded work plus what the main thread measured and decided for it
+// ----------------------------------------------------------------------------------------
+struct FrameCommands
+{
+	CommandBuffer commands;					// recorded by the main thread, replayed in order
+	float inputMs = 0.0f;
+	float recordMs = 0.0f;
+	float eventsMs = 0.0f;
+	float paceMs = 0.0f;					// held back by the frame limiter before input was read
+	std::chrono::steady_clock::time_point inputSampled;
+	PresentMode presentMode = PRESENT_VSYNC;
+	int framebufferWidth = 0;
+	int framebufferHeight = 0;
+	bool showOverlay = true;
+	bool captureFrame = false;				// read the finished frame back for the capture
+	float renderScale = 1.0f;				// of the output size, when not dynamic
+	bool dynamicResolution = false;
+	UpscaleFilter upscaleFilter = UPSCALE_SHARPEN;
+	bool dumpProfile = false;
+
+	void init(size_t bytes)
+	{
+		commands.init(bytes);
+	}
+
+	void reset()
+	{
+		commands.reset();
+	}
+};
+
+// GL backend: replays FrameCommands on the thread that owns the context
+// ---------------------------------------------------------------------
+class FrameRenderer
+{
+public:
+	void init(ShaderManager& shaderManager, FrameRingBuffer& frameRing, RenderQueue& renderQueue, InstanceBatch& spriteBatch, BatchRenderer& batchRenderer,
+		TextureStreamer& textureStreamer, TextureTable& textureTable, LinearArena& frameArena)
+	{
+		shaders = &shaderManager;
+		ring = &frameRing;
+		queue = &renderQueue;
+		sprites = &spriteBatch;
+		batch = &batchRenderer;
+		textures = &textureStreamer;
+		batchTextures = &textureTable;
+		arena = &frameArena;
+	}
+
+	// stream phase: copy the frame's dynamic data into the ring (call between beginFrame and commit)
+	// and collect texture requests (TextureStreamer::update() goes after this). What the draw phase
+	// needs from here lives in the frame arena, which the caller resets before each frame.
+	void stream(const FrameCommands& frame)
+	{
+		batchActive = false;
+		texturedDraws = NULL;
+		TexturedDraw** tail = &texturedDraws;
+		transformProgram = 0;			// looked up once per program per frame
+		const CommandBuffer& buffer = frame.commands;
+		for (const CommandBuffer::Header* header = buffer.first(); header != NULL; header = buffer.next(header))
+		{
+			switch (header->type)
+			{
+			case CMD_SPRITES_VIEW:
+			{
+				// gathered straight from the component arrays into the mapped ring
+				const SceneView& view = CommandBuffer::body<ScenePacket>(header)->view;
+				SpriteInstance* instances = sprites->write(*ring, view.count);
+				uint32_t count = instances != NULL ? sprites->size() : 0;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					SpriteInstance& sprite = instances[i];
+					sprite.x = view.x[i];
+					sprite.y = view.y[i];
+					sprite.scale = view.scale[i];
+					sprite.rotation = view.rotation[i];
+					sprite.color[0] = (uint8_t)(255.0f * view.red[i]);
+					sprite.color[1] = (uint8_t)(255.0f * view.green[i]);
+					sprite.color[2] = (uint8_t)(255.0f * view.blue[i]);
+					sprite.color[3] = (uint8_t)(255.0f * view.alpha[i]);
+				}
+				break;
+			}
+			case CMD_BATCH_BEGIN:
+			{
+				if (batch->isSupported())
+				{
+					// batch positions are NDC, so one unit is half the framebuffer (the larger side, to stay conservative)
+					const BatchBeginPacket* begin = CommandBuffer::body<BatchBeginPacket>(header);
+					int pixels = frame.framebufferWidth > frame.framebufferHeight ? frame.framebufferWidth : frame.framebufferHeight;
+					batchPixels = 0.5f * pixels;
+					batch->setLodSelection(batchPixels, begin->lodThreshold, begin->lodFadeBand);
+					batch->begin(*ring, begin->cull != 0);
+					batchActive = true;
+				}
+				break;
+			}
+			case CMD_BATCH_VIEW:
+			{
+				const SceneView& view = CommandBuffer::body<ScenePacket>(header)->view;
+				for (uint32_t i = 0; batchActive && i < view.count; i++)
+				{
+					if (view.visible != NULL && view.visible[i] == 0)
+					{
+						continue;
+					}
+					BatchDrawData data =
+					{
+						{ view.x[i], view.y[i], view.scale[i], view.rotation[i] },
+						{ view.red[i], view.green[i], view.blue[i], view.alpha[i] },
+						view.texture[i],
+						{}
+					};
+					batch->add(view.mesh[i], data);
+					batchTextures->request(data.texture, data.transform[2] * batchPixels);
+				}
+				break;
+			}
+			case CMD_DRAW_TEXTURED:
+			{
+				const DrawTexturedPacket* packet = CommandBuffer::body<DrawTexturedPacket>(header);
+				textures->request(packet->texture, packet->screenPixels);
+				TexturedDraw* draw = arena->allocate<TexturedDraw>();
+				if (draw == NULL)
+				{
+					break;
+				}
+				draw->packet = packet;
+				draw->program = shaders->program(packet->draw.program);
+				if (draw->program != transformProgram)
+				{
+					transformProgram = draw->program;
+					transformLocation = glGetUniformLocation(draw->program, "uTransform");
+				}
+				draw->transformLocation = transformLocation;
+				draw->streamer = textures;
+				draw->texture = packet->texture;
+				draw->mesh = packet->mesh;
+				memcpy(draw->transform, packet->transform, sizeof(draw->transform));
+				*tail = draw;
+				tail = &draw->next;
+				break;
+			}
+			}
+		}
+	}
+
+	// cull phase: GPU culling for what was streamed (after commit, before the draw phase)
+	void cull()
+	{
+		if (batchActive)
+		{
+			batch->cull();
+		}
+	}
+
+	// after the scene is drawn: keep its depth for next frame's occlusion culling
+	void buildDepthPyramid(int width, int height, unsigned int framebuffer = 0)
+	{
+		if (batchActive)
+		{
+			batch->buildDepthPyramid(width, height, framebuffer);
+		}
+	}
+
+	// draw phase: every draw packet becomes a render queue item, then the queue is sorted and submitted
+	void draw(const FrameCommands& frame)
+	{
+		queue->begin();
+		TexturedDraw* textured = texturedDraws;
+		const CommandBuffer& buffer = frame.commands;
+		for (const CommandBuffer::Header* header = buffer.first(); header != NULL; header = buffer.next(header))
+		{
+			switch (header->type)
+			{
+			case CMD_DRAW_MESH:
+			{
+				const DrawMeshPacket* packet = CommandBuffer::body<DrawMeshPacket>(header);
+				DrawItem item;
+				item.program = shaders->program(packet->draw.program);
+				item.vertexArray = packet->mesh->VAO.get();
+				item.indexType = packet->mesh->indexType;
+				item.indexCount = packet->mesh->indexCount;
+				push(packet->draw, item);
+				break;
+			}
+			case CMD_SPRITES_DRAW:
+			{
+				DrawItem item;
+				item.program = shaders->program(CommandBuffer::body<DrawPacket>(header)->program);
+				item.callback = [](void* user) { ((InstanceBatch*)user)->draw(); };
+				item.user = sprites;
+				push(*CommandBuffer::body<DrawPacket>(header), item);
+				break;
+			}
+			case CMD_BATCH_DRAW:
+			{
+				if (!batch->isSupported())
+				{
+					break;
+				}
+				DrawItem item;
+				item.program = shaders->program(CommandBuffer::body<DrawPacket>(header)->program);
+				item.callback = [](void* user)
+				{
+					// the whole batch samples through the table: one bind (or none) for every draw in it
+					FrameRenderer* renderer = (FrameRenderer*)user;
+					renderer->batchTextures->bind();
+					renderer->batch->submit();
+				};
+				item.user = this;
+				push(*CommandBuffer::body<DrawPacket>(header), item);
+				break;
+			}
+			case CMD_DRAW_TEXTURED:
+			{
+				// stream() saw the same packets in the same order, minus any the arena had no room for
+				const DrawTexturedPacket* packet = CommandBuffer::body<DrawTexturedPacket>(header);
+				if (textured == NULL || textured->packet != packet)
+				{
+					break;
+				}
+				TexturedDraw& draw = *textured;
+				textured = textured->next;
+				DrawItem item;
+				item.program = draw.program;
+				item.texture = textures->name(packet->texture);
+				item.callback = drawTextured;
+				item.user = &draw;
+				push(packet->draw, item);
+				break;
+			}
+			}
+		}
+		queue->submit();
+	}
+
+private:
+	// what a textured draw's callback needs, resolved in the stream phase (texture names are only
+	// final after the streamer's update)
+	struct TexturedDraw
+	{
+		const DrawTexturedPacket* packet;
+		TexturedDraw* next;				// in packet order
+		unsigned int program;
+		int transformLocation;
+		const TextureStreamer* streamer;
+		uint32_t texture;
+		const Mesh* mesh;
+		float transform[4];
+	};
+
+	ShaderManager* shaders = NULL;
+	FrameRingBuffer* ring = NULL;
+	RenderQueue* queue = NULL;
+	InstanceBatch* sprites = NULL;
+	BatchRenderer* batch = NULL;
+	TextureTable* batchTextures = NULL;
+
+	bool batchActive = false;
+	float batchPixels = 0.0f;
+	TextureStreamer* textures = NULL;
+	LinearArena* arena = NULL;
+	TexturedDraw* texturedDraws = NULL;
+	unsigned int transformProgram = 0;
+	int transformLocation = -1;
+
+	static void drawTextured(void* user)
+	{
+		const TexturedDraw* draw = (const TexturedDraw*)user;
+		// textures are the point of these draws: wireframe would only show the quads
+		GLenum polygonMode = glState.currentPolygonMode();
+		glState.polygonMode(GL_FILL);
+		glState.useProgram(draw->program);
+		glUniform4fv(draw->transformLocation, 1, draw->transform);
+		glState.bindTexture(0, GL_TEXTURE_2D, draw->streamer->name(draw->texture));
+		glState.bindVertexArray(draw->mesh->VAO.get());
+		glDrawElements(GL_TRIANGLES, (GLsizei)draw->mesh->indexCount, draw->mesh->indexType, 0);
+		glState.polygonMode(polygonMode);
+	}
+
+	void push(const DrawPacket& draw, const DrawItem& item)
+	{
+		queue->push(makeSortKey(draw.pass, item.program, item.texture, draw.depth), item);
+	}
+};
+
+#endif
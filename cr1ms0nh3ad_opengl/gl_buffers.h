@@ -0,0 +1,190 @@
+#ifndef GL_BUFFERS_H
+#define GL_BUFFERS_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+// buffer and vertex array editing
+// -------------------------------
+// Everything that fills, maps or copies a buffer, or sets up a VAO's attributes, goes through these.
+// On a 4.5 context (or GL_ARB_direct_state_access, glext::directStateAccess) they are the named
+// calls, which edit the object without binding it: no bind-edit-unbind around every upload, no
+// disturbing whatever the draw code has bound, and a VAO's attribute format is set up once while
+// only the buffer it reads from moves (attributeBuffer). On 3.3 core they bind and edit:
+// buffers through GL_COPY_WRITE_BUFFER, which no draw reads from, so the draw bindings the state
+// cache holds stay put; VAOs through a real bind, with glVertexAttribPointer.
+//
+// Names must come from createBuffer / createVertexArray (GpuObject::create uses them): the named
+// calls need glCreate* names, which are objects from the start, where glGen* only reserves the name
+// until its first bind. Textures and framebuffers still bind to edit. GL thread only.
+namespace glbuffers
+{
+	inline unsigned int createBuffer()
+	{
+		unsigned int name = 0;
+		if (glext::directStateAccess)
+		{
+			glext::CreateBuffers(1, &name);
+		}
+		else
+		{
+			glGenBuffers(1, &name);
+		}
+		return name;
+	}
+
+	inline unsigned int createVertexArray()
+	{
+		unsigned int name = 0;
+		if (glext::directStateAccess)
+		{
+			glext::CreateVertexArrays(1, &name);
+		}
+		else
+		{
+			glGenVertexArrays(1, &name);
+		}
+		return name;
+	}
+
+	inline void data(unsigned int buffer, GLsizeiptr size, const void* bytes, GLenum usage)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::NamedBufferData(buffer, size, bytes, usage);
+			return;
+		}
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, bytes, usage);
+	}
+
+	inline void subData(unsigned int buffer, GLintptr offset, GLsizeiptr size, const void* bytes)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::NamedBufferSubData(buffer, offset, size, bytes);
+			return;
+		}
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, bytes);
+	}
+
+	// immutable storage; needs glext::bufferStorage (which every 4.5 context has)
+	inline void storage(unsigned int buffer, GLsizeiptr size, const void* bytes, GLbitfield flags)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::NamedBufferStorage(buffer, size, bytes, flags);
+			return;
+		}
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glext::BufferStorage(GL_COPY_WRITE_BUFFER, size, bytes, flags);
+	}
+
+	inline void* mapRange(unsigned int buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		if (glext::directStateAccess)
+		{
+			return glext::MapNamedBufferRange(buffer, offset, length, access);
+		}
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, access);
+	}
+
+	inline bool unmap(unsigned int buffer)
+	{
+		if (glext::directStateAccess)
+		{
+			return glext::UnmapNamedBuffer(buffer) == GL_TRUE;
+		}
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+	}
+
+	inline void copy(unsigned int source, unsigned int destination, GLintptr sourceOffset, GLintptr destinationOffset, GLsizeiptr size)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::CopyNamedBufferSubData(source, destination, sourceOffset, destinationOffset, size);
+			return;
+		}
+		glState.bindBuffer(GL_COPY_READ_BUFFER, source);
+		glState.bindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, destinationOffset, size);
+	}
+
+	// vertex attributes
+	// -----------------
+	// One buffer binding per attribute, numbered like the attribute, so an attribute's buffer and
+	// offset can be repointed without touching its format. The integer form (IFormat /
+	// glVertexAttribIPointer) is for attributes the shader reads as int / uint.
+	inline void attribute(unsigned int vertexArray, unsigned int location, unsigned int buffer, int components, GLenum type,
+		bool normalized, int stride, size_t offset, unsigned int divisor = 0, bool integer = false)
+	{
+		if (glext::directStateAccess)
+		{
+			if (integer)
+			{
+				glext::VertexArrayAttribIFormat(vertexArray, location, components, type, 0);
+			}
+			else
+			{
+				glext::VertexArrayAttribFormat(vertexArray, location, components, type, normalized ? GL_TRUE : GL_FALSE, 0);
+			}
+			glext::VertexArrayVertexBuffer(vertexArray, location, buffer, (GLintptr)offset, stride);
+			glext::VertexArrayAttribBinding(vertexArray, location, location);
+			glext::VertexArrayBindingDivisor(vertexArray, location, divisor);
+			glext::EnableVertexArrayAttrib(vertexArray, location);
+			return;
+		}
+		glState.bindVertexArray(vertexArray);
+		glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (integer)
+		{
+			glVertexAttribIPointer(location, components, type, stride, (void*)offset);
+		}
+		else
+		{
+			glVertexAttribPointer(location, components, type, normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+		}
+		glVertexAttribDivisor(location, divisor);
+		glEnableVertexAttribArray(location);
+	}
+
+	// move an attribute set up by attribute() to another buffer / offset, same format
+	inline void attributeBuffer(unsigned int vertexArray, unsigned int location, unsigned int buffer, int components, GLenum type,
+		bool normalized, int stride, size_t offset, bool integer = false)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::VertexArrayVertexBuffer(vertexArray, location, buffer, (GLintptr)offset, stride);
+			return;
+		}
+		glState.bindVertexArray(vertexArray);
+		glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (integer)
+		{
+			glVertexAttribIPointer(location, components, type, stride, (void*)offset);
+		}
+		else
+		{
+			glVertexAttribPointer(location, components, type, normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+		}
+	}
+
+	inline void elementBuffer(unsigned int vertexArray, unsigned int buffer)
+	{
+		if (glext::directStateAccess)
+		{
+			glext::VertexArrayElementBuffer(vertexArray, buffer);
+			glState.vertexArrayElementBufferChanged(vertexArray);
+			return;
+		}
+		glState.bindVertexArray(vertexArray);
+		glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+	}
+}
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+#include <glfw3.h>
+
+#include <cstddef>
+
+// entry points beyond the GL 3.3 core profile glad was generated for
+// ------------------------------------------------------------------
+// glad only loads 3.3 core, so anything newer is fetched by hand after gladLoadGLLoader and paired
+// with a flag telling whether the context really provides it (drivers usually hand out the highest
+// compatible version even though the window only asks for 3.3). Callers check the flag first.
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+// GL 4.3: multi-draw indirect + shader storage buffers
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+
+// GL 4.3: compute shaders (with the GL 4.2 image load/store and immutable textures they go with)
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+// GL 4.2 / ARB_texture_compression_bptc (BC7) and KHR_texture_compression_astc_ldr
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_6x6_KHR
+#define GL_COMPRESSED_RGBA_ASTC_6x6_KHR 0x93B4
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+#define GL_COMPRESSED_RGBA_ASTC_8x8_KHR 0x93B7
+#endif
+#ifndef GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR 0x93D0
+#endif
+#ifndef GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR 0x93D4
+#endif
+#ifndef GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR 0x93D7
+#endif
+
+// ARB_bindless_texture: 64 bit texture handles, resident while in use, sampled straight from buffer data
+// (no enums beyond the core ones)
+
+// GL 4.6 / ARB_indirect_parameters
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+
+namespace glext
+{
+	typedef void (APIENTRYP PFNGETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	typedef void (APIENTRYP PFNPROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	typedef void (APIENTRYP PFNPROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+	typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADS)(GLuint count);
+	typedef void (APIENTRYP PFNBUFFERSTORAGE)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+	typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+	typedef void (APIENTRYP PFNDISPATCHCOMPUTE)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	typedef void (APIENTRYP PFNMEMORYBARRIER)(GLbitfield barriers);
+	typedef void (APIENTRYP PFNBINDIMAGETEXTURE)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+	typedef void (APIENTRYP PFNTEXSTORAGE2D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+	typedef void (APIENTRYP PFNTEXSTORAGE3D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+	typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTCOUNT)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+	typedef void (APIENTRYP PFNCOPYIMAGESUBDATA)(GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ,
+		GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ, GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+	typedef GLuint64 (APIENTRYP PFNGETTEXTUREHANDLE)(GLuint texture);
+	typedef void (APIENTRYP PFNMAKETEXTUREHANDLERESIDENT)(GLuint64 handle);
+	typedef void (APIENTRYP PFNMAKETEXTUREHANDLENONRESIDENT)(GLuint64 handle);
+	typedef void (APIENTRYP PFNCREATEBUFFERS)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRYP PFNCREATEVERTEXARRAYS)(GLsizei n, GLuint* arrays);
+	typedef void (APIENTRYP PFNNAMEDBUFFERSTORAGE)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+	typedef void (APIENTRYP PFNNAMEDBUFFERDATA)(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+	typedef void (APIENTRYP PFNNAMEDBUFFERSUBDATA)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+	typedef void* (APIENTRYP PFNMAPNAMEDBUFFERRANGE)(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	typedef GLboolean (APIENTRYP PFNUNMAPNAMEDBUFFER)(GLuint buffer);
+	typedef void (APIENTRYP PFNCOPYNAMEDBUFFERSUBDATA)(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+	typedef void (APIENTRYP PFNVERTEXARRAYVERTEXBUFFER)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+	typedef void (APIENTRYP PFNVERTEXARRAYELEMENTBUFFER)(GLuint vaobj, GLuint buffer);
+	typedef void (APIENTRYP PFNVERTEXARRAYATTRIBFORMAT)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+	typedef void (APIENTRYP PFNVERTEXARRAYATTRIBIFORMAT)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLuint relativeoffset);
+	typedef void (APIENTRYP PFNVERTEXARRAYATTRIBBINDING)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+	typedef void (APIENTRYP PFNVERTEXARRAYBINDINGDIVISOR)(GLuint vaobj, GLuint bindingindex, GLuint divisor);
+	typedef void (APIENTRYP PFNENABLEVERTEXARRAYATTRIB)(GLuint vaobj, GLuint index);
+
+	inline PFNGETPROGRAMBINARY GetProgramBinary = NULL;
+	inline PFNPROGRAMBINARY ProgramBinary = NULL;
+	inline PFNPROGRAMPARAMETERI ProgramParameteri = NULL;
+	inline PFNMAXSHADERCOMPILERTHREADS MaxShaderCompilerThreads = NULL;
+	inline PFNBUFFERSTORAGE BufferStorage = NULL;
+	inline PFNMULTIDRAWELEMENTSINDIRECT MultiDrawElementsIndirect = NULL;
+	inline PFNDISPATCHCOMPUTE DispatchCompute = NULL;
+	inline PFNMEMORYBARRIER MemoryBarrierFn = NULL;		// glMemoryBarrier; winnt.h has a MemoryBarrier macro
+	inline PFNBINDIMAGETEXTURE BindImageTexture = NULL;
+	inline PFNTEXSTORAGE2D TexStorage2D = NULL;
+	inline PFNTEXSTORAGE3D TexStorage3D = NULL;
+	inline PFNMULTIDRAWELEMENTSINDIRECTCOUNT MultiDrawElementsIndirectCount = NULL;
+	inline PFNCOPYIMAGESUBDATA CopyImageSubData = NULL;
+	inline PFNGETTEXTUREHANDLE GetTextureHandle = NULL;
+	inline PFNMAKETEXTUREHANDLERESIDENT MakeTextureHandleResident = NULL;
+	inline PFNMAKETEXTUREHANDLENONRESIDENT MakeTextureHandleNonResident = NULL;
+	inline PFNCREATEBUFFERS CreateBuffers = NULL;
+	inline PFNCREATEVERTEXARRAYS CreateVertexArrays = NULL;
+	inline PFNNAMEDBUFFERSTORAGE NamedBufferStorage = NULL;
+	inline PFNNAMEDBUFFERDATA NamedBufferData = NULL;
+	inline PFNNAMEDBUFFERSUBDATA NamedBufferSubData = NULL;
+	inline PFNMAPNAMEDBUFFERRANGE MapNamedBufferRange = NULL;
+	inline PFNUNMAPNAMEDBUFFER UnmapNamedBuffer = NULL;
+	inline PFNCOPYNAMEDBUFFERSUBDATA CopyNamedBufferSubData = NULL;
+	inline PFNVERTEXARRAYVERTEXBUFFER VertexArrayVertexBuffer = NULL;
+	inline PFNVERTEXARRAYELEMENTBUFFER VertexArrayElementBuffer = NULL;
+	inline PFNVERTEXARRAYATTRIBFORMAT VertexArrayAttribFormat = NULL;
+	inline PFNVERTEXARRAYATTRIBIFORMAT VertexArrayAttribIFormat = NULL;
+	inline PFNVERTEXARRAYATTRIBBINDING VertexArrayAttribBinding = NULL;
+	inline PFNVERTEXARRAYBINDINGDIVISOR VertexArrayBindingDivisor = NULL;
+	inline PFNENABLEVERTEXARRAYATTRIB EnableVertexArrayAttrib = NULL;
+
+	inline bool programBinary = false;
+	inline bool parallelShaderCompile = false;
+	inline bool bufferStorage = false;
+	inline bool multiDrawIndirect = false;		// together with SSBOs and base instance, i.e. GL 4.3
+	inline bool computeShader = false;			// GL 4.3 compute with image load/store
+	inline bool indirectCount = false;			// draw count read from a buffer
+	inline bool textureStorage = false;			// immutable texture storage (glTexStorage2D / 3D)
+	inline bool copyImage = false;				// texture to texture copies on the GPU
+	inline bool textureBptc = false;			// BC7 (BC4 / BC5 are core since 3.0)
+	inline bool textureAstc = false;			// ASTC LDR, mostly mobile / integrated GPUs
+	inline bool bindlessTexture = false;		// texture handles in shader data instead of binds
+	inline bool directStateAccess = false;		// GL 4.5 named buffer / vertex array editing (see gl_buffers.h)
+
+	inline bool hasVersion(int major, int minor)
+	{
+		return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+	}
+
+	inline bool hasExtension(const char* name)
+	{
+		return glfwExtensionSupported(name) == GLFW_TRUE;
+	}
+
+	template <typename T>
+	inline bool loadProc(T& function, const char* name)
+	{
+		function = (T)glfwGetProcAddress(name);
+		return function != NULL;
+	}
+
+	// call once with the context current, right after gladLoadGLLoader
+	inline void load()
+	{
+		if (hasVersion(4, 1) || hasExtension("GL_ARB_get_program_binary"))
+		{
+			programBinary = loadProc(GetProgramBinary, "glGetProgramBinary")
+				&& loadProc(ProgramBinary, "glProgramBinary")
+				&& loadProc(ProgramParameteri, "glProgramParameteri");
+		}
+		if (hasExtension("GL_KHR_parallel_shader_compile"))
+		{
+			parallelShaderCompile = loadProc(MaxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR");
+		}
+		else if (hasExtension("GL_ARB_parallel_shader_compile"))
+		{
+			parallelShaderCompile = loadProc(MaxShaderCompilerThreads, "glMaxShaderCompilerThreadsARB");
+		}
+		if (hasVersion(4, 4) || hasExtension("GL_ARB_buffer_storage"))
+		{
+			bufferStorage = loadProc(BufferStorage, "glBufferStorage");
+		}
+		if (hasVersion(4, 2) || hasExtension("GL_ARB_texture_storage"))
+		{
+			textureStorage = loadProc(TexStorage2D, "glTexStorage2D")
+				&& loadProc(TexStorage3D, "glTexStorage3D");
+		}
+		if (hasVersion(4, 3))
+		{
+			multiDrawIndirect = loadProc(MultiDrawElementsIndirect, "glMultiDrawElementsIndirect");
+			computeShader = loadProc(DispatchCompute, "glDispatchCompute")
+				&& loadProc(MemoryBarrierFn, "glMemoryBarrier")
+				&& loadProc(BindImageTexture, "glBindImageTexture")
+				&& textureStorage;
+		}
+		if (hasVersion(4, 3) || hasExtension("GL_ARB_copy_image"))
+		{
+			copyImage = loadProc(CopyImageSubData, "glCopyImageSubData");
+		}
+		textureBptc = hasVersion(4, 2) || hasExtension("GL_ARB_texture_compression_bptc");
+		textureAstc = hasExtension("GL_KHR_texture_compression_astc_ldr");
+		if (hasExtension("GL_ARB_bindless_texture"))
+		{
+			bindlessTexture = loadProc(GetTextureHandle, "glGetTextureHandleARB")
+				&& loadProc(MakeTextureHandleResident, "glMakeTextureHandleResidentARB")
+				&& loadProc(MakeTextureHandleNonResident, "glMakeTextureHandleNonResidentARB");
+		}
+		if (hasVersion(4, 5) || hasExtension("GL_ARB_direct_state_access"))
+		{
+			directStateAccess = loadProc(CreateBuffers, "glCreateBuffers")
+				&& loadProc(CreateVertexArrays, "glCreateVertexArrays")
+				&& loadProc(NamedBufferStorage, "glNamedBufferStorage")
+				&& loadProc(NamedBufferData, "glNamedBufferData")
+				&& loadProc(NamedBufferSubData, "glNamedBufferSubData")
+				&& loadProc(MapNamedBufferRange, "glMapNamedBufferRange")
+				&& loadProc(UnmapNamedBuffer, "glUnmapNamedBuffer")
+				&& loadProc(CopyNamedBufferSubData, "glCopyNamedBufferSubData")
+				&& loadProc(VertexArrayVertexBuffer, "glVertexArrayVertexBuffer")
+				&& loadProc(VertexArrayElementBuffer, "glVertexArrayElementBuffer")
+				&& loadProc(VertexArrayAttribFormat, "glVertexArrayAttribFormat")
+				&& loadProc(VertexArrayAttribIFormat, "glVertexArrayAttribIFormat")
+				&& loadProc(VertexArrayAttribBinding, "glVertexArrayAttribBinding")
+				&& loadProc(VertexArrayBindingDivisor, "glVertexArrayBindingDivisor")
+				&& loadProc(EnableVertexArrayAttrib, "glEnableVertexArrayAttrib");
+		}
+		if (hasVersion(4, 6))
+		{
+			indirectCount = loadProc(MultiDrawElementsIndirectCount, "glMultiDrawElementsIndirectCount");
+		}
+		else if (hasExtension("GL_ARB_indirect_parameters"))
+		{
+			indirectCount = loadProc(MultiDrawElementsIndirectCount, "glMultiDrawElementsIndirectCountARB");
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,403 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+
+// GL state cache
+// --------------
+// Shadow copy of the binding and fixed-function state we touch, so a bind or enable that wouldn't
+// change anything never reaches the driver. Everything that binds programs, VAOs, buffers or
+// textures, or flips blend/depth/polygon state, goes through glState; anything that changes state
+// behind its back must call invalidate() afterwards. Every value starts out UNKNOWN, so the first
+// call for it is always issued.
+//
+// The element array binding is VAO state: it is forgotten whenever the VAO changes. Deleting an
+// object through the cache also drops it from the shadow state, since GL unbinds deleted names and
+// they can come back from glGen* (the current program is forgotten outright: it stays in use until
+// replaced, but its name may be reused).
+class GLStateCache
+{
+public:
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+	static const int BUFFER_TARGETS = 11;
+	static const int INDEXED_BINDINGS = 16;
+	static const int TEXTURE_UNITS = 32;
+	static const int CAPABILITIES = 4;
+
+	// calls that went to the driver vs. calls filtered out, for the current and the previous frame
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+	unsigned int lastIssued = 0;
+	unsigned int lastElided = 0;
+
+	void beginFrame()
+	{
+		lastIssued = issued;
+		lastElided = elided;
+		issued = 0;
+		elided = 0;
+	}
+
+	// forget everything, e.g. after code outside the cache changed GL state
+	void invalidate()
+	{
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		elementBuffer = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (int i = 0; i < BUFFER_TARGETS; i++)
+		{
+			buffers[i] = UNKNOWN;
+		}
+		for (int i = 0; i < INDEXED_BINDINGS; i++)
+		{
+			uniformBindings[i] = IndexedBinding();
+			storageBindings[i] = IndexedBinding();
+		}
+		for (int i = 0; i < TEXTURE_UNITS; i++)
+		{
+			textures[i] = UNKNOWN;
+			textureTargets[i] = 0;
+		}
+		for (int i = 0; i < CAPABILITIES; i++)
+		{
+			capabilities[i] = UNKNOWN;
+		}
+		blendSource = blendDestination = UNKNOWN;
+		depthFunction = UNKNOWN;
+		depthWrite = UNKNOWN;
+		polygon = UNKNOWN;
+	}
+
+	void useProgram(unsigned int name)
+	{
+		if (!changed(program, name))
+		{
+			return;
+		}
+		glUseProgram(name);
+	}
+
+	void bindVertexArray(unsigned int name)
+	{
+		if (!changed(vertexArray, name))
+		{
+			return;
+		}
+		glBindVertexArray(name);
+		elementBuffer = UNKNOWN;
+	}
+
+	void bindBuffer(GLenum target, unsigned int name)
+	{
+		unsigned int* slot = bufferSlot(target);
+		if (slot != NULL && !changed(*slot, name))
+		{
+			return;
+		}
+		if (slot == NULL)
+		{
+			issued++;
+		}
+		glBindBuffer(target, name);
+	}
+
+	// GL_UNIFORM_BUFFER / GL_SHADER_STORAGE_BUFFER ranges; like GL this also sets the generic binding
+	void bindBufferRange(GLenum target, unsigned int index, unsigned int name, GLintptr offset, GLsizeiptr size)
+	{
+		IndexedBinding* binding = indexedSlot(target, index);
+		unsigned int* generic = bufferSlot(target);
+		if (binding != NULL && binding->buffer == name && binding->offset == offset && binding->size == size)
+		{
+			elided++;
+			if (generic != NULL && *generic != name)
+			{
+				// the indexed bind also moves the generic binding, which has been rebound since
+				bindBuffer(target, name);
+			}
+			return;
+		}
+		issued++;
+		glBindBufferRange(target, index, name, offset, size);
+		if (binding != NULL)
+		{
+			binding->buffer = name;
+			binding->offset = offset;
+			binding->size = size;
+		}
+		if (generic != NULL)
+		{
+			*generic = name;
+		}
+	}
+
+	// bind to a texture unit; glActiveTexture is only issued when a bind actually happens
+	void bindTexture(unsigned int unit, GLenum target, unsigned int name)
+	{
+		if (unit >= (unsigned int)TEXTURE_UNITS)
+		{
+			issued++;
+			activeTexture(unit);
+			glBindTexture(target, name);
+			return;
+		}
+		if (textureTargets[unit] == target && !changed(textures[unit], name))
+		{
+			return;
+		}
+		if (textureTargets[unit] != target)
+		{
+			issued++;
+			textures[unit] = name;
+		}
+		textureTargets[unit] = target;
+		activeTexture(unit);
+		glBindTexture(target, name);
+	}
+
+	// GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST; anything else passes straight through
+	void setEnabled(GLenum capability, bool enabled)
+	{
+		int index = capabilityIndex(capability);
+		if (index >= 0 && !changed(capabilities[index], enabled ? 1u : 0u))
+		{
+			return;
+		}
+		if (index < 0)
+		{
+			issued++;
+		}
+		if (enabled)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+	}
+
+	void blendFunc(GLenum source, GLenum destination)
+	{
+		if (blendSource == source && blendDestination == destination)
+		{
+			elided++;
+			return;
+		}
+		issued++;
+		blendSource = source;
+		blendDestination = destination;
+		glBlendFunc(source, destination);
+	}
+
+	void depthFunc(GLenum function)
+	{
+		if (!changed(depthFunction, function))
+		{
+			return;
+		}
+		glDepthFunc(function);
+	}
+
+	void depthMask(bool write)
+	{
+		if (!changed(depthWrite, write ? 1u : 0u))
+		{
+			return;
+		}
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+
+	// front and back together, the only way core profile allows
+	void polygonMode(GLenum mode)
+	{
+		if (!changed(polygon, mode))
+		{
+			return;
+		}
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+
+	GLenum currentPolygonMode() const
+	{
+		return polygon == UNKNOWN ? GL_FILL : polygon;
+	}
+
+	// a VAO's element buffer was changed without binding it (direct state access, gl_buffers.h)
+	void vertexArrayElementBufferChanged(unsigned int name)
+	{
+		if (vertexArray == name)
+		{
+			elementBuffer = UNKNOWN;
+		}
+	}
+
+	void deleteProgram(unsigned int name)
+	{
+		if (program == name)
+		{
+			program = UNKNOWN;
+		}
+		glDeleteProgram(name);
+	}
+
+	void deleteVertexArrays(int count, const unsigned int* names)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (names[i] != 0 && vertexArray == names[i])
+			{
+				vertexArray = 0;
+				elementBuffer = UNKNOWN;
+			}
+		}
+		glDeleteVertexArrays(count, names);
+	}
+
+	void deleteBuffers(int count, const unsigned int* names)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (names[i] == 0)
+			{
+				continue;
+			}
+			forget(elementBuffer, names[i]);
+			for (int t = 0; t < BUFFER_TARGETS; t++)
+			{
+				forget(buffers[t], names[i]);
+			}
+			for (int b = 0; b < INDEXED_BINDINGS; b++)
+			{
+				if (uniformBindings[b].buffer == names[i])
+				{
+					uniformBindings[b] = IndexedBinding();
+				}
+				if (storageBindings[b].buffer == names[i])
+				{
+					storageBindings[b] = IndexedBinding();
+				}
+			}
+		}
+		glDeleteBuffers(count, names);
+	}
+
+	void deleteTextures(int count, const unsigned int* names)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			for (int unit = 0; names[i] != 0 && unit < TEXTURE_UNITS; unit++)
+			{
+				forget(textures[unit], names[i]);
+			}
+		}
+		glDeleteTextures(count, names);
+	}
+
+private:
+	struct IndexedBinding
+	{
+		unsigned int buffer = UNKNOWN;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	unsigned int program = UNKNOWN;
+	unsigned int vertexArray = UNKNOWN;
+	unsigned int elementBuffer = UNKNOWN;
+	unsigned int buffers[BUFFER_TARGETS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+	IndexedBinding uniformBindings[INDEXED_BINDINGS];
+	IndexedBinding storageBindings[INDEXED_BINDINGS];
+	unsigned int activeUnit = UNKNOWN;
+	unsigned int textures[TEXTURE_UNITS] = {};
+	GLenum textureTargets[TEXTURE_UNITS] = {};
+	unsigned int capabilities[CAPABILITIES] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+	unsigned int blendSource = UNKNOWN;
+	unsigned int blendDestination = UNKNOWN;
+	unsigned int depthFunction = UNKNOWN;
+	unsigned int depthWrite = UNKNOWN;
+	unsigned int polygon = UNKNOWN;
+
+	// record the new value and count the call; false when it was already current
+	bool changed(unsigned int& current, unsigned int value)
+	{
+		if (current == value)
+		{
+			elided++;
+			return false;
+		}
+		issued++;
+		current = value;
+		return true;
+	}
+
+	void forget(unsigned int& slot, unsigned int name)
+	{
+		if (slot == name)
+		{
+			slot = 0;
+		}
+	}
+
+	void activeTexture(unsigned int unit)
+	{
+		if (activeUnit != unit)
+		{
+			activeUnit = unit;
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+	unsigned int* bufferSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+		case GL_ARRAY_BUFFER: return &buffers[0];
+		case GL_COPY_READ_BUFFER: return &buffers[1];
+		case GL_COPY_WRITE_BUFFER: return &buffers[2];
+		case GL_PIXEL_PACK_BUFFER: return &buffers[3];
+		case GL_PIXEL_UNPACK_BUFFER: return &buffers[4];
+		case GL_UNIFORM_BUFFER: return &buffers[5];
+		case GL_TEXTURE_BUFFER: return &buffers[6];
+		case GL_DRAW_INDIRECT_BUFFER: return &buffers[7];
+		case GL_SHADER_STORAGE_BUFFER: return &buffers[8];
+		case GL_TRANSFORM_FEEDBACK_BUFFER: return &buffers[9];
+		case GL_PARAMETER_BUFFER: return &buffers[10];
+		}
+		return NULL;
+	}
+
+	IndexedBinding* indexedSlot(GLenum target, unsigned int index)
+	{
+		if (index >= (unsigned int)INDEXED_BINDINGS)
+		{
+			return NULL;
+		}
+		switch (target)
+		{
+		case GL_UNIFORM_BUFFER: return &uniformBindings[index];
+		case GL_SHADER_STORAGE_BUFFER: return &storageBindings[index];
+		}
+		return NULL;
+	}
+
+	int capabilityIndex(GLenum capability) const
+	{
+		switch (capability)
+		{
+		case GL_BLEND: return 0;
+		case GL_DEPTH_TEST: return 1;
+		case GL_CULL_FACE: return 2;
+		case GL_SCISSOR_TEST: return 3;
+		}
+		return -1;
+	}
+};
+
+// the one cache for the one GL context
+inline GLStateCache glState;
+
+#endif
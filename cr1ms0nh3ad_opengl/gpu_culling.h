@@ -0,0 +1,595 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "mesh_file.h"
+#include "shader.h"
+#include "simd_math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one object as the cull pass reads it, std430 (transform, color and texture are the batch's per-draw data)
+// --------------------------------------------------------------------------------------------------------
+struct CullObject
+{
+	uint32_t mesh;
+	uint32_t padding[3];
+	float transform[4];		// x, y, scale, rotation
+	float color[4];
+	uint32_t texture;
+	uint32_t dataPadding[3];
+};
+
+// what the cull pass needs to know about a mesh to emit its draw, std430
+// ----------------------------------------------------------------------
+struct CullMesh
+{
+	uint32_t lodCount;
+	int32_t baseVertex;
+	float radius;			// bounding sphere around the mesh origin, in mesh units
+	uint32_t padding;
+	MeshLod lods[MESH_MAX_LODS];	// firstIndex is absolute in the shared index buffer
+};
+
+// level of detail from projected error
+// ------------------------------------
+// A level is good enough when its error, scaled to the object and the screen, stays within
+// threshold pixels; the coarsest such level is drawn. With a fade band the next coarser level is
+// blended in over the band before it takes over: t is that level's projected error in thresholds
+// and coverage runs from 0 at t = 1 + band to 1 at t = 1, the finer level covering the rest.
+// Both are drawn with complementary screen-door dither (no sorting, no blending), so the batch's
+// color alpha carries the coverage: a in [0, 1] keeps the pixels whose dither value is below a,
+// a in [-1, 0) keeps the ones at or above a + 1. The cull shader below does the same on the GPU.
+struct LodSelection
+{
+	uint32_t lod;
+	float fade;				// coverage of lod + 1 drawn over lod, 0 when there is nothing to fade
+};
+
+inline LodSelection selectLod(const MeshLod* lods, uint32_t lodCount, float scale, float pixelsPerUnit, float threshold, float fadeBand)
+{
+	LodSelection selection = { 0, 0.0f };
+	if (pixelsPerUnit <= 0.0f || threshold <= 0.0f)
+	{
+		return selection;
+	}
+	float toPixels = scale * pixelsPerUnit / threshold;
+	while (selection.lod + 1 < lodCount && lods[selection.lod + 1].error * toPixels <= 1.0f)
+	{
+		selection.lod++;
+	}
+	if (fadeBand > 0.0f && selection.lod + 1 < lodCount)
+	{
+		float t = lods[selection.lod + 1].error * toPixels;
+		selection.fade = t < 1.0f + fadeBand ? 1.0f - (t - 1.0f) / fadeBand : 0.0f;
+	}
+	return selection;
+}
+
+// cull pass: bounding spheres against the frustum and the hierarchical depth
+// ----------------------------------------------------------------------------
+// One invocation per object. A sphere survives the frustum if it is not entirely behind any of the
+// six planes; it survives occlusion if its nearest depth is not behind the farthest depth the
+// pyramid holds for the screen rectangle it covers (read at the mip level where that rectangle is
+// at most two texels wide, so four taps cover it). Survivors pick their level of detail (selectLod)
+// and append their indirect command and per-draw data, two of each while cross-fading, through an
+// atomic counter. Without COMPACT (no indirect-count draw to consume a GPU-side count) every object
+// keeps its own two slots and unused ones get instanceCount = 0.
+inline const char* cullComputeShaderSource =
+	"#version 430 core\n"
+	"layout (local_size_x = 64) in;\n"
+	"struct DrawData\n"
+	"{\n"
+	"	vec4 transform;\n"
+	"	vec4 color;\n"
+	"	uint texture;\n"
+	"};\n"
+	"struct Object\n"
+	"{\n"
+	"	uint mesh;\n"
+	"	DrawData data;\n"
+	"};\n"
+	"struct Lod\n"
+	"{\n"
+	"	uint firstIndex;\n"
+	"	uint indexCount;\n"
+	"	float error;\n"
+	"	uint padding;\n"
+	"};\n"
+	"struct MeshInfo\n"
+	"{\n"
+	"	uint lodCount;\n"
+	"	int baseVertex;\n"
+	"	float radius;\n"
+	"	uint padding;\n"
+	"	Lod lods[8];\n"
+	"};\n"
+	"struct Command\n"
+	"{\n"
+	"	uint count;\n"
+	"	uint instanceCount;\n"
+	"	uint firstIndex;\n"
+	"	int baseVertex;\n"
+	"	uint baseInstance;\n"
+	"};\n"
+	"layout (std430, binding = 1) readonly buffer Objects { Object objects[]; };\n"
+	"layout (std430, binding = 2) readonly buffer Meshes { MeshInfo meshes[]; };\n"
+	"layout (std430, binding = 3) writeonly buffer Commands { Command commands[]; };\n"
+	"layout (std430, binding = 4) writeonly buffer Draws { DrawData draws[]; };\n"
+	"layout (std430, binding = 5) buffer Counter { uint visibleCount; };\n"
+	"uniform uint uObjectCount;\n"
+	"uniform vec4 uPlanes[6];\n"
+	"uniform mat4 uViewProjection;\n"
+	"uniform float uRadiusScale;\n"
+	"uniform sampler2D uHiZ;\n"
+	"uniform vec2 uHiZSize;\n"
+	"uniform float uHiZMaxLevel;\n"
+	"uniform bool uOcclusion;\n"
+	"uniform float uLodPixels;\n"
+	"uniform float uLodThreshold;\n"
+	"uniform float uLodFadeBand;\n"
+	"bool occluded(vec3 center, float radius)\n"
+	"{\n"
+	"	vec3 ndc = (uViewProjection * vec4(center, 1.0)).xyz;\n"
+	"	float r = radius * uRadiusScale;\n"
+	"	vec2 lo = clamp((ndc.xy - r) * 0.5 + 0.5, 0.0, 1.0);\n"
+	"	vec2 hi = clamp((ndc.xy + r) * 0.5 + 0.5, 0.0, 1.0);\n"
+	"	float nearest = (ndc.z - r) * 0.5 + 0.5;\n"
+	"	vec2 size = (hi - lo) * uHiZSize;\n"
+	"	float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, uHiZMaxLevel);\n"
+	"	float farthest = max(max(textureLod(uHiZ, lo, level).r, textureLod(uHiZ, vec2(hi.x, lo.y), level).r),\n"
+	"		max(textureLod(uHiZ, vec2(lo.x, hi.y), level).r, textureLod(uHiZ, hi, level).r));\n"
+	"	return nearest > farthest;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	uint i = gl_GlobalInvocationID.x;\n"
+	"	if (i >= uObjectCount)\n"
+	"	{\n"
+	"		return;\n"
+	"	}\n"
+	"	Object object = objects[i];\n"
+	"	MeshInfo mesh = meshes[object.mesh];\n"
+	"	vec3 center = vec3(object.data.transform.xy, 0.0);\n"
+	"	float radius = mesh.radius * object.data.transform.z;\n"
+	"	bool visible = true;\n"
+	"	for (int p = 0; p < 6; p++)\n"
+	"	{\n"
+	"		visible = visible && dot(uPlanes[p].xyz, center) + uPlanes[p].w > -radius;\n"
+	"	}\n"
+	"	visible = visible && !(uOcclusion && occluded(center, radius));\n"
+	"	uint lod = 0u;\n"
+	"	float fade = 0.0;\n"
+	"	if (uLodPixels > 0.0 && uLodThreshold > 0.0)\n"
+	"	{\n"
+	"		float toPixels = object.data.transform.z * uLodPixels / uLodThreshold;\n"
+	"		while (lod + 1u < mesh.lodCount && mesh.lods[lod + 1u].error * toPixels <= 1.0)\n"
+	"		{\n"
+	"			lod++;\n"
+	"		}\n"
+	"		if (uLodFadeBand > 0.0 && lod + 1u < mesh.lodCount)\n"
+	"		{\n"
+	"			float t = mesh.lods[lod + 1u].error * toPixels;\n"
+	"			fade = t < 1.0 + uLodFadeBand ? 1.0 - (t - 1.0) / uLodFadeBand : 0.0;\n"
+	"		}\n"
+	"	}\n"
+	"	uint emitted = !visible ? 0u : (fade > 0.0 ? 2u : 1u);\n"
+	"#ifdef COMPACT\n"
+	"	if (emitted == 0u)\n"
+	"	{\n"
+	"		return;\n"
+	"	}\n"
+	"	uint slot = atomicAdd(visibleCount, emitted);\n"
+	"#else\n"
+	"	uint slot = i * 2u;\n"
+	"	if (emitted != 0u)\n"
+	"	{\n"
+	"		atomicAdd(visibleCount, emitted);\n"
+	"	}\n"
+	"#endif\n"
+	"	Lod finer = mesh.lods[lod];\n"
+	"	DrawData data = object.data;\n"
+	"	data.color.a = fade > 0.0 ? fade - 1.0 : data.color.a;\n"
+	"	commands[slot] = Command(finer.indexCount, emitted != 0u ? 1u : 0u, finer.firstIndex, mesh.baseVertex, slot);\n"
+	"	draws[slot] = data;\n"
+	"#ifdef COMPACT\n"
+	"	if (emitted == 2u)\n"
+	"#endif\n"
+	"	{\n"
+	"		Lod coarser = mesh.lods[min(lod + 1u, mesh.lodCount - 1u)];\n"
+	"		data.color.a = fade;\n"
+	"		commands[slot + 1u] = Command(coarser.indexCount, emitted == 2u ? 1u : 0u, coarser.firstIndex, mesh.baseVertex, slot + 1u);\n"
+	"		draws[slot + 1u] = data;\n"
+	"	}\n"
+	"}\0";
+
+// depth pyramid: level 0 copies the depth texture, every further level keeps the farthest of the
+// texels below it (including the extra row/column of an odd-sized level, so it stays conservative)
+// ------------------------------------------------------------------------------------------------
+inline const char* hiZComputeShaderSource =
+	"#version 430 core\n"
+	"layout (local_size_x = 8, local_size_y = 8) in;\n"
+	"layout (r32f, binding = 0) readonly uniform image2D uSource;\n"
+	"layout (r32f, binding = 1) writeonly uniform image2D uTarget;\n"
+	"uniform sampler2D uDepth;\n"
+	"uniform bool uFromDepth;\n"
+	"uniform ivec2 uSourceSize;\n"
+	"uniform ivec2 uTargetSize;\n"
+	"float load(ivec2 p)\n"
+	"{\n"
+	"	return imageLoad(uSource, min(p, uSourceSize - 1)).r;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	ivec2 t = ivec2(gl_GlobalInvocationID.xy);\n"
+	"	if (any(greaterThanEqual(t, uTargetSize)))\n"
+	"	{\n"
+	"		return;\n"
+	"	}\n"
+	"	float depth;\n"
+	"	if (uFromDepth)\n"
+	"	{\n"
+	"		depth = texelFetch(uDepth, t, 0).r;\n"
+	"	}\n"
+	"	else\n"
+	"	{\n"
+	"		ivec2 s = t * 2;\n"
+	"		depth = max(max(load(s), load(s + ivec2(1, 0))), max(load(s + ivec2(0, 1)), load(s + ivec2(1, 1))));\n"
+	"		bvec2 extra = bvec2(t.x == uTargetSize.x - 1 && (uSourceSize.x & 1) != 0, t.y == uTargetSize.y - 1 && (uSourceSize.y & 1) != 0);\n"
+	"		if (extra.x)\n"
+	"		{\n"
+	"			depth = max(depth, max(load(s + ivec2(2, 0)), load(s + ivec2(2, 1))));\n"
+	"		}\n"
+	"		if (extra.y)\n"
+	"		{\n"
+	"			depth = max(depth, max(load(s + ivec2(0, 2)), load(s + ivec2(1, 2))));\n"
+	"		}\n"
+	"		if (extra.x && extra.y)\n"
+	"		{\n"
+	"			depth = max(depth, load(s + ivec2(2, 2)));\n"
+	"		}\n"
+	"	}\n"
+	"	imageStore(uTarget, t, vec4(depth));\n"
+	"}\0";
+
+// GPU culling for indirect draws
+// ------------------------------
+// cull() runs the pass above over an object array the caller streamed into a buffer, and writes
+// the surviving draws' indirect commands and per-draw data into buffers owned here; draw() issues
+// them, with the draw count read from the GPU counter when indirect-count draws are available. The
+// CPU only ever sees the object list: visibility never comes back to it.
+//
+// Occlusion tests against the previous frame's depth: buildDepthPyramid() copies the scene's depth
+// (the window's, or an offscreen target's in the same format) after the scene is drawn and reduces
+// it into an R32F mip chain, which the next frame's cull() reads. Objects that moved into view from behind an occluder can therefore
+// show up a frame late. The occlusion test maps the sphere to the screen with the view-projection
+// as an affine transform, exact for the orthographic / 2D transforms the batch renderer uses; the
+// frustum test works for any matrix. The matrix must match what the vertex shader applies
+// (identity by default, batch positions are already in clip space). Each object can become two
+// draws while it cross-fades between levels of detail, so there is room for twice maxObjects.
+// Needs GL 4.3 compute; isSupported() is false otherwise and nothing is created.
+class GpuCuller
+{
+public:
+	static const unsigned int OBJECT_BINDING = 1;
+	static const unsigned int MESH_BINDING = 2;
+	static const unsigned int COMMAND_BINDING = 3;
+	static const unsigned int DRAW_BINDING = 4;
+	static const unsigned int COUNTER_BINDING = 5;
+	static const unsigned int HI_Z_UNIT = 8;
+	static const uint32_t GROUP_SIZE = 64;
+	static const uint32_t COMMAND_SIZE = 5 * sizeof(uint32_t);
+	static const uint32_t DRAW_SIZE = 12 * sizeof(float);		// BatchDrawData: transform, color, texture + padding
+
+	bool init(uint32_t maxObjects)
+	{
+		if (!glext::computeShader || !glext::multiDrawIndirect)
+		{
+			std::cout << "GPU_CULLING::UNSUPPORTED (needs GL 4.3 compute)" << std::endl;
+			return false;
+		}
+		compact = glext::indirectCount;
+		cullProgram = linkCompute(cullComputeShaderSource, compact ? "#define COMPACT\n" : "");
+		hiZProgram = linkCompute(hiZComputeShaderSource, "");
+		if (cullProgram == 0 || hiZProgram == 0)
+		{
+			glState.deleteProgram(cullProgram);
+			glState.deleteProgram(hiZProgram);
+			return false;
+		}
+		capacity = maxObjects;
+		drawCapacity = maxObjects * 2;
+		meshBuffer.create(GPU_CATEGORY_CULLING);
+		commandBuffer.create(GPU_CATEGORY_CULLING);
+		drawBuffer.create(GPU_CATEGORY_CULLING);
+		counterBuffer.create(GPU_CATEGORY_CULLING);
+		allocate(commandBuffer, (size_t)drawCapacity * COMMAND_SIZE);
+		allocate(drawBuffer, (size_t)drawCapacity * DRAW_SIZE);
+		allocate(counterBuffer, sizeof(uint32_t));
+
+		setViewProjection(mat4Identity());
+		supported = true;
+		return true;
+	}
+
+	void destroy()
+	{
+		if (!supported)
+		{
+			return;
+		}
+		glState.deleteProgram(cullProgram);
+		glState.deleteProgram(hiZProgram);
+		meshBuffer.reset();
+		commandBuffer.reset();
+		drawBuffer.reset();
+		counterBuffer.reset();
+		destroyPyramid();
+		supported = false;
+	}
+
+	bool isSupported() const
+	{
+		return supported;
+	}
+
+	// true when draws come out compacted and draw() takes its count from the GPU
+	bool isCompacting() const
+	{
+		return compact;
+	}
+
+	void setMesh(uint32_t handle, const CullMesh& mesh)
+	{
+		if (handle >= meshes.size())
+		{
+			meshes.resize(handle + 1, CullMesh());
+		}
+		meshes[handle] = mesh;
+		meshesDirty = true;
+	}
+
+	void setViewProjection(const Mat4& matrix)
+	{
+		viewProjection = matrix;
+		frustum = frustumFromMatrix(matrix);
+		radiusScale = mat4MaxScale(matrix);		// world to NDC size of a radius
+	}
+
+	// enable or skip the occlusion test (the frustum test always runs)
+	void setOcclusion(bool enabled)
+	{
+		occlusion = enabled;
+	}
+
+	// level of detail parameters for selectLod (pixelsPerUnit 0 always draws full detail)
+	void setLodSelection(float pixelsPerUnit, float threshold, float fadeBand)
+	{
+		lodPixels = pixelsPerUnit;
+		lodThreshold = threshold;
+		lodFadeBand = fadeBand;
+	}
+
+	// cull count CullObjects at offset in objectBuffer; the results are ready for draw() after this
+	void cull(unsigned int objectBuffer, size_t offset, uint32_t count)
+	{
+		count = count < capacity ? count : capacity;
+		objects = count;
+		if (count == 0)
+		{
+			return;
+		}
+		if (meshesDirty)
+		{
+			allocate(meshBuffer, meshes.size() * sizeof(CullMesh), meshes.data());
+			meshesDirty = false;
+		}
+		uint32_t zero = 0;
+		glbuffers::subData(counterBuffer.get(), 0, sizeof(zero), &zero);
+
+		glState.useProgram(cullProgram);
+		glUniform1ui(glGetUniformLocation(cullProgram, "uObjectCount"), count);
+		glUniform4fv(glGetUniformLocation(cullProgram, "uPlanes"), 6, &frustum.planes[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(cullProgram, "uViewProjection"), 1, GL_FALSE, viewProjection.m);
+		glUniform1f(glGetUniformLocation(cullProgram, "uRadiusScale"), radiusScale);
+		bool useHiZ = occlusion && pyramidLevels > 0;
+		glUniform1i(glGetUniformLocation(cullProgram, "uOcclusion"), useHiZ ? 1 : 0);
+		glUniform1i(glGetUniformLocation(cullProgram, "uHiZ"), HI_Z_UNIT);
+		glUniform2f(glGetUniformLocation(cullProgram, "uHiZSize"), (float)pyramidWidth, (float)pyramidHeight);
+		glUniform1f(glGetUniformLocation(cullProgram, "uHiZMaxLevel"), (float)(pyramidLevels > 0 ? pyramidLevels - 1 : 0));
+		glUniform1f(glGetUniformLocation(cullProgram, "uLodPixels"), lodPixels);
+		glUniform1f(glGetUniformLocation(cullProgram, "uLodThreshold"), lodThreshold);
+		glUniform1f(glGetUniformLocation(cullProgram, "uLodFadeBand"), lodFadeBand);
+		glState.bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, useHiZ ? pyramid.get() : 0);
+
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer, offset, (size_t)count * sizeof(CullObject));
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, meshBuffer.get(), 0, meshes.size() * sizeof(CullMesh));
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer.get(), 0, (size_t)drawCapacity * COMMAND_SIZE);
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_BINDING, drawBuffer.get(), 0, (size_t)drawCapacity * DRAW_SIZE);
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer.get(), 0, sizeof(uint32_t));
+		glext::DispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		glext::MemoryBarrierFn(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// issue what the last cull() kept; the vertex shader reads the per-draw data at drawDataBinding
+	void draw(unsigned int vertexArray, unsigned int drawDataBinding, GLenum mode, GLenum indexType)
+	{
+		if (objects == 0)
+		{
+			return;
+		}
+		glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, drawDataBinding, drawBuffer.get(), 0, (size_t)drawCapacity * DRAW_SIZE);
+		glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.get());
+		glState.bindVertexArray(vertexArray);
+		if (compact)
+		{
+			glState.bindBuffer(GL_PARAMETER_BUFFER, counterBuffer.get());
+			glext::MultiDrawElementsIndirectCount(mode, indexType, (void*)0, 0, (GLsizei)(objects * 2), 0);
+		}
+		else
+		{
+			glext::MultiDrawElementsIndirect(mode, indexType, (void*)0, (GLsizei)(objects * 2), 0);
+		}
+	}
+
+	// copy the default framebuffer's depth and reduce it for the next frame's occlusion test
+	void buildDepthPyramid(int width, int height, unsigned int sourceFramebuffer = 0)
+	{
+		if (!occlusion || width <= 0 || height <= 0 || hiZBroken)
+		{
+			return;
+		}
+		if (width != pyramidWidth || height != pyramidHeight)
+		{
+			createPyramid(width, height);
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer.get());
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, sourceFramebuffer);
+		if (!blitChecked)
+		{
+			// the blit needs the window's depth format to match ours; without it there is no occlusion
+			blitChecked = true;
+			if (glGetError() != GL_NO_ERROR)
+			{
+				std::cout << "GPU_CULLING::DEPTH_COPY_FAILED (occlusion culling disabled)" << std::endl;
+				hiZBroken = true;
+				destroyPyramid();
+				return;
+			}
+		}
+
+		glState.useProgram(hiZProgram);
+		glUniform1i(glGetUniformLocation(hiZProgram, "uDepth"), HI_Z_UNIT);
+		glState.bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, depthTexture.get());
+		int sourceWidth = width, sourceHeight = height;
+		for (int level = 0; level < pyramidLevels; level++)
+		{
+			int targetWidth = level == 0 ? width : (sourceWidth / 2 > 0 ? sourceWidth / 2 : 1);
+			int targetHeight = level == 0 ? height : (sourceHeight / 2 > 0 ? sourceHeight / 2 : 1);
+			glUniform1i(glGetUniformLocation(hiZProgram, "uFromDepth"), level == 0 ? 1 : 0);
+			glUniform2i(glGetUniformLocation(hiZProgram, "uSourceSize"), sourceWidth, sourceHeight);
+			glUniform2i(glGetUniformLocation(hiZProgram, "uTargetSize"), targetWidth, targetHeight);
+			glext::BindImageTexture(0, pyramid.get(), level > 0 ? level - 1 : 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			glext::BindImageTexture(1, pyramid.get(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glext::DispatchCompute((targetWidth + 7) / 8, (targetHeight + 7) / 8, 1);
+			glext::MemoryBarrierFn(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			sourceWidth = targetWidth;
+			sourceHeight = targetHeight;
+		}
+		glext::MemoryBarrierFn(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+private:
+	bool supported = false;
+	bool compact = false;
+	bool occlusion = true;
+	bool blitChecked = false;
+	bool hiZBroken = false;
+	uint32_t capacity = 0;
+	uint32_t drawCapacity = 0;
+	uint32_t objects = 0;
+
+	unsigned int cullProgram = 0;
+	unsigned int hiZProgram = 0;
+	GpuBuffer meshBuffer;
+	GpuBuffer commandBuffer;
+	GpuBuffer drawBuffer;
+	GpuBuffer counterBuffer;
+	std::vector<CullMesh> meshes;
+	bool meshesDirty = false;
+
+	Mat4 viewProjection = {};
+	Frustum frustum = {};
+	float radiusScale = 1.0f;
+	float lodPixels = 0.0f;
+	float lodThreshold = 0.0f;
+	float lodFadeBand = 0.0f;
+
+	GpuTexture depthTexture;
+	GpuFramebuffer depthFramebuffer;
+	GpuTexture pyramid;
+	int pyramidWidth = 0;
+	int pyramidHeight = 0;
+	int pyramidLevels = 0;
+
+	static unsigned int linkCompute(const char* source, const std::string& defines)
+	{
+		unsigned int shader = compileShader(GL_COMPUTE_SHADER, injectDefines(source, defines));
+		if (shader == 0)
+		{
+			return 0;
+		}
+		unsigned int program = glCreateProgram();
+		glAttachShader(program, shader);
+		glLinkProgram(program);
+		glDeleteShader(shader);
+		if (!checkLinkStatus(program))
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void allocate(GpuBuffer& buffer, size_t size, const void* data = NULL)
+	{
+		glbuffers::data(buffer.get(), size, data, GL_DYNAMIC_DRAW);
+		buffer.setBytes(size);
+	}
+
+	void createPyramid(int width, int height)
+	{
+		destroyPyramid();
+		pyramidWidth = width;
+		pyramidHeight = height;
+		int largest = width > height ? width : height;
+		pyramidLevels = 1;
+		while (largest > 1)
+		{
+			largest /= 2;
+			pyramidLevels++;
+		}
+
+		// same format as the window's depth buffer, so the blit is a plain copy
+		depthTexture.create(GPU_CATEGORY_CULLING, (size_t)width * height * 4);
+		glState.bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, depthTexture.get());
+		glext::TexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		depthFramebuffer.create(GPU_CATEGORY_CULLING);
+		glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer.get());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture.get(), 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		pyramid.create(GPU_CATEGORY_CULLING, (size_t)width * height * 4 * 4 / 3);
+		glState.bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, pyramid.get());
+		glext::TexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	// retired, not deleted: a resize recreates the pyramid while frames that read it are in flight
+	void destroyPyramid()
+	{
+		depthFramebuffer.reset();
+		depthTexture.reset();
+		pyramid.reset();
+		pyramidWidth = pyramidHeight = pyramidLevels = 0;
+	}
+};
+
+#endif
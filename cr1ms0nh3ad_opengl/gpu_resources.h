@@ -0,0 +1,412 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+// what a GL object's memory is for, totalled per category by the registry
+enum GpuCategory
+{
+	GPU_CATEGORY_MESH,			// vertex / index buffers and their VAOs
+	GPU_CATEGORY_TEXTURE,		// sampled textures (streamed levels, texture tables)
+	GPU_CATEGORY_STREAMING,		// frame ring, upload staging
+	GPU_CATEGORY_CULLING,		// culling buffers, depth pyramid
+	GPU_CATEGORY_OTHER,
+	GPU_CATEGORY_COUNT
+};
+
+inline const char* gpuCategoryName(GpuCategory category)
+{
+	static const char* names[GPU_CATEGORY_COUNT] = { "mesh", "texture", "streaming", "culling", "other" };
+	return category < GPU_CATEGORY_COUNT ? names[category] : "?";
+}
+
+enum GpuObjectType
+{
+	GPU_OBJECT_BUFFER,
+	GPU_OBJECT_VERTEX_ARRAY,
+	GPU_OBJECT_TEXTURE,
+	GPU_OBJECT_FRAMEBUFFER,
+	GPU_OBJECT_PROGRAM
+};
+
+// GPU resource registry: live memory per category and fence-deferred deletion
+// ---------------------------------------------------------------------------
+// GL objects owned through a GpuObject (below) are counted here while they live. Letting go of one
+// doesn't delete it: it is retired, tagged with the frame that retired it, and only deleted once
+// the fence behind that frame has signalled, i.e. once no command that could still use it is
+// queued or running. Deleting an object the GPU is still reading is legal GL, but some drivers
+// resolve it by waiting (or flushing) right there; this way a texture the streamer replaced or a
+// mesh unloaded mid-frame costs nothing at the point it goes. Bindless handles of retired
+// textures are made non-resident at the same time, for the same reason.
+//
+// Retired objects wait in a fixed ring, so retiring never allocates; when it's full the oldest
+// frame is waited for. endFrame() fences what the frame retired, collect() deletes whatever has
+// signalled (both GL thread, once per frame). destroy() deletes everything that is left at once
+// and closes the registry: whatever is retired after that (destructors running after the context
+// went away) is dropped without a GL call.
+class GpuResourceRegistry
+{
+public:
+	static const uint32_t MAX_RETIRED = 1024;
+	static const uint32_t MAX_FENCES = 8;
+
+	struct Stats
+	{
+		size_t liveBytes[GPU_CATEGORY_COUNT] = {};
+		uint32_t liveObjects[GPU_CATEGORY_COUNT] = {};
+		size_t retiredBytes = 0;			// still waiting for their fence
+		uint32_t retiredObjects = 0;
+		uint64_t deletedObjects = 0;		// since startup
+		uint32_t forcedWaits = 0;			// retire() or endFrame() had to wait for the GPU to make room
+	};
+
+	// a new object starts counting (GpuObject does this)
+	void add(GpuCategory category, size_t bytes)
+	{
+		status.liveBytes[category] += bytes;
+		status.liveObjects[category]++;
+	}
+
+	// an object's storage changed size
+	void resize(GpuCategory category, size_t oldBytes, size_t newBytes)
+	{
+		status.liveBytes[category] += newBytes;
+		status.liveBytes[category] -= oldBytes;
+	}
+
+	// stop counting name as live and delete it once the frames that may use it are done
+	void retire(GpuObjectType type, unsigned int name, GpuCategory category, size_t bytes, uint64_t bindlessHandle = 0)
+	{
+		status.liveBytes[category] -= bytes;
+		status.liveObjects[category]--;
+		if (closed || name == 0)
+		{
+			return;
+		}
+		if (retiredTail - retiredHead == MAX_RETIRED)
+		{
+			status.forcedWaits++;
+			if (fenceHead == fenceTail)
+			{
+				fence();
+			}
+			waitOldest();
+		}
+		Retired& entry = retired[retiredTail++ % MAX_RETIRED];
+		entry.type = type;
+		entry.name = name;
+		entry.bytes = bytes;
+		entry.bindlessHandle = bindlessHandle;
+		status.retiredBytes += bytes;
+		status.retiredObjects++;
+	}
+
+	// GL thread, after the frame's last command: everything retired so far goes once this fence is done
+	void endFrame()
+	{
+		if (retiredTail == fencedUpTo)
+		{
+			return;
+		}
+		if (fenceTail - fenceHead == MAX_FENCES)
+		{
+			status.forcedWaits++;
+			waitOldest();
+		}
+		fence();
+	}
+
+	// GL thread: delete what the GPU is done with, never waits
+	void collect()
+	{
+		while (fenceHead != fenceTail)
+		{
+			Fence& oldest = fences[fenceHead % MAX_FENCES];
+			if (glClientWaitSync(oldest.sync, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				return;
+			}
+			release(oldest);
+		}
+	}
+
+	// delete everything now (before the context goes) and drop whatever is retired afterwards
+	void destroy()
+	{
+		while (fenceHead != fenceTail)
+		{
+			release(fences[fenceHead % MAX_FENCES]);
+		}
+		while (retiredHead != retiredTail)
+		{
+			remove(retired[retiredHead++ % MAX_RETIRED]);
+		}
+		fencedUpTo = retiredTail;
+		closed = true;
+	}
+
+	size_t liveBytes() const
+	{
+		size_t total = 0;
+		for (int i = 0; i < GPU_CATEGORY_COUNT; i++)
+		{
+			total += status.liveBytes[i];
+		}
+		return total;
+	}
+
+	const Stats& stats() const
+	{
+		return status;
+	}
+
+	// one line per category, for logs
+	void print() const
+	{
+		for (int i = 0; i < GPU_CATEGORY_COUNT; i++)
+		{
+			std::cout << "GPU_RESOURCES::" << gpuCategoryName((GpuCategory)i) << " " << status.liveObjects[i] << " objects, "
+				<< status.liveBytes[i] / 1024 << " KB" << std::endl;
+		}
+		std::cout << "GPU_RESOURCES::retired " << status.retiredObjects << " objects, " << status.retiredBytes / 1024 << " KB pending, "
+			<< status.deletedObjects << " deleted, " << status.forcedWaits << " forced waits" << std::endl;
+	}
+
+private:
+	struct Retired
+	{
+		GpuObjectType type = GPU_OBJECT_BUFFER;
+		unsigned int name = 0;
+		size_t bytes = 0;
+		uint64_t bindlessHandle = 0;
+	};
+
+	struct Fence
+	{
+		GLsync sync = NULL;
+		uint32_t retiredEnd = 0;		// covers retired[.. retiredEnd)
+	};
+
+	Retired retired[MAX_RETIRED];
+	uint32_t retiredHead = 0;			// ring counters, wrap along with the indices
+	uint32_t retiredTail = 0;
+	uint32_t fencedUpTo = 0;
+	Fence fences[MAX_FENCES];
+	uint32_t fenceHead = 0;
+	uint32_t fenceTail = 0;
+	bool closed = false;
+	Stats status;
+
+	void fence()
+	{
+		Fence& next = fences[fenceTail++ % MAX_FENCES];
+		next.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next.retiredEnd = retiredTail;
+		fencedUpTo = retiredTail;
+	}
+
+	void waitOldest()
+	{
+		Fence& oldest = fences[fenceHead % MAX_FENCES];
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (glClientWaitSync(oldest.sync, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+		{
+			flags = 0;
+		}
+		release(oldest);
+	}
+
+	// the fence is done (or we stopped caring): delete what it covers
+	void release(Fence& done)
+	{
+		while (retiredHead != done.retiredEnd)
+		{
+			remove(retired[retiredHead++ % MAX_RETIRED]);
+		}
+		glDeleteSync(done.sync);
+		done = Fence();
+		fenceHead++;
+	}
+
+	void remove(const Retired& entry)
+	{
+		switch (entry.type)
+		{
+		case GPU_OBJECT_BUFFER:
+			glState.deleteBuffers(1, &entry.name);
+			break;
+		case GPU_OBJECT_VERTEX_ARRAY:
+			glState.deleteVertexArrays(1, &entry.name);
+			break;
+		case GPU_OBJECT_TEXTURE:
+			if (entry.bindlessHandle != 0)
+			{
+				glext::MakeTextureHandleNonResident(entry.bindlessHandle);
+			}
+			glState.deleteTextures(1, &entry.name);
+			break;
+		case GPU_OBJECT_FRAMEBUFFER:
+			glDeleteFramebuffers(1, &entry.name);
+			break;
+		case GPU_OBJECT_PROGRAM:
+			glState.deleteProgram(entry.name);
+			break;
+		}
+		status.retiredBytes -= entry.bytes;
+		status.retiredObjects--;
+		status.deletedObjects++;
+	}
+};
+
+// the one registry for the one GL context
+inline GpuResourceRegistry gpuResources;
+
+// move-only owner of one GL object
+// --------------------------------
+// create() makes the object and counts it under a category, adopt() takes over a name made
+// elsewhere (a linked program, a buffer from createStaticBuffer); setBytes() keeps the registry's
+// totals in step with the storage behind it. Going out of scope, reset() or being assigned over
+// retires the object through gpuResources, so it is deleted once the GPU is done with it. GL
+// thread only, like the objects themselves.
+template <GpuObjectType TYPE>
+class GpuObject
+{
+public:
+	GpuObject() = default;
+
+	~GpuObject()
+	{
+		reset();
+	}
+
+	GpuObject(GpuObject&& other) noexcept
+		: object(other.object), category(other.category), bytes(other.bytes), bindlessHandle(other.bindlessHandle)
+	{
+		other.forget();
+	}
+
+	GpuObject& operator=(GpuObject&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			object = other.object;
+			category = other.category;
+			bytes = other.bytes;
+			bindlessHandle = other.bindlessHandle;
+			other.forget();
+		}
+		return *this;
+	}
+
+	GpuObject(const GpuObject&) = delete;
+	GpuObject& operator=(const GpuObject&) = delete;
+
+	// a fresh object (whatever was held before is retired)
+	unsigned int create(GpuCategory owner, size_t storageBytes = 0)
+	{
+		unsigned int name = 0;
+		switch (TYPE)
+		{
+		case GPU_OBJECT_BUFFER:
+			name = glbuffers::createBuffer();
+			break;
+		case GPU_OBJECT_VERTEX_ARRAY:
+			name = glbuffers::createVertexArray();
+			break;
+		case GPU_OBJECT_TEXTURE:
+			glGenTextures(1, &name);
+			break;
+		case GPU_OBJECT_FRAMEBUFFER:
+			glGenFramebuffers(1, &name);
+			break;
+		case GPU_OBJECT_PROGRAM:
+			name = glCreateProgram();
+			break;
+		}
+		adopt(name, owner, storageBytes);
+		return name;
+	}
+
+	// own name from here on (0 just resets)
+	void adopt(unsigned int name, GpuCategory owner, size_t storageBytes = 0)
+	{
+		reset();
+		if (name == 0)
+		{
+			return;
+		}
+		object = name;
+		category = owner;
+		bytes = storageBytes;
+		gpuResources.add(category, bytes);
+	}
+
+	void setBytes(size_t storageBytes)
+	{
+		if (object != 0)
+		{
+			gpuResources.resize(category, bytes, storageBytes);
+			bytes = storageBytes;
+		}
+	}
+
+	// textures only: the resident handle to make non-resident before the texture goes
+	void setBindlessHandle(uint64_t handle)
+	{
+		bindlessHandle = handle;
+	}
+
+	void reset()
+	{
+		if (object != 0)
+		{
+			gpuResources.retire(TYPE, object, category, bytes, bindlessHandle);
+		}
+		forget();
+	}
+
+	unsigned int get() const
+	{
+		return object;
+	}
+
+	size_t size() const
+	{
+		return bytes;
+	}
+
+	explicit operator bool() const
+	{
+		return object != 0;
+	}
+
+private:
+	unsigned int object = 0;
+	GpuCategory category = GPU_CATEGORY_OTHER;
+	size_t bytes = 0;
+	uint64_t bindlessHandle = 0;
+
+	void forget()
+	{
+		object = 0;
+		bytes = 0;
+		bindlessHandle = 0;
+	}
+};
+
+typedef GpuObject<GPU_OBJECT_BUFFER> GpuBuffer;
+typedef GpuObject<GPU_OBJECT_VERTEX_ARRAY> GpuVertexArray;
+typedef GpuObject<GPU_OBJECT_TEXTURE> GpuTexture;
+typedef GpuObject<GPU_OBJECT_FRAMEBUFFER> GpuFramebuffer;
+typedef GpuObject<GPU_OBJECT_PROGRAM> GpuProgram;
+
+#endif
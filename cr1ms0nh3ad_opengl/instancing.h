@@ -0,0 +1,219 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glfw3.h>
+
+#include "gl_buffers.h"
+#include "gl_state.h"
+#include "mesh.h"
+#include "ring_buffer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// per-instance data: 2D transform (offset, uniform scale, rotation in radians) and an RGBA8 color
+// ----------------------------------------------------------------------------------------------
+struct SpriteInstance
+{
+	float x, y;
+	float scale;
+	float rotation;
+	uint8_t color[4];
+};
+
+// instanced drawing over an existing mesh
+// ---------------------------------------
+// attach() adds two per-instance attributes (glVertexAttribDivisor 1) to the mesh's own VAO:
+// location 1 = vec4 transform, location 2 = vec4 color (normalized bytes). The instance data itself
+// lives in the frame ring buffer; write() hands out this frame's slice to fill in place and draw()
+// points the attributes at it (with direct state access only the buffer offset moves, the attribute
+// format set up by attach() stays). Shaders that don't declare them are unaffected, so the mesh draws as
+// before without instancing. One draw() is one glDrawElementsInstanced, whatever the instance count.
+class InstanceBatch
+{
+public:
+	static const unsigned int TRANSFORM_LOCATION = 1;
+	static const unsigned int COLOR_LOCATION = 2;
+
+	void attach(const Mesh& target, unsigned int maxInstances, const FrameRingBuffer& ring)
+	{
+		mesh = &target;
+		capacity = maxInstances;
+		instanceBuffer = ring.buffer();
+
+		unsigned int vertexArray = mesh->VAO.get();
+		glbuffers::attribute(vertexArray, TRANSFORM_LOCATION, instanceBuffer, 4, GL_FLOAT, false, sizeof(SpriteInstance), 0, 1);
+		glbuffers::attribute(vertexArray, COLOR_LOCATION, instanceBuffer, 4, GL_UNSIGNED_BYTE, true, sizeof(SpriteInstance), 4 * sizeof(float), 1);
+		glState.bindVertexArray(0);
+	}
+
+	// room for count instances this frame, written directly into the ring (NULL if it is full)
+	SpriteInstance* write(FrameRingBuffer& ring, unsigned int count)
+	{
+		count = count < capacity ? count : capacity;
+		FrameRingBuffer::Allocation allocation = ring.allocate(count * sizeof(SpriteInstance), sizeof(SpriteInstance));
+		instanceCount = allocation.data != NULL ? count : 0;
+		instanceBuffer = ring.buffer();
+		instanceOffset = allocation.offset;
+		return (SpriteInstance*)allocation.data;
+	}
+
+	// copy already built instance data in
+	void update(FrameRingBuffer& ring, const SpriteInstance* instances, unsigned int count)
+	{
+		SpriteInstance* destination = write(ring, count);
+		if (destination != NULL)
+		{
+			memcpy(destination, instances, instanceCount * sizeof(SpriteInstance));
+		}
+	}
+
+	// draw the first count instances (all written ones by default); the program must be in use
+	void draw(int count = -1) const
+	{
+		unsigned int instances = count < 0 || (unsigned int)count > instanceCount ? instanceCount : (unsigned int)count;
+		if (instances == 0)
+		{
+			return;
+		}
+		setPointers();
+		glState.bindVertexArray(mesh->VAO.get());
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, mesh->indexType, 0, instances);
+	}
+
+	unsigned int size() const
+	{
+		return instanceCount;
+	}
+
+private:
+	const Mesh* mesh = NULL;
+	unsigned int capacity = 0;
+	unsigned int instanceCount = 0;
+	unsigned int instanceBuffer = 0;
+	size_t instanceOffset = 0;
+
+	// the mesh VAO's instance attributes -> this frame's slice of the ring
+	void setPointers() const
+	{
+		unsigned int vertexArray = mesh->VAO.get();
+		glbuffers::attributeBuffer(vertexArray, TRANSFORM_LOCATION, instanceBuffer, 4, GL_FLOAT, false, sizeof(SpriteInstance), instanceOffset);
+		glbuffers::attributeBuffer(vertexArray, COLOR_LOCATION, instanceBuffer, 4, GL_UNSIGNED_BYTE, true, sizeof(SpriteInstance), instanceOffset + 4 * sizeof(float));
+	}
+};
+
+// lay total sprites out on a square grid covering clip space, each spinning at its own rate;
+// fills instances [first, first + count) of them into instances[0, count)
+// -----------------------------------------------------------------------------------------
+inline void fillSpriteGrid(SpriteInstance* instances, unsigned int first, unsigned int count, unsigned int total, float time)
+{
+	unsigned int side = (unsigned int)std::ceil(std::sqrt((float)total));
+	side = side == 0 ? 1 : side;
+	float cell = 2.0f / side;
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		unsigned int column = i % side, row = i / side;
+		SpriteInstance& sprite = instances[i - first];
+		sprite.x = -1.0f + cell * (column + 0.5f);
+		sprite.y = -1.0f + cell * (row + 0.5f);
+		sprite.scale = cell * 1.2f;
+		sprite.rotation = time * (0.5f + (i % 7) * 0.25f);
+		sprite.color[0] = (uint8_t)(255 * column / side);
+		sprite.color[1] = (uint8_t)(255 * row / side);
+		sprite.color[2] = (uint8_t)(255 - 255 * column / side);
+		sprite.color[3] = 255;
+	}
+}
+
+inline void fillSpriteGrid(SpriteInstance* instances, unsigned int count, float time)
+{
+	fillSpriteGrid(instances, 0, count, count, time);
+}
+
+// instancing benchmark
+// --------------------
+// Sweeps the sprite count and, for every count, renders FRAMES frames once with a single instanced
+// draw and once the naive way (one glUniform + glDrawElements per sprite). Prints the average frame
+// time and draw calls + sprites per second so the CPU cost of per-object draws is plain to see.
+// The instanced path streams its instances through the ring every frame, as a dynamic scene would.
+// transformLocation/colorLocation are the uniforms of singleProgram that take the per-sprite data.
+inline void runInstancingBenchmark(GLFWwindow* window, const Mesh& mesh, InstanceBatch& batch, FrameRingBuffer& ring,
+	unsigned int instancedProgram, unsigned int singleProgram, int transformLocation, int colorLocation)
+{
+	const unsigned int COUNTS[] = { 1, 10, 100, 1000, 10000, 50000, 100000 };
+	const int WARMUP_FRAMES = 10;
+	const int FRAMES = 120;
+	const unsigned int PER_DRAW_LIMIT = 10000;	// beyond this the naive path just takes forever
+	typedef std::chrono::steady_clock Clock;
+
+	std::vector<SpriteInstance> sprites(COUNTS[sizeof(COUNTS) / sizeof(COUNTS[0]) - 1]);
+	glfwSwapInterval(0);
+
+	printf("%10s  %-9s  %10s  %14s  %14s\n", "sprites", "mode", "frame ms", "draws/sec", "sprites/sec");
+	for (unsigned int count : COUNTS)
+	{
+		fillSpriteGrid(sprites.data(), count, 0.0f);
+
+		for (int instanced = 1; instanced >= 0 && !glfwWindowShouldClose(window); instanced--)
+		{
+			if (!instanced && count > PER_DRAW_LIMIT)
+			{
+				printf("%10u  %-9s  %10s\n", count, "per-draw", "skipped");
+				continue;
+			}
+
+			Clock::time_point start;
+			for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++)
+			{
+				if (frame == WARMUP_FRAMES)
+				{
+					glFinish();
+					start = Clock::now();
+				}
+				ring.beginFrame();
+				if (instanced)
+				{
+					batch.update(ring, sprites.data(), count);
+				}
+				ring.commit();
+
+				glClear(GL_COLOR_BUFFER_BIT);
+				if (instanced)
+				{
+					glState.useProgram(instancedProgram);
+					batch.draw(count);
+				}
+				else
+				{
+					glState.useProgram(singleProgram);
+					glState.bindVertexArray(mesh.VAO.get());
+					for (unsigned int i = 0; i < count; i++)
+					{
+						const SpriteInstance& s = sprites[i];
+						glUniform4f(transformLocation, s.x, s.y, s.scale, s.rotation);
+						glUniform4f(colorLocation, s.color[0] / 255.0f, s.color[1] / 255.0f, s.color[2] / 255.0f, 1.0f);
+						glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0);
+					}
+				}
+				ring.endFrame();
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+			}
+			glFinish();
+
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			double frameMs = seconds * 1000.0 / FRAMES;
+			double drawsPerSecond = (instanced ? 1.0 : count) * FRAMES / seconds;
+			printf("%10u  %-9s  %10.3f  %14.0f  %14.0f\n", count, instanced ? "instanced" : "per-draw",
+				frameMs, drawsPerSecond, (double)count * FRAMES / seconds);
+		}
+	}
+	glState.bindVertexArray(0);
+}
+
+#endif
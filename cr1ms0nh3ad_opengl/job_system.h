@@ -0,0 +1,542 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a unit of work: function(data, begin, end), and the counter it decrements when done
+// -----------------------------------------------------------------------------------
+struct JobCounter
+{
+	std::atomic<int> pending { 0 };
+};
+
+struct Job
+{
+	typedef void (*Function)(void* data, uint32_t begin, uint32_t end);
+
+	Function function = NULL;
+	void* data = NULL;
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	JobCounter* counter = NULL;
+	std::atomic<bool> queued { false };		// record in use until some thread has started running it
+};
+
+// Chase-Lev work-stealing deque (fixed capacity, C11 memory model version of Le et al. 2013)
+// ----------------------------------------------------------------------------------------
+// The owning thread push()es and pop()s at the bottom, LIFO, so it keeps working on what is hot in
+// its cache; any other thread steal()s the oldest job from the top. Only the last element is ever
+// contended, and that race is settled with one CAS on top.
+class WorkStealingDeque
+{
+public:
+	static const int64_t CAPACITY = 4096;
+
+	bool push(Job* job)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY)
+		{
+			return false;
+		}
+		jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	Job* pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+
+		Job* job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// last one: race the thieves for it
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				job = NULL;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* steal()
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+		{
+			return NULL;
+		}
+		Job* job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return NULL;
+		}
+		return job;
+	}
+
+	// a snapshot, only good as a hint
+	bool empty() const
+	{
+		return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> top { 0 };
+	alignas(64) std::atomic<int64_t> bottom { 0 };
+	std::atomic<Job*> jobs[CAPACITY] = {};
+};
+
+// job system
+// ----------
+// A fixed pool of worker threads plus the thread that called start() (index 0), each with its own
+// deque and its own ring of Job records, so creating and queueing a job takes no lock and no
+// allocation. Idle threads steal from a random victim and only go to sleep after a while without
+// finding anything. wait() never blocks while there is work: the waiting thread runs queued jobs
+// (its own first, then stolen ones) until the counter drops to zero, which gives fiber-like
+// dependent waits without switching stacks. Only the registered threads may create jobs, and
+// every created job must be run(). Job records come from a per-thread ring; a record is free again
+// once a thread has started its job (the job runs from a copy), and since a deque holds at most
+// half the ring, create() always finds a free one close by.
+class JobSystem
+{
+public:
+	static const uint32_t POOL_SIZE = 2 * WorkStealingDeque::CAPACITY;
+	static const int MAX_THREADS = 64;
+	static const int MAX_SLEEP_MS = 64;
+
+	struct Stats
+	{
+		uint64_t executed = 0;
+		uint64_t stolen = 0;
+		uint64_t stealAttempts = 0;
+	};
+
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// an early return must not leave joinable worker threads behind
+	~JobSystem()
+	{
+		if (!workers.empty())
+		{
+			stop();
+		}
+	}
+
+	void start(int threads)
+	{
+		threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+		workers.resize(threads);
+		for (int i = 0; i < threads; i++)
+		{
+			workers[i] = new Worker();
+			workers[i]->random = 0x9E3779B9u * (i + 1);
+		}
+		running.store(true);
+		threadIndex() = 0;
+		threadOwner() = this;
+		for (int i = 1; i < threads; i++)
+		{
+			threadHandles.emplace_back([this, i] { loop(i); });
+		}
+	}
+
+	void stop()
+	{
+		running.store(false);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_all();
+		for (std::thread& thread : threadHandles)
+		{
+			thread.join();
+		}
+		threadHandles.clear();
+		for (Worker* worker : workers)
+		{
+			delete worker;
+		}
+		workers.clear();
+		threadOwner() = NULL;
+	}
+
+	int size() const
+	{
+		return (int)workers.size();
+	}
+
+	// index of the calling thread in [0, size()), -1 for threads outside the pool
+	int currentThread() const
+	{
+		return threadOwner() == this ? threadIndex() : -1;
+	}
+
+	Job* create(Job::Function function, void* data, uint32_t begin, uint32_t end, JobCounter* counter)
+	{
+		Worker& worker = *workers[threadIndex()];
+		Job* job = &worker.pool[worker.allocated++ & (POOL_SIZE - 1)];
+		while (job->queued.load(std::memory_order_acquire))
+		{
+			job = &worker.pool[worker.allocated++ & (POOL_SIZE - 1)];
+		}
+		job->queued.store(true, std::memory_order_relaxed);
+		job->function = function;
+		job->data = data;
+		job->begin = begin;
+		job->end = end;
+		job->counter = counter;
+		return job;
+	}
+
+	// queue on the calling thread's deque (runs inline when it is full)
+	void run(Job* job)
+	{
+		if (job->counter != NULL)
+		{
+			job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (!workers[threadIndex()]->deque.push(job))
+		{
+			execute(*workers[threadIndex()], job);
+			return;
+		}
+		// pairs with the fence in loop(): either a sleeper sees this job or we see the sleeper, and
+		// taking the lock makes sure it is really waiting before it is notified
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed) > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			wake.notify_one();
+		}
+	}
+
+	// help out until every job counted by counter has finished
+	void wait(JobCounter& counter)
+	{
+		Worker& worker = *workers[threadIndex()];
+		while (counter.pending.load(std::memory_order_acquire) > 0)
+		{
+			Job* job = find(worker);
+			if (job != NULL)
+			{
+				execute(worker, job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// body(begin, end) over [0, count) in slices of at most batch (0: about four slices per thread).
+	// The range is split in halves, each job queueing its upper half before working on the lower
+	// one: thieves take the biggest pieces, and no thread ever has more than log2(count / batch)
+	// of these jobs outstanding.
+	template <typename F>
+	void parallelFor(uint32_t count, uint32_t batch, const F& body)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		if (batch == 0)
+		{
+			batch = count / (size() * 4);
+			batch = batch == 0 ? 1 : batch;
+		}
+		JobCounter counter;
+		ParallelFor<F> context = { this, &body, batch, &counter };
+		run(create(&split<F>, &context, 0, count, &counter));
+		wait(counter);
+	}
+
+	// summed over all threads since start() or the last resetStats()
+	Stats stats() const
+	{
+		Stats total;
+		for (const Worker* worker : workers)
+		{
+			total.executed += worker->executed.load(std::memory_order_relaxed);
+			total.stolen += worker->stolen.load(std::memory_order_relaxed);
+			total.stealAttempts += worker->stealAttempts.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	void resetStats()
+	{
+		for (Worker* worker : workers)
+		{
+			worker->executed.store(0, std::memory_order_relaxed);
+			worker->stolen.store(0, std::memory_order_relaxed);
+			worker->stealAttempts.store(0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	struct alignas(64) Worker
+	{
+		WorkStealingDeque deque;
+		Job pool[POOL_SIZE];
+		uint32_t allocated = 0;
+		uint32_t random = 1;
+		std::atomic<uint64_t> executed { 0 };
+		std::atomic<uint64_t> stolen { 0 };
+		std::atomic<uint64_t> stealAttempts { 0 };
+	};
+
+	std::vector<Worker*> workers;
+	std::vector<std::thread> threadHandles;
+	std::atomic<bool> running { false };
+	std::atomic<int> sleeping { 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	static int& threadIndex()
+	{
+		thread_local int index = 0;
+		return index;
+	}
+
+	static JobSystem*& threadOwner()
+	{
+		thread_local JobSystem* owner = NULL;
+		return owner;
+	}
+
+	template <typename F>
+	struct ParallelFor
+	{
+		JobSystem* system;
+		const F* body;
+		uint32_t batch;
+		JobCounter* counter;
+	};
+
+	template <typename F>
+	static void split(void* data, uint32_t begin, uint32_t end)
+	{
+		ParallelFor<F>& context = *(ParallelFor<F>*)data;
+		while (end - begin > context.batch)
+		{
+			uint32_t middle = begin + (end - begin) / 2;
+			context.system->run(context.system->create(&split<F>, data, middle, end, context.counter));
+			end = middle;
+		}
+		(*context.body)(begin, end);
+	}
+
+	// runs from a copy and hands the record back first, so long jobs (ones that wait themselves)
+	// don't hold on to it
+	void execute(Worker& worker, Job* record)
+	{
+		Job::Function function = record->function;
+		void* data = record->data;
+		uint32_t begin = record->begin, end = record->end;
+		JobCounter* counter = record->counter;
+		record->queued.store(false, std::memory_order_release);
+
+		function(data, begin, end);
+		worker.executed.store(worker.executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (counter != NULL)
+		{
+			counter->pending.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	bool hasQueuedJobs() const
+	{
+		for (const Worker* other : workers)
+		{
+			if (!other->deque.empty())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// own deque first, then one steal attempt from a random other thread
+	Job* find(Worker& worker)
+	{
+		Job* job = worker.deque.pop();
+		if (job != NULL || workers.size() < 2)
+		{
+			return job;
+		}
+
+		worker.random ^= worker.random << 13;
+		worker.random ^= worker.random >> 17;
+		worker.random ^= worker.random << 5;
+		size_t victim = worker.random % workers.size();
+		if (workers[victim] == &worker)
+		{
+			victim = (victim + 1) % workers.size();
+		}
+		worker.stealAttempts.store(worker.stealAttempts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		job = workers[victim]->deque.steal();
+		if (job != NULL)
+		{
+			worker.stolen.store(worker.stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	void loop(int index)
+	{
+		threadIndex() = index;
+		threadOwner() = this;
+		Worker& worker = *workers[index];
+		int idle = 0;
+		int sleepMs = 1;
+		while (running.load(std::memory_order_relaxed))
+		{
+			Job* job = find(worker);
+			if (job != NULL)
+			{
+				execute(worker, job);
+				idle = 0;
+				sleepMs = 1;
+				continue;
+			}
+
+			// spin a little before sleeping; run() wakes sleepers, the timeout is only a safety net and
+			// backs off while nothing arrives, so an idle application leaves its cores asleep
+			if (++idle < 64)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleeping.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!hasQueuedJobs())
+			{
+				wake.wait_for(lock, std::chrono::milliseconds(sleepMs));
+			}
+			sleeping.fetch_sub(1);
+			sleepMs = sleepMs < MAX_SLEEP_MS ? sleepMs * 2 : MAX_SLEEP_MS;
+			idle = 0;
+		}
+	}
+};
+
+// job system benchmark
+// --------------------
+// Runs the same workloads through the job system and through std::async (one task per slice, the
+// way code without a scheduler tends to do it) and prints jobs per second and the steal rate.
+// Workloads: empty jobs (pure scheduling overhead) and a small arithmetic kernel per element. The
+// rate is leaf slices per second; the job system also runs the splitting jobs in between.
+inline void runJobBenchmark(JobSystem& jobs)
+{
+	typedef std::chrono::steady_clock Clock;
+	const uint32_t ELEMENTS = 1 << 18;
+	const int REPEATS = 10;
+	const uint32_t BATCHES[] = { 64, 256, 1024, 4096, 16384 };
+	std::vector<float> values(ELEMENTS, 1.0f);
+
+	auto kernel = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			float x = values[i];
+			for (int k = 0; k < 16; k++)
+			{
+				x = x * 0.999f + 0.001f;
+			}
+			values[i] = x;
+		}
+	};
+	auto empty = [](uint32_t, uint32_t) {};
+
+	printf("job system: %d threads\n", jobs.size());
+	printf("%-8s  %8s  %-10s  %10s  %14s  %10s\n", "work", "batch", "scheduler", "ms", "slices/sec", "steal %");
+	for (int work = 0; work < 2; work++)
+	{
+		for (uint32_t batch : BATCHES)
+		{
+			uint32_t slices = (ELEMENTS + batch - 1) / batch;
+			for (int scheduler = 0; scheduler < 2; scheduler++)
+			{
+				jobs.resetStats();
+				Clock::time_point start = Clock::now();
+				for (int r = 0; r < REPEATS; r++)
+				{
+					if (scheduler == 0)
+					{
+						if (work == 0)
+						{
+							jobs.parallelFor(ELEMENTS, batch, empty);
+						}
+						else
+						{
+							jobs.parallelFor(ELEMENTS, batch, kernel);
+						}
+					}
+					else
+					{
+						std::vector<std::future<void>> futures;
+						futures.reserve(slices);
+						for (uint32_t begin = 0; begin < ELEMENTS; begin += batch)
+						{
+							uint32_t end = ELEMENTS - begin > batch ? begin + batch : ELEMENTS;
+							if (work == 0)
+							{
+								futures.push_back(std::async(std::launch::async, empty, begin, end));
+							}
+							else
+							{
+								futures.push_back(std::async(std::launch::async, kernel, begin, end));
+							}
+						}
+						for (std::future<void>& future : futures)
+						{
+							future.wait();
+						}
+					}
+				}
+				double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / REPEATS;
+				JobSystem::Stats stats = jobs.stats();
+				double stealRate = scheduler == 0 && stats.executed ? 100.0 * stats.stolen / stats.executed : 0.0;
+				printf("%-8s  %8u  %-10s  %10.3f  %14.0f  ", work == 0 ? "empty" : "kernel", batch,
+					scheduler == 0 ? "jobs" : "std::async", ms, slices * 1000.0 / ms);
+				if (scheduler == 0)
+				{
+					printf("%10.1f\n", stealRate);
+				}
+				else
+				{
+					printf("%10s\n", "-");
+				}
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// block compressed texture formats we can hand to GL as they are stored
+// ---------------------------------------------------------------------
+// vkFormat is the KTX2 (Vulkan) format number the file carries. Every format here is a 2D block
+// format: a level is ceil(w / blockWidth) * ceil(h / blockHeight) blocks of blockBytes each.
+struct TextureFormat
+{
+	uint32_t vkFormat;
+	GLenum internalFormat;
+	uint32_t blockWidth;
+	uint32_t blockHeight;
+	uint32_t blockBytes;
+	const char* name;
+};
+
+const uint32_t VK_FORMAT_BC4_UNORM_BLOCK = 139;
+const uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+const uint32_t VK_FORMAT_BC5_SNORM_BLOCK = 142;
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+const uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+const uint32_t VK_FORMAT_ASTC_4x4_UNORM_BLOCK = 157;
+const uint32_t VK_FORMAT_ASTC_4x4_SRGB_BLOCK = 158;
+const uint32_t VK_FORMAT_ASTC_6x6_UNORM_BLOCK = 165;
+const uint32_t VK_FORMAT_ASTC_6x6_SRGB_BLOCK = 166;
+const uint32_t VK_FORMAT_ASTC_8x8_UNORM_BLOCK = 171;
+const uint32_t VK_FORMAT_ASTC_8x8_SRGB_BLOCK = 172;
+
+inline const TextureFormat TEXTURE_FORMATS[] =
+{
+	{ VK_FORMAT_BC4_UNORM_BLOCK, GL_COMPRESSED_RED_RGTC1, 4, 4, 8, "BC4" },
+	{ VK_FORMAT_BC5_UNORM_BLOCK, GL_COMPRESSED_RG_RGTC2, 4, 4, 16, "BC5" },
+	{ VK_FORMAT_BC5_SNORM_BLOCK, GL_COMPRESSED_SIGNED_RG_RGTC2, 4, 4, 16, "BC5 snorm" },
+	{ VK_FORMAT_BC7_UNORM_BLOCK, GL_COMPRESSED_RGBA_BPTC_UNORM, 4, 4, 16, "BC7" },
+	{ VK_FORMAT_BC7_SRGB_BLOCK, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 4, 4, 16, "BC7 sRGB" },
+	{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16, "ASTC 4x4" },
+	{ VK_FORMAT_ASTC_4x4_SRGB_BLOCK, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR, 4, 4, 16, "ASTC 4x4 sRGB" },
+	{ VK_FORMAT_ASTC_6x6_UNORM_BLOCK, GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 6, 6, 16, "ASTC 6x6" },
+	{ VK_FORMAT_ASTC_6x6_SRGB_BLOCK, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR, 6, 6, 16, "ASTC 6x6 sRGB" },
+	{ VK_FORMAT_ASTC_8x8_UNORM_BLOCK, GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16, "ASTC 8x8" },
+	{ VK_FORMAT_ASTC_8x8_SRGB_BLOCK, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR, 8, 8, 16, "ASTC 8x8 sRGB" }
+};
+
+inline const TextureFormat* findTextureFormat(uint32_t vkFormat)
+{
+	for (const TextureFormat& format : TEXTURE_FORMATS)
+	{
+		if (format.vkFormat == vkFormat)
+		{
+			return &format;
+		}
+	}
+	return NULL;
+}
+
+// whether the context can sample the format (call after glext::load)
+inline bool isTextureFormatSupported(const TextureFormat& format)
+{
+	if (format.vkFormat >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK)
+	{
+		return glext::textureAstc;
+	}
+	if (format.vkFormat >= VK_FORMAT_BC7_UNORM_BLOCK)
+	{
+		return glext::textureBptc;
+	}
+	return true;
+}
+
+inline uint32_t mipSize(uint32_t size, uint32_t level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+// levels in a full chain down to 1x1
+inline uint32_t fullMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t largest = width > height ? width : height;
+	uint32_t levels = 1;
+	while (largest > 1)
+	{
+		largest >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+inline size_t textureLevelBytes(const TextureFormat& format, uint32_t width, uint32_t height)
+{
+	size_t blocksX = (width + format.blockWidth - 1) / format.blockWidth;
+	size_t blocksY = (height + format.blockHeight - 1) / format.blockHeight;
+	return blocksX * blocksY * format.blockBytes;
+}
+
+// KTX2 container (.ktx2)
+// ----------------------
+// identifier | header | index | level index | data format descriptor | ... | levels, smallest first
+// Only what GL can take directly is accepted: a single 2D image (no array layers, cube faces or
+// depth) in one of the formats above, without supercompression. Like MeshFile the file is memory
+// mapped and levels are handed out as pointers into the mapping.
+const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header
+{
+	unsigned char identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+class TextureFile
+{
+public:
+	bool open(const std::string& path)
+	{
+		if (!file.open(path))
+		{
+			std::cout << "ERROR::TEXTURE_FILE::OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+		if (file.size() < sizeof(Ktx2Header))
+		{
+			return invalid(path, "truncated header");
+		}
+		header = (const Ktx2Header*)file.data();
+		if (memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			return invalid(path, "not a KTX2 file");
+		}
+		textureFormat = findTextureFormat(header->vkFormat);
+		if (textureFormat == NULL)
+		{
+			return invalid(path, "unsupported format");
+		}
+		if (header->pixelWidth == 0 || header->pixelHeight == 0 || header->pixelDepth != 0 || header->layerCount > 1 || header->faceCount != 1)
+		{
+			return invalid(path, "not a single 2D image");
+		}
+		if (header->supercompressionScheme != 0)
+		{
+			return invalid(path, "supercompressed");
+		}
+		if (header->levelCount == 0 || header->levelCount > fullMipCount(header->pixelWidth, header->pixelHeight))
+		{
+			return invalid(path, "bad level count");
+		}
+		if (file.size() < sizeof(Ktx2Header) + header->levelCount * sizeof(Ktx2Level))
+		{
+			return invalid(path, "truncated level index");
+		}
+		for (uint32_t level = 0; level < header->levelCount; level++)
+		{
+			const Ktx2Level& entry = levels()[level];
+			if (entry.byteLength != textureLevelBytes(*textureFormat, width(level), height(level))
+				|| entry.byteOffset > file.size() || entry.byteLength > file.size() - entry.byteOffset)
+			{
+				return invalid(path, "level out of bounds");
+			}
+		}
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		header = NULL;
+		textureFormat = NULL;
+	}
+
+	bool isOpen() const { return header != NULL; }
+	const TextureFormat& format() const { return *textureFormat; }
+	uint32_t levelCount() const { return header->levelCount; }
+	uint32_t width(uint32_t level = 0) const { return mipSize(header->pixelWidth, level); }
+	uint32_t height(uint32_t level = 0) const { return mipSize(header->pixelHeight, level); }
+	const void* levelData(uint32_t level) const { return file.data() + levels()[level].byteOffset; }
+	size_t levelBytes(uint32_t level) const { return (size_t)levels()[level].byteLength; }
+
+private:
+	MappedFile file;
+	const Ktx2Header* header = NULL;
+	const TextureFormat* textureFormat = NULL;
+
+	const Ktx2Level* levels() const
+	{
+		return (const Ktx2Level*)(file.data() + sizeof(Ktx2Header));
+	}
+
+	bool invalid(const std::string& path, const char* reason)
+	{
+		std::cout << "ERROR::TEXTURE_FILE::INVALID " << path << " (" << reason << ")" << std::endl;
+		close();
+		return false;
+	}
+};
+
+// write side: levels[0] is the full size level, each one already encoded in format
+// ---------------------------------------------------------------------------------
+// The data format descriptor is the basic block for the two formats we bake (BC5 / BC7); other
+// formats get an empty descriptor, which our loader doesn't read but other tools would reject.
+inline bool writeTextureFile(const std::string& path, const TextureFormat& format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels)
+{
+	if (levels.empty() || levels.size() > fullMipCount(width, height))
+	{
+		std::cout << "ERROR::TEXTURE_FILE::BAD_LEVELS " << path << std::endl;
+		return false;
+	}
+
+	// basic descriptor block: 24 bytes plus 16 per sample
+	bool bc5 = format.vkFormat == VK_FORMAT_BC5_UNORM_BLOCK;
+	bool bc7 = format.vkFormat == VK_FORMAT_BC7_UNORM_BLOCK || format.vkFormat == VK_FORMAT_BC7_SRGB_BLOCK;
+	uint32_t samples = bc5 ? 2 : (bc7 ? 1 : 0);
+	std::vector<unsigned char> dfd(samples ? 4 + 24 + 16 * samples : 0);
+	if (samples)
+	{
+		uint32_t total = (uint32_t)dfd.size();
+		uint16_t version = 2, blockSize = (uint16_t)(24 + 16 * samples);
+		memcpy(&dfd[0], &total, 4);
+		memcpy(&dfd[8], &version, 2);
+		memcpy(&dfd[10], &blockSize, 2);
+		dfd[12] = bc5 ? 132 : 134;										// KHR_DF_MODEL_BC5 / BC7
+		dfd[13] = 1;													// BT.709 primaries
+		dfd[14] = format.vkFormat == VK_FORMAT_BC7_SRGB_BLOCK ? 2 : 1;	// sRGB / linear
+		dfd[16] = (unsigned char)(format.blockWidth - 1);
+		dfd[17] = (unsigned char)(format.blockHeight - 1);
+		dfd[20] = (unsigned char)format.blockBytes;
+		for (uint32_t sample = 0; sample < samples; sample++)
+		{
+			unsigned char* entry = &dfd[28 + 16 * sample];
+			uint16_t bitOffset = (uint16_t)(sample * 64);
+			uint32_t upper = 0xFFFFFFFFu;
+			memcpy(entry, &bitOffset, 2);
+			entry[2] = samples == 2 ? 63 : 127;
+			entry[3] = (unsigned char)sample;							// red, green (BC7: color)
+			memcpy(entry + 12, &upper, 4);
+		}
+	}
+
+	Ktx2Header header = {};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = format.vkFormat;
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)levels.size();
+	header.dfdByteOffset = dfd.empty() ? 0 : (uint32_t)(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level));
+	header.dfdByteLength = (uint32_t)dfd.size();
+
+	// level data goes smallest first, each level aligned to the block size (16 covers every format here)
+	std::vector<Ktx2Level> index(levels.size());
+	uint64_t offset = sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level) + dfd.size();
+	for (size_t i = levels.size(); i-- > 0;)
+	{
+		offset = (offset + 15) & ~(uint64_t)15;
+		index[i] = { offset, levels[i].size(), levels[i].size() };
+		offset += levels[i].size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE_FILE::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	const char zeros[16] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)index.data(), (std::streamsize)(index.size() * sizeof(Ktx2Level)));
+	file.write((const char*)dfd.data(), (std::streamsize)dfd.size());
+	for (size_t i = levels.size(); i-- > 0;)
+	{
+		file.write(zeros, (std::streamsize)(index[i].byteOffset - (uint64_t)file.tellp()));
+		file.write((const char*)levels[i].data(), (std::streamsize)levels[i].size());
+	}
+	return (bool)file;
+}
+
+#endif
@@ -1,44 +1,446 @@
 #include <glad/glad.h>
 #include <glfw3.h>
 
+#include "asset_loader.h"
+#include "batch_renderer.h"
+#include "file_watcher.h"
+#include "frame_arena.h"
+#include "frame_capture.h"
+#include "frame_pacing.h"
+#include "frame_renderer.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "instancing.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "primitives.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "render_queue.h"
+#include "render_scale.h"
+#include "render_target.h"
+#include "render_thread.h"
+#include "ring_buffer.h"
+#include "scene_store.h"
+#include "shader_manager.h"
+#include "simd_math.h"
+#include "texture_compress.h"
+#include "texture_streamer.h"
+#include "texture_table.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void window_refresh_callback(GLFWwindow* window);
+void cursor_pos_callback(GLFWwindow* window, double x, double y);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void scroll_callback(GLFWwindow* window, double x, double y);
 void processInput(GLFWwindow* window);
+void requestRedraw();
+bool bakeQuadMesh(const char* path);
+bool bakeGridMesh(const char* path);
+bool bakeDiscMesh(const char* path, uint32_t segments);
+bool bakePatternTexture(const char* path, uint32_t index);
+bool bakeMissingAssets(JobSystem& jobs);
+bool parseScene(const char* name, bool& stress);
+bool parseSize(const char* text, int& width, int& height);
+bool parseCapture(const char* text, CaptureFormat& format, std::string& path);
+
+// the global heap, counted (see frame_arena.h) so the frame path can be checked for allocations;
+// the array and nothrow forms end up here too
+// ----------------------------------------------------------------------------------------------
+void* operator new(size_t size)
+{
+	countHeapAllocation();
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
 
 // settings
 // --------
 const unsigned int SCR_WIDTH = 1024;
 const unsigned int SCR_HEIGHT = 1024;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
+// profiler (F1 toggles the overlay, F2 dumps the frame history as CSV)
+// --------------------------------------------------------------------
+Profiler profiler;
+bool showOverlay = true;
+bool dumpProfile = false;
+const char* PROFILE_CSV_PATH = "profile.csv";
+
+// presentation (F3 cycles the mode); the limiter's rate defaults to the monitor's refresh rate
+// --------------------------------------------------------------------------------------------
+PresentMode presentMode = PRESENT_VSYNC;
+double frameLimitHz = 0.0;
+
+// on-demand rendering (--on-demand, F4 toggles): while nothing on screen changes the loop sleeps in
+// glfwWaitEventsTimeout instead of redrawing; input, resizes, the OS asking for a repaint and
+// requestRedraw() (from any thread) mark the next frame dirty. Animated scenes always redraw.
+// -------------------------------------------------------------------------------------------------
+bool onDemand = false;
+std::atomic<bool> redrawRequested { true };
+const double IDLE_WAIT_SECONDS = 0.25;
+
+// shader program binaries from previous runs live here (delete the folder to force a full recompile)
+// --------------------------------------------------------------------------------------------------
+const char* PROGRAM_CACHE_DIR = "shader_cache";
+
+// assets
+// ------
+const char* QUAD_MESH_PATH = "assets/quad.crmesh";
+const char* GRID_MESH_PATH = "assets/grid.crmesh";
+const char* TRIANGLE_MESH_PATH = "assets/triangle.crmesh";
+const char* HEXAGON_MESH_PATH = "assets/hexagon.crmesh";
+const char* CIRCLE_MESH_PATH = "assets/circle.crmesh";
+const char* TEXTURE_PATHS[] =
+{
+	"assets/pattern0.ktx2", "assets/pattern1.ktx2", "assets/pattern2.ktx2", "assets/pattern3.ktx2",
+	"assets/pattern4.ktx2", "assets/pattern5.ktx2", "assets/bumps0.ktx2", "assets/bumps1.ktx2"
+};
+const uint32_t TEXTURE_BC5_FIRST = 6;		// the bumps are two channel (BC5), the patterns BC7
+const uint32_t TEXTURE_SIZE = 1024;
+
+// scene (1: quad, 2: dense grid, 3: instanced sprites, 4: multi-draw indirect batch, 5: streamed textures)
+// --------------------------------------------------------------------------------------------------------
+enum Scene
+{
+	SCENE_QUAD = 1,
+	SCENE_GRID = 2,
+	SCENE_SPRITES = 3,
+	SCENE_BATCH = 4,
+	SCENE_TEXTURES = 5
+};
+Scene scene = SCENE_QUAD;
+const char* SCENE_NAMES[] = { "quad", "grid", "sprites", "batch", "textures" };
+const unsigned int SPRITE_COUNT = 10000;
+const unsigned int MAX_SPRITES = 100000;
+const unsigned int BATCH_OBJECTS = 4096;
+// F5: batch objects culled on the GPU (frustum + last frame's depth), on the CPU (SIMD frustum test
+// in the scene update jobs, also what GPU culling falls back to without compute) or not at all
+enum CullMode
+{
+	CULL_GPU,
+	CULL_CPU,
+	CULL_OFF,
+	CULL_MODE_COUNT
+};
+CullMode cullMode = CULL_GPU;
+bool useLod = true;			// F6: batch objects draw the coarsest level of detail their screen size allows
+bool lodFade = true;		// F7: levels cross-fade with a dither instead of popping
+const float LOD_THRESHOLD_PIXELS = 1.0f;	// screen-space error a level may have
+const float LOD_FADE_BAND = 0.5f;			// fade width, in thresholds
+
+// texture streaming: the texture scene's tiles zoom in and out and change texture every few seconds,
+// so mip levels keep coming and going within the budget (--texture-budget <MB>)
+// ---------------------------------------------------------------------------------------------------
+size_t textureBudgetBytes = 8 << 20;
+const size_t TEXTURE_UPLOAD_BYTES_PER_FRAME = 2 << 20;
+const float TEXTURE_SWAP_SECONDS = 3.0f;
+
+// batch objects sample the BC7 patterns through a texture table: bindless handles when the driver has
+// them, a 2D array otherwise (--texture-binding bindless|array; bindless falls back to the array)
+// ----------------------------------------------------------------------------------------------------
+bool preferBindless = true;
+
+// buffers and VAOs are edited through the 4.5 named calls when the context has them (see gl_buffers.h);
+// --buffer-api bind keeps the 3.3 bind-to-edit path for comparison
+// ----------------------------------------------------------------------------------------------------
+bool preferDirectStateAccess = true;
+
+// per-frame dynamic data (instances, indirect commands, per-draw data) is streamed through one ring,
+// each of its three regions big enough for the largest sprite count plus the batch
+// -------------------------------------------------------------------------------------------------
+const size_t FRAME_RING_BYTES = 8 << 20;
+
+// headless benchmark (--bench): a hidden window and the scene drawn into an offscreen target of
+// --bench-size, never swapped, with at most BENCH_FRAMES_IN_FLIGHT frames queued on the GPU (what
+// the swap chain would otherwise limit). Frames only count once every shader is built and the
+// warmup is over; the frame time statistics go to stdout, the run exits on its own.
+// ----------------------------------------------------------------------------------------------
+const int BENCH_FRAMES = 1000;
+const int BENCH_WARMUP_FRAMES = 60;
+const int BENCH_FRAMES_IN_FLIGHT = 2;
+const int BENCH_WIDTH = 1920;
+const int BENCH_HEIGHT = 1080;
+
+// background asset loading (see asset_loader.h): files are read and decoded on ASSET_READER_THREADS
+// threads and uploaded through a context shared with the window's, so loading never stalls a frame.
+// The grid mesh streams in this way; --stream-test <n> queues n more copies of it, each released as
+// soon as it lands, to watch frame times while hundreds of MB go through
+// --------------------------------------------------------------------------------------------------
+const int ASSET_READER_THREADS = 2;
+const size_t ASSET_UPLOAD_BYTES_PER_SECOND = 256 << 20;
+
+// frame capture (--capture png:<dir> | yuv:<path>, F8 pauses / resumes): every finished frame is
+// read back asynchronously and encoded on a thread of its own (see frame_capture.h); frames the
+// encoder can't keep up with are dropped, never waited for
+// ----------------------------------------------------------------------------------------------
+bool capturing = false;
+
+// render resolution: the scene is drawn at a fraction of the output size and upscaled to it
+// (--render-scale fixes the fraction; --dynamic-resolution <ms>, or F9, lets a controller pick it to
+// hold the frame's GPU time at that target; --upscale or F10 switches the filter). At 1 the scene
+// draws straight into the output as before.
+// --------------------------------------------------------------------------------------------------
+float renderScale = 1.0f;
+bool dynamicResolution = false;
+float dynamicResolutionTargetMs = 12.0f;
+UpscaleFilter upscaleFilter = UPSCALE_SHARPEN;
+const float MIN_RENDER_SCALE = 0.25f;
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float UPSCALE_SHARPNESS = 0.75f;
+
+// draws are pushed with a sort key and issued in key order (render passes, lowest first)
+// ---------------------------------------------------------------------------------------
+const uint32_t RENDER_QUEUE_CAPACITY = 4096;
+enum RenderPass
+{
+	PASS_OPAQUE = 0
+};
+
+// frames are recorded on the main thread into a command buffer per frame slot and replayed by the
+// render thread one frame later (--single-thread records and replays on the main thread); the scene
+// updates feeding the recording run as jobs, and the job system gets every hardware thread but the
+// render thread's
+// -------------------------------------------------------------------------------------------------
+const int MAX_JOB_THREADS = 8;
+const size_t COMMAND_BUFFER_BYTES = 1 << 20;
 
-// vertex shader source code
-// -------------------------
-const char* vertexShaderSource =
+// transient CPU data of the GL side's frame comes from an arena reset every frame, not from the
+// heap. The title shows its high-water mark next to the heap allocations the frame path still made
+// per frame, which should read 0 in steady state.
+// ------------------------------------------------------------------------------------------------
+const size_t FRAME_ARENA_BYTES = 256 << 10;
+
+// shader programs live in these files (with #include, see shader_source.h) and reload while the
+// program runs whenever one of their files changes; the fallback below stays built in
+// ------------------------------------------------------------------------------------------------
+const char* QUAD_SHADER_PATHS[] = { "shaders/quad.vert", "shaders/quad.frag" };
+const char* SPRITE_SHADER_PATHS[] = { "shaders/sprite.vert", "shaders/sprite.frag" };
+const char* SINGLE_SPRITE_SHADER_PATHS[] = { "shaders/sprite_single.vert", "shaders/sprite.frag" };
+const char* BATCH_SHADER_PATHS[] = { "shaders/batch.vert", "shaders/batch.frag" };
+const char* TEXTURED_SHADER_PATHS[] = { "shaders/textured.vert", "shaders/textured.frag" };
+const char* UPSCALE_SHADER_PATHS[] = { "shaders/upscale.vert", "shaders/upscale.frag" };
+const std::chrono::milliseconds SHADER_WATCH_INTERVAL(250);
+
+// shader variants: feature bits of the batch and textured families (bit i is the i-th name given to
+// submitVariants); the variants a run used are prewarmed on the next one
+// --------------------------------------------------------------------------------------------------
+const uint32_t BATCH_BINDLESS = 1 << 0;
+const uint32_t BATCH_TEXTURE_ARRAY = 1 << 1;
+const uint32_t BATCH_LOD_FADE = 1 << 2;
+const uint32_t TEXTURED_NORMAL_MAP = 1 << 0;
+const uint32_t UPSCALE_SHARPEN_BIT = 1 << 0;
+const char* SHADER_VARIANTS_PATH = "shader_cache/variants.txt";
+
+// fallback shader: presented while the real programs are still compiling
+// ----------------------------------------------------------------------
+const char* fallbackVertexShaderSource =
 	"#version 330 core\n"
-	"layout (location = 0) in vec3 aPos;\n" 
+	"layout (location = 0) in vec3 aPos;\n"
 	"void main()\n"
 	"{\n"
-	"	gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+	"	gl_Position = vec4(aPos, 1.0);\n"
 	"}\0";
 
-// fragment shader source code
-// ---------------------------
-const char* fragmentShaderSource =
+const char* fallbackFragmentShaderSource =
 	"#version 330 core\n"
 	"out vec4 FragColor;\n"
 	"void main()\n"
 	"{\n"
-	"	FragColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);\n"
+	"	FragColor = vec4(0.3f, 0.3f, 0.3f, 1.0f);\n"
 	"}\0";
 
-int main()
+int main(int argc, char** argv)
 {
+	// command line
+	// ------------
+	bool benchInstancing = false;
+	bool singleThread = false;
+	bool benchJobs = false;
+	bool benchScene = false;
+	bool benchMath = false;
+	bool bench = false;
+	int benchFrames = BENCH_FRAMES;
+	int benchWidth = BENCH_WIDTH, benchHeight = BENCH_HEIGHT;
+	bool stressScene = false;
+	bool captureEnabled = false;
+	int streamTestCount = 0;
+	CaptureFormat captureFormat = CAPTURE_PNG;
+	std::string capturePath;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench-instancing") == 0)
+		{
+			benchInstancing = true;
+		}
+		else if (strcmp(argv[i], "--single-thread") == 0)
+		{
+			singleThread = true;
+		}
+		else if (strcmp(argv[i], "--bench-jobs") == 0)
+		{
+			benchJobs = true;
+		}
+		else if (strcmp(argv[i], "--bench-scene") == 0)
+		{
+			benchScene = true;
+		}
+		else if (strcmp(argv[i], "--bench-math") == 0)
+		{
+			benchMath = true;
+		}
+		else if (strcmp(argv[i], "--bench") == 0)
+		{
+			bench = true;
+		}
+		else if (strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+		{
+			benchFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-size") == 0 && i + 1 < argc && parseSize(argv[i + 1], benchWidth, benchHeight))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--stream-test") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+		{
+			streamTestCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc && parseScene(argv[i + 1], stressScene))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc && parseCapture(argv[i + 1], captureFormat, capturePath))
+		{
+			captureEnabled = true;
+			i++;
+		}
+		else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc
+			&& atof(argv[i + 1]) >= MIN_RENDER_SCALE && atof(argv[i + 1]) <= 1.0)
+		{
+			renderScale = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+		{
+			dynamicResolution = true;
+			dynamicResolutionTargetMs = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--upscale") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "bilinear") == 0 || strcmp(argv[i + 1], "sharpen") == 0))
+		{
+			upscaleFilter = strcmp(argv[++i], "sharpen") == 0 ? UPSCALE_SHARPEN : UPSCALE_BILINEAR;
+		}
+		else if (strcmp(argv[i], "--on-demand") == 0)
+		{
+			onDemand = true;
+		}
+		else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc && parsePresentMode(argv[i + 1], presentMode))
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+		{
+			frameLimitHz = atof(argv[++i]);
+			presentMode = PRESENT_LIMITED;
+		}
+		else if (strcmp(argv[i], "--texture-binding") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "bindless") == 0 || strcmp(argv[i + 1], "array") == 0))
+		{
+			preferBindless = strcmp(argv[++i], "bindless") == 0;
+		}
+		else if (strcmp(argv[i], "--buffer-api") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "dsa") == 0 || strcmp(argv[i + 1], "bind") == 0))
+		{
+			preferDirectStateAccess = strcmp(argv[++i], "dsa") == 0;
+		}
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+		{
+			textureBudgetBytes = (size_t)(atof(argv[++i]) * (1 << 20));
+		}
+		else
+		{
+			std::cout << "unknown option " << argv[i] << "\n"
+				<< "usage: cr1ms0nh3ad_opengl [--bench-instancing] [--bench-jobs] [--bench-scene] [--bench-math]\n"
+				<< "                          [--single-thread] [--on-demand] [--present uncapped|vsync|adaptive|limited] [--fps <hz>]\n"
+				<< "                          [--texture-budget <MB>] [--texture-binding bindless|array] [--buffer-api dsa|bind]\n"
+				<< "                          [--scene quad|grid|sprites|batch|textures|stress]\n"
+				<< "                          [--render-scale <0.25-1>] [--dynamic-resolution <gpu ms>] [--upscale bilinear|sharpen]\n"
+				<< "                          [--bench] [--bench-frames <n>] [--bench-size <width>x<height>] [--stream-test <n>]\n"
+				<< "                          [--capture png:<directory>|yuv:<file or pipe>]" << std::endl;
+			return -1;
+		}
+	}
+
+	if (benchMath)
+	{
+		runMathBenchmark();
+		return 0;
+	}
+
+	// job system: the calling thread is worker 0, the rest wait for jobs
+	// ------------------------------------------------------------------
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	int jobThreads = hardwareThreads > 2 ? (int)hardwareThreads - 1 : 1;
+	jobThreads = jobThreads < MAX_JOB_THREADS ? jobThreads : MAX_JOB_THREADS;
+	JobSystem jobs;
+	jobs.start(jobThreads);
+	if (benchJobs)
+	{
+		runJobBenchmark(jobs);
+		jobs.stop();
+		return 0;
+	}
+	if (benchScene)
+	{
+		runSceneBenchmark(jobs);
+		jobs.stop();
+		return 0;
+	}
+
 	// GLFW: initialise and configure
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (bench)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		presentMode = PRESENT_UNCAPPED;
+		onDemand = false;
+		showOverlay = false;
+	}
 
 	// GLFW: window creation
 	// ---------------------
@@ -50,7 +452,22 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	if (bench)
+	{
+		// the offscreen target's size is the frame size; the hidden window's doesn't matter
+		framebufferWidth = benchWidth;
+		framebufferHeight = benchHeight;
+	}
+	else
+	{
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	}
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetWindowRefreshCallback(window, window_refresh_callback);
+	glfwSetCursorPosCallback(window, cursor_pos_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetScrollCallback(window, scroll_callback);
 
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
@@ -60,132 +477,679 @@ int main()
 		return -1;
 	}
 
-	// vertex shader: compilation
-	// --------------------------
-	unsigned int vertexShader;
-	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
+	// entry points newer than the 3.3 core glad loads (used only when the context has them)
+	// ---------------------------------------------------------------------------------------
+	glext::load();
+	glext::directStateAccess = glext::directStateAccess && preferDirectStateAccess;
 
-	// vertex shader: compilation status logging
-	// -----------------------------------------
-	int success;
-	char infoLog[512];
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+	// bench mode: everything is drawn into an offscreen target instead of the hidden window
+	// --------------------------------------------------------------------------------------
+	RenderTarget benchTarget;
+	if (bench && !benchTarget.init(benchWidth, benchHeight))
+	{
+		glfwTerminate();
+		return -1;
+	}
+
+	// frame pacing: the swap interval is always set explicitly instead of left to the driver default
+	// -----------------------------------------------------------------------------------------------
+	FramePacer pacer;
+	pacer.init(glfwGetPrimaryMonitor());
+	if (presentMode == PRESENT_ADAPTIVE && !pacer.isAdaptiveSupported())
+	{
+		std::cout << "EXT_swap_control_tear not supported, adaptive vsync falls back to vsync" << std::endl;
+	}
+
+	// shader programs: every program is submitted up front and compiles in the background
+	// (restored from the binary cache on warm starts); the render loop draws with the
+	// fallback program until the real one has linked
+	// ------------------------------------------------------------------------------------
+	ProgramCache programCache;
+	programCache.init(PROGRAM_CACHE_DIR);
+	ShaderManager shaderManager;
+	shaderManager.init(programCache, fallbackVertexShaderSource, fallbackFragmentShaderSource);
+	FileWatcher shaderWatcher;
+	shaderWatcher.start(SHADER_WATCH_INTERVAL, requestRedraw);
+	shaderManager.enableHotReload(shaderWatcher);
+	const int quadProgram = shaderManager.submitFiles("quad", QUAD_SHADER_PATHS[0], QUAD_SHADER_PATHS[1]);
+	const int spriteProgram = shaderManager.submitFiles("sprite", SPRITE_SHADER_PATHS[0], SPRITE_SHADER_PATHS[1]);
+	const int singleSpriteProgram = shaderManager.submitFiles("sprite_single", SINGLE_SPRITE_SHADER_PATHS[0], SINGLE_SPRITE_SHADER_PATHS[1]);
+	const int texturedFamily = shaderManager.submitVariants("textured", TEXTURED_SHADER_PATHS[0], TEXTURED_SHADER_PATHS[1], { "NORMAL_MAP" });
+	const int upscaleFamily = shaderManager.submitVariants("upscale", UPSCALE_SHADER_PATHS[0], UPSCALE_SHADER_PATHS[1], { "SHARPEN" });
+
+	// the rest of the setup, declared up front so every exit before the render loop tears down through
+	// destroySetup whatever got that far (destroy() on anything not initialized yet does nothing; the
+	// end of main does the same for the rest)
+	// --------------------------------------------------------------------------------------------------
+	StagingBuffer staging;
+	FrameRingBuffer frameRing;
+	Mesh quad;
+	AssetLoader assets;
+	BatchRenderer batch;
+	TextureStreamer textureStreamer;
+	TextureTable batchTextures;
+	auto destroySetup = [&]()
+	{
+		batchTextures.destroy();
+		textureStreamer.destroy();
+		batch.destroy();
+		shaderWatcher.stop();
+		shaderManager.destroy();
+		destroyMesh(quad);
+		assets.stop();
+		frameRing.destroy();
+		staging.destroy();
+		benchTarget.destroy();
+		gpuResources.destroy();
+		glfwTerminate();
+		jobs.stop();
+	};
+
+	// load geometry: the mesh file is memory mapped and streamed straight into GPU buffers
+	// (the built-in quad gets baked to disk the first time so there is always something to load)
+	// ------------------------------------------------------------------------------------------
+	staging.init();
+	if (!frameRing.init(FRAME_RING_BYTES))
+	{
+		destroySetup();
+		return -1;
+	}
 
-	if (!success)
+	if (!bakeMissingAssets(jobs))
 	{
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		destroySetup();
+		return -1;
 	}
 
-	// fragment shader: compilation
-	// ----------------------------
-	unsigned int fragmentShader;
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
+	if (!loadMesh(QUAD_MESH_PATH, staging, quad))
+	{
+		destroySetup();
+		return -1;
+	}
 
-	// shader program (linking v and f shaders together)
-	// -------------------------------------------------
-	unsigned int shaderProgram;
-	shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
+	// the rest streams in behind the frames (the quad stands in for the grid until it has landed)
+	// -------------------------------------------------------------------------------------------
+	if (!assets.start(window, ASSET_READER_THREADS, ASSET_UPLOAD_BYTES_PER_SECOND))
+	{
+		destroySetup();
+		return -1;
+	}
+	const uint32_t gridAsset = assets.loadMesh(GRID_MESH_PATH);
+	for (int i = 0; i < streamTestCount; i++)
+	{
+		assets.release(assets.loadMesh(GRID_MESH_PATH));
+	}
 
-	// shader program: linking status logging
-	// --------------------------------------
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	// instanced sprites on top of the quad mesh
+	// -----------------------------------------
+	InstanceBatch sprites;
+	sprites.attach(quad, MAX_SPRITES, frameRing);
 
-	if (!success)
+	// multi-draw indirect batch: every shape packed into one shared VBO/EBO
+	// ----------------------------------------------------------------------
+	std::vector<uint32_t> batchMeshes;
+	int batchFamily = -1;
+	uint32_t batchFeatures = 0;
+	if (batch.init(1 << 20, 1 << 21, BATCH_OBJECTS, staging))
 	{
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING::FAILED\n" << infoLog << std::endl;
+		const char* batchMeshPaths[] = { QUAD_MESH_PATH, TRIANGLE_MESH_PATH, HEXAGON_MESH_PATH, CIRCLE_MESH_PATH };
+		for (const char* path : batchMeshPaths)
+		{
+			MeshFile file;
+			uint32_t handle = file.open(path) ? batch.addMesh(file) : BatchRenderer::INVALID_MESH;
+			if (handle != BatchRenderer::INVALID_MESH)
+			{
+				batchMeshes.push_back(handle);
+			}
+		}
 	}
 
-	// since we've linked shader objects into the program object
-	// we no longer need them anymore
-	// ---------------------------------------------------------
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// streamed textures: only the small mips are resident until something draws them bigger
+	// (textures in formats this GL can't sample are skipped)
+	// -------------------------------------------------------------------------------------
+	textureStreamer.init(staging, textureBudgetBytes, TEXTURE_UPLOAD_BYTES_PER_FRAME);
+	bool bindless = preferBindless && batch.isSupported() && textureStreamer.enableBindless();
+	std::vector<uint32_t> textures, patternTextures;
+	std::vector<bool> normalMaps;
+	for (uint32_t i = 0; i < sizeof(TEXTURE_PATHS) / sizeof(TEXTURE_PATHS[0]); i++)
+	{
+		uint32_t handle = textureStreamer.add(TEXTURE_PATHS[i]);
+		if (handle != TextureStreamer::INVALID_TEXTURE)
+		{
+			textures.push_back(handle);
+			normalMaps.push_back(i >= TEXTURE_BC5_FIRST);
+			if (i < TEXTURE_BC5_FIRST)
+			{
+				patternTextures.push_back(handle);
+			}
+		}
+	}
 
-	// set up vertex data (and buffers) and configure vertex attributes
-	// ----------------------------------------------------------------
-	float vertices[] =
+	// the batch's textures, and the batch variants for the way it reaches them
+	// -------------------------------------------------------------------------
+	if (batch.isSupported())
 	{
-		0.5f, 0.5f, 0.0f,	// top right
-		0.5f, -0.5f, 0.0f,	// bottom right
-		-0.5f, -0.5f, 0.0f, // bottom left
-		-0.5f, 0.5f, 0.0f,	// top left
-	};
+		batchTextures.init(textureStreamer, patternTextures, bindless);
+		std::cout << "batch textures: " << textureTableModeName(batchTextures.mode()) << std::endl;
+		batchFeatures = batchTextures.mode() == TEXTURE_TABLE_BINDLESS ? BATCH_BINDLESS
+			: (batchTextures.mode() == TEXTURE_TABLE_ARRAY ? BATCH_TEXTURE_ARRAY : 0);
+		batchFamily = shaderManager.submitVariants("batch", BATCH_SHADER_PATHS[0], BATCH_SHADER_PATHS[1], { "BINDLESS", "TEXTURE_ARRAY", "LOD_FADE" });
+	}
+	shaderManager.prewarm(SHADER_VARIANTS_PATH);
 
-	unsigned int indices[] =
+	// scenes: the sprite grid and the batch field as component arrays, animated by update() each frame
+	// --------------------------------------------------------------------------------------------------
+	SceneStore spriteScene;
+	// (the stress scene is the sprite grid at the most sprites the batch takes)
+	unsigned int spriteCount = stressScene ? MAX_SPRITES : SPRITE_COUNT;
+	spriteScene.init(spriteCount);
 	{
-		0, 1, 3,	// first triangle
-		1, 2, 3		// second trinagle
-	};
+		unsigned int side = (unsigned int)std::ceil(std::sqrt((float)spriteCount));
+		float cell = 2.0f / side;
+		for (unsigned int i = 0; i < spriteCount; i++)
+		{
+			unsigned int column = i % side, row = i / side;
+			spriteScene.spawn({ 0, 0, -1.0f + cell * (column + 0.5f), -1.0f + cell * (row + 0.5f), cell * 1.2f, 0.0f, 0.5f + (i % 7) * 0.25f,
+				{ (float)column / side, (float)row / side, 1.0f - (float)column / side, 1.0f }, 0.75f });
+		}
+	}
+	SceneStore batchScene;
+	if (batch.isSupported() && !batchMeshes.empty())
+	{
+		// the grid is wider than the screen and drifts sideways, so part of it is always off screen;
+		// objects shrink towards the top rows like a field seen in perspective, so levels of detail vary
+		batchScene.init(BATCH_OBJECTS);
+		unsigned int side = 64;
+		float extent = 1.5f;
+		uint32_t textureCount = batchTextures.size();
+		for (unsigned int i = 0; i < BATCH_OBJECTS; i++)
+		{
+			unsigned int column = i % side, row = i / side;
+			uint32_t mesh = batchMeshes[i % batchMeshes.size()];
+			batchScene.spawn({ mesh, textureCount > 0 ? (i / 7) % textureCount : TextureTable::NO_TEXTURE,
+				(-1.0f + (column + 0.5f) * 2.0f / side) * extent, -1.0f + (row + 0.5f) * 2.0f / side,
+				1.6f * extent / side * (1.0f - 0.7f * row / side), 0.0f, 0.3f + (i % 5) * 0.2f,
+				{ (float)column / side, (float)row / side, 1.0f - (float)column / side, 1.0f }, batch.mesh(mesh).radius });
+		}
+	}
 
-	// copy our vertices array in a buffer for OpenGL to use
-	// -----------------------------------------------------
-	unsigned int VBO, VAO, EBO;
-
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// set the vertex attributes pointers
-	// ----------------------------------
-	glVertexAttribPointer
-	(
-		0,						// which vertex attribute we want to configure (location = 0)
-		3,						// size of the vertex attribute (vec3)
-		GL_FLOAT,				// a vecX in GLSL consists of floating point values
-		GL_FALSE,				// do we want the data to be normalized?
-		3 * sizeof(float),		// stride (the space between consecutive vertex attributes)
-		(void*)0				// offseit of where the position data begins in the buffer (weird ass cast)
-	);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// benchmark mode: sweep the instance count, print the results and exit
+	// --------------------------------------------------------------------
+	if (benchInstancing)
+	{
+		while (!shaderManager.isIdle())
+		{
+			shaderManager.poll();
+		}
+		unsigned int single = shaderManager.program(singleSpriteProgram);
+		runInstancingBenchmark(window, quad, sprites, frameRing, shaderManager.program(spriteProgram), single,
+			glGetUniformLocation(single, "uTransform"), glGetUniformLocation(single, "uColor"));
+		destroySetup();
+		return 0;
+	}
+
+	// frame capture: the encoder thread starts now, the readback buffers with the first frame
+	// ----------------------------------------------------------------------------------------
+	FrameCapture capture;
+	if (captureEnabled)
+	{
+		if (!capture.start(captureFormat, capturePath))
+		{
+			destroySetup();
+			return -1;
+		}
+		capturing = true;
+	}
+
+	RenderQueue renderQueue;
+	renderQueue.init(RENDER_QUEUE_CAPACITY);
 
 	// draw in wireframe mode
 	// ----------------------
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	glState.polygonMode(GL_LINE);
 
-	// MAIN RENDER LOOP
-	// ----------------
-	while (!glfwWindowShouldClose(window))
+	// profiler: GPU passes and CPU scopes we want timed every frame (input, record and events are
+	// measured on the main thread and handed over with the frame, the rest run where the GL context is)
+	// --------------------------------------------------------------------------------------------------
+	profiler.init();
+	const int gpuClear = profiler.gpuPass("clear");
+	const int gpuTextures = profiler.gpuPass("textures");
+	const int gpuCull = profiler.gpuPass("cull");
+	const int gpuDraw = profiler.gpuPass("draw");
+	const int gpuHiZ = profiler.gpuPass("hi-z");
+	const int gpuUpscale = profiler.gpuPass("upscale");
+	const int gpuOverlay = profiler.gpuPass("overlay");
+	const int cpuInput = profiler.cpuScope("input");
+	const int cpuRecord = profiler.cpuScope("record");
+	const int cpuRender = profiler.cpuScope("render");
+	const int cpuSwap = profiler.cpuScope("swap");
+	const int cpuEvents = profiler.cpuScope("events");
+	const int cpuPace = profiler.cpuScope("pace");
+
+	// command recording: one command buffer per frame slot, filled on the main thread
+	// --------------------------------------------------------------------------------
+	FrameCommands frames[RenderThread::SLOTS];
+	for (FrameCommands& frame : frames)
 	{
-		// input
-		// -----
-		processInput(window);
+		frame.init(COMMAND_BUFFER_BYTES);
+	}
+
+	// batch positions are clip space already (the culler's view-projection is the identity), so the
+	// CPU test runs against the clip volume itself
+	const Frustum clipFrustum = frustumFromMatrix(mat4Identity());
+
+	auto recordFrame = [&](FrameCommands& frame, int slot, float time)
+	{
+		frame.reset();
+		CommandBuffer& commands = frame.commands;
+		if (scene == SCENE_SPRITES)
+		{
+			// the render thread gathers the instances from this slot's transforms while it streams
+			spriteScene.update(jobs, slot, time, mat4Identity());
+			ScenePacket* sprites = commands.push<ScenePacket>(CMD_SPRITES_VIEW);
+			if (sprites != NULL)
+			{
+				sprites->view = spriteScene.view(slot);
+			}
+			DrawPacket* draw = commands.push<DrawPacket>(CMD_SPRITES_DRAW);
+			if (draw != NULL)
+			{
+				*draw = { spriteProgram, PASS_OPAQUE, 0.5f };
+			}
+		}
+		else if (scene == SCENE_BATCH && batch.isSupported() && batchScene.size() > 0)
+		{
+			// one multi-draw for every object, whatever mix of meshes they use
+			bool gpuCull = cullMode == CULL_GPU && batch.isCullingSupported();
+			bool cpuCull = cullMode == CULL_CPU || (cullMode == CULL_GPU && !gpuCull);
+			BatchBeginPacket* begin = commands.push<BatchBeginPacket>(CMD_BATCH_BEGIN);
+			if (begin != NULL)
+			{
+				begin->cull = gpuCull ? 1 : 0;
+				begin->lodThreshold = useLod ? LOD_THRESHOLD_PIXELS : 0.0f;
+				begin->lodFadeBand = lodFade ? LOD_FADE_BAND : 0.0f;
+			}
+			batchScene.update(jobs, slot, time, mat4Translation(0.6f * sinf(time * 0.25f), 0.0f, 0.0f), cpuCull ? &clipFrustum : NULL);
+			ScenePacket* objects = commands.push<ScenePacket>(CMD_BATCH_VIEW);
+			if (objects != NULL)
+			{
+				objects->view = batchScene.view(slot);
+			}
+			DrawPacket* draw = commands.push<DrawPacket>(CMD_BATCH_DRAW);
+			if (draw != NULL)
+			{
+				*draw = { shaderManager.variant(batchFamily, batchFeatures | (lodFade ? BATCH_LOD_FADE : 0)), PASS_OPAQUE, 0.5f };
+			}
+		}
+		else if (scene == SCENE_TEXTURES && !textures.empty())
+		{
+			// a 2x2 wall of tiles, each zooming at its own pace and moving on to the next texture now and then
+			int pixels = framebufferWidth > framebufferHeight ? framebufferWidth : framebufferHeight;
+			uint32_t swaps = (uint32_t)(time / TEXTURE_SWAP_SECONDS);
+			for (uint32_t tile = 0; tile < 4; tile++)
+			{
+				DrawTexturedPacket* draw = commands.push<DrawTexturedPacket>(CMD_DRAW_TEXTURED);
+				if (draw == NULL)
+				{
+					break;
+				}
+				float scale = 0.15f + 0.8f * (0.5f + 0.5f * sinf(time * (0.4f + 0.15f * tile) + tile * 1.7f));
+				uint32_t texture = (tile + swaps) % textures.size();
+				draw->draw = { shaderManager.variant(texturedFamily, normalMaps[texture] ? TEXTURED_NORMAL_MAP : 0), PASS_OPAQUE, 0.5f };
+				draw->mesh = &quad;
+				draw->texture = textures[texture];
+				draw->transform[0] = tile % 2 == 0 ? -0.5f : 0.5f;
+				draw->transform[1] = tile / 2 == 0 ? 0.5f : -0.5f;
+				draw->transform[2] = scale;
+				draw->transform[3] = 0.0f;
+				// quad units are NDC at scale 1, and NDC spans the framebuffer twice over
+				draw->screenPixels = scale * 0.5f * pixels;
+			}
+		}
+		else
+		{
+			DrawMeshPacket* draw = commands.push<DrawMeshPacket>(CMD_DRAW_MESH);
+			if (draw != NULL)
+			{
+				draw->draw = { quadProgram, PASS_OPAQUE, 0.5f };
+				const Mesh* grid = scene == SCENE_GRID ? assets.mesh(gridAsset) : NULL;
+				draw->mesh = grid != NULL ? grid : &quad;
+			}
+		}
+	};
+
+	// replay: everything that touches GL, one frame behind the recording
+	// -------------------------------------------------------------------
+	// (the frame arena belongs to whichever thread runs renderFrame and is reset at its top)
+	LinearArena frameArena;
+	frameArena.init(FRAME_ARENA_BYTES);
+	FrameRenderer frameRenderer;
+	frameRenderer.init(shaderManager, frameRing, renderQueue, sprites, batch, textureStreamer, batchTextures, frameArena);
+	std::mutex titleMutex;
+	std::string pendingTitle;
+	int viewportWidth = 0, viewportHeight = 0;		// the output's, set by the first frame
+	int currentViewportWidth = 0, currentViewportHeight = 0;
+	auto setViewport = [&](int width, int height)
+	{
+		if (width != currentViewportWidth || height != currentViewportHeight)
+		{
+			currentViewportWidth = width;
+			currentViewportHeight = height;
+			glViewport(0, 0, width, height);
+		}
+	};
+	ResolutionController resolution;
+	resolution.init(dynamicResolutionTargetMs, DYNAMIC_RESOLUTION_MIN_SCALE);
+	Upscaler upscaler;
+	uint64_t titleAllocations = heapAllocations();
+	uint32_t titleFrames = 0;
+	std::vector<float> benchFrameMs, benchGpuMs;
+	benchFrameMs.reserve(bench ? benchFrames : 0);
+	benchGpuMs.reserve(bench ? benchFrames : 0);
+	std::atomic<int> benchMeasured { 0 };
+	GLsync benchFences[BENCH_FRAMES_IN_FLIGHT] = {};
+	int benchFrame = 0;
+	FramePacer::Clock::time_point benchLast;
+
+	auto renderFrame = [&](int slot)
+	{
+		HeapAllocationScope counted;
+		frameArena.reset();
+		titleFrames++;
+		const FrameCommands& frame = frames[slot];
+		profiler.beginFrame();
+		glState.beginFrame();
+		gpuResources.collect();
+		capture.collect();
+		int assetsArrived = assets.poll();
+		profiler.addCpu(cpuInput, frame.inputMs);
+		profiler.addCpu(cpuRecord, frame.recordMs);
+		profiler.addCpu(cpuEvents, frame.eventsMs);
+		profiler.addCpu(cpuPace, frame.paceMs);
+		pacer.applySwapInterval(frame.presentMode);
+
+		profiler.beginCpu(cpuRender);
+		viewportWidth = frame.framebufferWidth;
+		viewportHeight = frame.framebufferHeight;
+
+		// resolution: below scale 1 the scene goes into the upscaler's target, the rest into the output
+		// (natively until the upscale program is built)
+		// ----------------------------------------------------------------------------------------------
+		float scale = frame.dynamicResolution ? resolution.update(profiler.lastGpuFrameMs()) : frame.renderScale;
+		int upscaleVariant = shaderManager.variant(upscaleFamily, frame.upscaleFilter == UPSCALE_SHARPEN ? UPSCALE_SHARPEN_BIT : 0);
+		unsigned int upscaleProgram = scale < 1.0f ? shaderManager.program(upscaleVariant) : 0;
+		bool scaled = scale < 1.0f && shaderManager.isReady(upscaleVariant) && upscaler.prepare(viewportWidth, viewportHeight);
+		int renderWidth = scaled ? (int)(viewportWidth * scale + 0.5f) : viewportWidth;
+		int renderHeight = scaled ? (int)(viewportHeight * scale + 0.5f) : viewportHeight;
+		renderWidth = renderWidth > 0 ? renderWidth : 1;
+		renderHeight = renderHeight > 0 ? renderHeight : 1;
+		unsigned int sceneFramebuffer = scaled ? upscaler.sceneTarget().framebuffer() : benchTarget.framebuffer();
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+		setViewport(renderWidth, renderHeight);
+
+		// shaders: pick up programs that finished compiling since last frame
+		// ------------------------------------------------------------------
+		shaderManager.poll();
+
+		// stream: copy the frame's dynamic data into the ring, then commit it
+		// -------------------------------------------------------------------
+		frameRing.beginFrame();
+		frameRenderer.stream(frame);
+		frameRing.commit();
+
+		// textures: settle mip residency for what this frame asked for, within the budget
+		// --------------------------------------------------------------------------------
+		profiler.beginGpu(gpuTextures);
+		textureStreamer.update(frameArena);
+		batchTextures.update();
+		profiler.endGpu();
 
 		// render
 		// ------
+		profiler.beginGpu(gpuClear);
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		// draw
-		// ----
-		glUseProgram(shaderProgram);
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		
-		// GLFW: swap buffer and poll IO events (keys pressed/released, mouse moved etc.)
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler.endGpu();
+
+		// cull: batch visibility decided on the GPU, before any draw reads the commands
 		// ------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
+		profiler.beginGpu(gpuCull);
+		frameRenderer.cull();
+		profiler.endGpu();
+
+		// draw: the recorded draws go through the render queue, sorted
+		// ------------------------------------------------------------
+		profiler.beginGpu(gpuDraw);
+		frameRenderer.draw(frame);
+		profiler.endGpu();
+		profiler.beginGpu(gpuHiZ);
+		frameRenderer.buildDepthPyramid(renderWidth, renderHeight, sceneFramebuffer);
+		profiler.endGpu();
+		if (scaled)
+		{
+			profiler.beginGpu(gpuUpscale);
+			setViewport(viewportWidth, viewportHeight);
+			upscaler.draw(upscaleProgram, benchTarget.framebuffer(), renderWidth, renderHeight, UPSCALE_SHARPNESS);
+			profiler.endGpu();
+		}
+		frameRing.endFrame();
+		gpuResources.endFrame();
+
+		// profiler overlay (frame time timeline + histogram) and title summary
+		// --------------------------------------------------------------------
+		if (frame.showOverlay)
+		{
+			profiler.beginGpu(gpuOverlay);
+			profiler.drawOverlay();
+			profiler.endGpu();
+		}
+		if (frame.captureFrame)
+		{
+			capture.capture(benchTarget.framebuffer(), viewportWidth, viewportHeight);
+		}
+		char title[1024];
+		if (profiler.summary(title, sizeof(title), 0.5))
+		{
+			size_t length = strlen(title);
+			const RenderQueue::Stats& queueStats = renderQueue.stats();
+			const TextureStreamer::Stats& textureStats = textureStreamer.stats();
+			const GpuResourceRegistry::Stats& gpuStats = gpuResources.stats();
+			AssetLoader::Stats assetStats = assets.stats();
+			uint64_t allocations = heapAllocations();
+			double allocationsPerFrame = (double)(allocations - titleAllocations) / (titleFrames > 0 ? titleFrames : 1);
+			titleAllocations = allocations;
+			titleFrames = 0;
+			snprintf(title + length, sizeof(title) - length, " | render %dx%d %s | gl calls %u issued %u elided | queue %u draws %u programs %u vaos | %s latency %.1f ms | textures %.1f/%.1f MB batch %s | assets %u/%u %.1f MB"
+				" | heap %.1f/frame arena %zu/%zu KB | vram %.1f MB (mesh %.1f tex %.1f stream %.1f cull %.1f, %u retired)",
+				renderWidth, renderHeight, scaled ? upscaleFilterName(frame.upscaleFilter) : "native",
+				glState.lastIssued, glState.lastElided, queueStats.draws, queueStats.programSwitches, queueStats.vertexArraySwitches,
+				presentModeName(pacer.currentMode()), pacer.latencyMs(),
+				textureStats.residentBytes / 1048576.0, textureStats.budgetBytes / 1048576.0, textureTableModeName(batchTextures.mode()),
+				assetStats.ready + assetStats.failed, assetStats.requested, assetStats.uploadedBytes / 1048576.0,
+				allocationsPerFrame, frameArena.highWater() / 1024, frameArena.capacity() / 1024,
+				gpuResources.liveBytes() / 1048576.0, gpuStats.liveBytes[GPU_CATEGORY_MESH] / 1048576.0, gpuStats.liveBytes[GPU_CATEGORY_TEXTURE] / 1048576.0,
+				gpuStats.liveBytes[GPU_CATEGORY_STREAMING] / 1048576.0, gpuStats.liveBytes[GPU_CATEGORY_CULLING] / 1048576.0, gpuStats.retiredObjects);
+			std::lock_guard<std::mutex> lock(titleMutex);
+			pendingTitle = title;
+		}
+		if (frame.dumpProfile)
+		{
+			profiler.writeCsv(PROFILE_CSV_PATH);
+		}
+		profiler.endCpu(cpuRender);
+
+		// GLFW: swap buffer (bench: no swap, wait for the frame BENCH_FRAMES_IN_FLIGHT back instead)
+		// ------------------------------------------------------------------------------------------
+		profiler.beginCpu(cpuSwap);
+		if (bench)
+		{
+			GLsync& oldest = benchFences[benchFrame % BENCH_FRAMES_IN_FLIGHT];
+			if (oldest != NULL)
+			{
+				GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+				while (glClientWaitSync(oldest, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+				{
+					flags = 0;
+				}
+				glDeleteSync(oldest);
+			}
+			oldest = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			FramePacer::Clock::time_point now = FramePacer::Clock::now();
+			bool measured = ++benchFrame > BENCH_WARMUP_FRAMES && shaderManager.isIdle() && (int)benchFrameMs.size() < benchFrames;
+			if (measured)
+			{
+				benchFrameMs.push_back(std::chrono::duration<float, std::milli>(now - benchLast).count());
+				float gpuMs = profiler.lastGpuFrameMs();
+				if (gpuMs >= 0.0f)
+				{
+					benchGpuMs.push_back(gpuMs);
+				}
+				benchMeasured.store((int)benchFrameMs.size());
+			}
+			benchLast = now;
+		}
+		else
+		{
+			glfwSwapBuffers(window);
+			pacer.addLatency(frame.inputSampled, FramePacer::Clock::now());
+		}
+		profiler.endCpu(cpuSwap);
+
+		// programs still building and assets still loading will swap in on a later frame, so keep an
+		// idle loop drawing until then (and once more for whatever arrived just now)
+		if (!shaderManager.isIdle() || !assets.isIdle() || assetsArrived > 0)
+		{
+			requestRedraw();
+		}
+	};
+
+	RenderThread renderThread;
+	renderThread.start(window, !singleThread, renderFrame);
+
+	// MAIN LOOP: input and recording here, GL on the render thread
+	// ------------------------------------------------------------
+	typedef std::chrono::steady_clock Clock;
+	auto milliseconds = [](Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<float, std::milli>(to - from).count();
+	};
+	while (!glfwWindowShouldClose(window))
+	{
+		HeapAllocationScope counted;
+		{
+			std::lock_guard<std::mutex> lock(titleMutex);
+			if (!pendingTitle.empty())
+			{
+				glfwSetWindowTitle(window, pendingTitle.c_str());
+				pendingTitle.clear();
+			}
+		}
+
+		// on-demand: sleep in the event queue until something changes what the next frame would show
+		// -------------------------------------------------------------------------------------------
+		bool animated = scene == SCENE_SPRITES || scene == SCENE_BATCH || scene == SCENE_TEXTURES;
+		if (onDemand && !animated && !redrawRequested.load())
+		{
+			glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+			continue;
+		}
+
+		// pacing: the limiter holds the frame back before input is read, never between input and submit
+		// ----------------------------------------------------------------------------------------------
+		float paceMs = pacer.wait(presentMode, frameLimitHz > 0.0 ? frameLimitHz : pacer.refreshRate());
+
+		// wait for a free slot first, so the input that goes into it is as fresh as possible
+		// -----------------------------------------------------------------------------------
+		int slot = renderThread.acquire();
+		FrameCommands& frame = frames[slot];
+
+		// GLFW: poll IO events (keys pressed/released, mouse moved etc.), then input, late-latched
+		// ----------------------------------------------------------------------------------------
+		Clock::time_point eventsStart = Clock::now();
 		glfwPollEvents();
+		float eventsMs = milliseconds(eventsStart, Clock::now());
+		Clock::time_point inputStart = Clock::now();
+		processInput(window);
+		Clock::time_point inputSampled = Clock::now();
+		redrawRequested.store(false);
+		float inputMs = milliseconds(inputStart, inputSampled);
+
+		// record this frame while the render thread is still busy with the previous one
+		// ------------------------------------------------------------------------------
+		Clock::time_point recordStart = Clock::now();
+		recordFrame(frame, slot, (float)glfwGetTime());
+		frame.inputMs = inputMs;
+		frame.recordMs = milliseconds(recordStart, Clock::now());
+		frame.eventsMs = eventsMs;
+		frame.paceMs = paceMs;
+		frame.inputSampled = inputSampled;
+		frame.presentMode = presentMode;
+		frame.framebufferWidth = framebufferWidth;
+		frame.framebufferHeight = framebufferHeight;
+		frame.showOverlay = showOverlay;
+		frame.captureFrame = capturing && capture.isActive();
+		frame.renderScale = renderScale;
+		frame.dynamicResolution = dynamicResolution;
+		frame.upscaleFilter = upscaleFilter;
+		frame.dumpProfile = dumpProfile;
+		dumpProfile = false;
+		renderThread.submit(slot);
+		if (bench && benchMeasured.load() >= benchFrames)
+		{
+			break;
+		}
 	}
+	renderThread.stop();
+	jobs.stop();
+	capture.stop();
+
+	// bench: the run's frame times, for people and for scripts (the BENCH line)
+	// -------------------------------------------------------------------------
+	if (bench)
+	{
+		for (GLsync fence : benchFences)
+		{
+			if (fence != NULL)
+			{
+				glDeleteSync(fence);
+			}
+		}
+		const char* sceneName = stressScene ? "stress" : SCENE_NAMES[scene - 1];
+		FrameTimeStats frameStats = summarizeFrameTimes(benchFrameMs);
+		FrameTimeStats gpuStats = summarizeFrameTimes(benchGpuMs);
+		printf("bench: %s scene, %dx%d offscreen, %zu frames after %d warmup, %d in flight, %s buffer api\n", sceneName, benchWidth,
+			benchHeight, frameStats.count, BENCH_WARMUP_FRAMES, BENCH_FRAMES_IN_FLIGHT, glext::directStateAccess ? "dsa" : "bind");
+		printf("frame ms  min %.3f  avg %.3f  p50 %.3f  p99 %.3f  max %.3f  (%.1f fps)\n", frameStats.minMs, frameStats.avgMs,
+			frameStats.p50Ms, frameStats.p99Ms, frameStats.maxMs, frameStats.avgMs > 0.0f ? 1000.0f / frameStats.avgMs : 0.0f);
+		printf("gpu ms    min %.3f  avg %.3f  p50 %.3f  p99 %.3f  max %.3f\n", gpuStats.minMs, gpuStats.avgMs, gpuStats.p50Ms,
+			gpuStats.p99Ms, gpuStats.maxMs);
+		printf("BENCH scene=%s width=%d height=%d frames=%zu min_ms=%.3f avg_ms=%.3f p99_ms=%.3f gpu_avg_ms=%.3f gpu_p99_ms=%.3f\n",
+			sceneName, benchWidth, benchHeight, frameStats.count, frameStats.minMs, frameStats.avgMs, frameStats.p99Ms,
+			gpuStats.avgMs, gpuStats.p99Ms);
+		fflush(stdout);
+	}
+
+	// profiler: keep the session's frame history around for regression tracking
+	// --------------------------------------------------------------------------
+	profiler.writeCsv(PROFILE_CSV_PATH);
+	profiler.destroy();
+	batchTextures.destroy();
+	textureStreamer.destroy();
+	batch.destroy();
+	shaderWatcher.stop();
+	shaderManager.writeUsage(SHADER_VARIANTS_PATH);
+	shaderManager.destroy();
+	destroyMesh(quad);
+	assets.stop();
+	frameRing.destroy();
+	staging.destroy();
+	upscaler.destroy();
+	benchTarget.destroy();
+
+	// GPU resources: anything still live here was never destroyed (the retired ones go now)
+	// -------------------------------------------------------------------------------------
+	gpuResources.print();
+	gpuResources.destroy();
 
 	// GLFW: terminate, clearing all previously allocated GLFW resources
 	// -----------------------------------------------------------------
@@ -193,11 +1157,172 @@ int main()
 	return 0;
 }
 
+// command line: "--scene <name>" picks the starting scene ("stress" is the sprites at MAX_SPRITES)
+// ------------------------------------------------------------------------------------------------
+bool parseScene(const char* name, bool& stress)
+{
+	stress = strcmp(name, "stress") == 0;
+	if (stress)
+	{
+		scene = SCENE_SPRITES;
+		return true;
+	}
+	for (int i = 0; i < (int)(sizeof(SCENE_NAMES) / sizeof(SCENE_NAMES[0])); i++)
+	{
+		if (strcmp(name, SCENE_NAMES[i]) == 0)
+		{
+			scene = (Scene)(i + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// "1920x1080"
+bool parseSize(const char* text, int& width, int& height)
+{
+	int parsedWidth = 0, parsedHeight = 0;
+	if (sscanf(text, "%dx%d", &parsedWidth, &parsedHeight) != 2 || parsedWidth <= 0 || parsedHeight <= 0)
+	{
+		return false;
+	}
+	width = parsedWidth;
+	height = parsedHeight;
+	return true;
+}
+
+// "png:<directory>" (numbered PNG files) or "yuv:<path>" (raw I420 frames, a file or a named pipe)
+bool parseCapture(const char* text, CaptureFormat& format, std::string& path)
+{
+	if (strncmp(text, "png:", 4) == 0 || strncmp(text, "yuv:", 4) == 0)
+	{
+		format = text[0] == 'p' ? CAPTURE_PNG : CAPTURE_YUV;
+		path = text + 4;
+		return !path.empty();
+	}
+	return false;
+}
+
 // GLFW: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
+// (GL may live on the render thread, so only remember the size; the viewport follows with the next frame)
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	framebufferWidth = width;
+	framebufferHeight = height;
+	requestRedraw();
+}
+
+// GLFW: the window contents need repainting (uncovered, restored, ...) or the pointer did something
+// -------------------------------------------------------------------------------------------------
+void window_refresh_callback(GLFWwindow* window)
+{
+	requestRedraw();
+}
+
+void cursor_pos_callback(GLFWwindow* window, double x, double y)
+{
+	requestRedraw();
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	requestRedraw();
+}
+
+void scroll_callback(GLFWwindow* window, double x, double y)
+{
+	requestRedraw();
+}
+
+// GLFW: key presses we react to once per press instead of polling every frame
+// ----------------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	requestRedraw();
+	if (action != GLFW_PRESS)
+	{
+		return;
+	}
+
+	if (key == GLFW_KEY_F1)
+	{
+		showOverlay = !showOverlay;
+	}
+	else if (key == GLFW_KEY_F2)
+	{
+		dumpProfile = true;
+	}
+	else if (key == GLFW_KEY_F3)
+	{
+		presentMode = (PresentMode)((presentMode + 1) % PRESENT_MODE_COUNT);
+	}
+	else if (key == GLFW_KEY_F4)
+	{
+		onDemand = !onDemand;
+		std::cout << (onDemand ? "on-demand rendering" : "continuous rendering") << std::endl;
+	}
+	else if (key == GLFW_KEY_F5)
+	{
+		cullMode = (CullMode)((cullMode + 1) % CULL_MODE_COUNT);
+		const char* names[CULL_MODE_COUNT] = { "GPU culling", "CPU culling (SIMD frustum test)", "culling off" };
+		std::cout << names[cullMode] << std::endl;
+	}
+	else if (key == GLFW_KEY_F6)
+	{
+		useLod = !useLod;
+		std::cout << (useLod ? "batch LOD on" : "batch LOD off (full detail)") << std::endl;
+	}
+	else if (key == GLFW_KEY_F7)
+	{
+		lodFade = !lodFade;
+		std::cout << (lodFade ? "LOD cross-fade on" : "LOD cross-fade off") << std::endl;
+	}
+	else if (key == GLFW_KEY_F8)
+	{
+		capturing = !capturing;
+		std::cout << (capturing ? "capture resumed" : "capture paused") << std::endl;
+	}
+	else if (key == GLFW_KEY_F9)
+	{
+		dynamicResolution = !dynamicResolution;
+		std::cout << (dynamicResolution ? "dynamic resolution on" : "dynamic resolution off") << std::endl;
+	}
+	else if (key == GLFW_KEY_F10)
+	{
+		upscaleFilter = (UpscaleFilter)((upscaleFilter + 1) % UPSCALE_FILTER_COUNT);
+		std::cout << upscaleFilterName(upscaleFilter) << " upscale" << std::endl;
+	}
+	else if (key == GLFW_KEY_1)
+	{
+		scene = SCENE_QUAD;
+	}
+	else if (key == GLFW_KEY_2)
+	{
+		scene = SCENE_GRID;
+	}
+	else if (key == GLFW_KEY_3)
+	{
+		scene = SCENE_SPRITES;
+	}
+	else if (key == GLFW_KEY_4)
+	{
+		scene = SCENE_BATCH;
+	}
+	else if (key == GLFW_KEY_5)
+	{
+		scene = SCENE_TEXTURES;
+	}
+}
+
+// mark the next frame dirty and wake the main loop if it is waiting for events (any thread)
+// ----------------------------------------------------------------------------------------
+void requestRedraw()
+{
+	if (!redrawRequested.exchange(true))
+	{
+		glfwPostEmptyEvent();
+	}
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -208,4 +1333,147 @@ void processInput(GLFWwindow* window)
 	{
 		glfwSetWindowShouldClose(window, true);
 	}
-}
\ No newline at end of file
+}
+
+// bake the built-in quad into a mesh file so the loader has an asset even on a fresh checkout
+// -------------------------------------------------------------------------------------------
+bool bakeQuadMesh(const char* path)
+{
+	float vertices[] =
+	{
+		0.5f, 0.5f, 0.0f, 1.0f, 0.0f,	// top right
+		0.5f, -0.5f, 0.0f, 1.0f, 1.0f,	// bottom right
+		-0.5f, -0.5f, 0.0f, 0.0f, 1.0f, // bottom left
+		-0.5f, 0.5f, 0.0f, 0.0f, 0.0f,	// top left
+	};
+
+	unsigned int indices[] =
+	{
+		0, 1, 3,	// first triangle
+		1, 2, 3		// second trinagle
+	};
+
+	MeshBuild build = makePositionUvBuild();
+	build.vertices.assign((unsigned char*)vertices, (unsigned char*)vertices + sizeof(vertices));
+	build.indices.assign(indices, indices + 6);
+
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+	return bakeMesh(path, build);
+}
+
+// bake a dense 128x128 cell grid (33k triangles) with scrambled triangle order, the kind of mesh
+// the cache optimizer is meant for; 16641 vertices so it also ends up with 16 bit indices
+// ----------------------------------------------------------------------------------------------
+bool bakeGridMesh(const char* path)
+{
+	MeshBuild build = makeGrid(128, 0.9f, true);
+
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+	return bakeMesh(path, build);
+}
+
+// a regular polygon with the given number of segments (see makeDisc)
+// ------------------------------------------------------------------
+bool bakeDiscMesh(const char* path, uint32_t segments)
+{
+	MeshBuild build = makeDisc(segments, 0.5f);
+
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+	return bakeMesh(path, build);
+}
+
+// procedural test textures: BC7 rings and checkers in their own hue, or BC5 bump slopes (the two
+// channels of a tangent space normal map); every mip level looks different enough to tell them apart
+// ----------------------------------------------------------------------------------------------------
+bool bakePatternTexture(const char* path, uint32_t index)
+{
+	bool bumps = index >= TEXTURE_BC5_FIRST;
+	TextureImage image;
+	image.width = TEXTURE_SIZE;
+	image.height = TEXTURE_SIZE;
+	image.rgba.resize((size_t)TEXTURE_SIZE * TEXTURE_SIZE * 4);
+	float hue = index * 2.39996f;
+	float frequency = 6.0f + 3.0f * index;
+	for (uint32_t y = 0; y < TEXTURE_SIZE; y++)
+	{
+		for (uint32_t x = 0; x < TEXTURE_SIZE; x++)
+		{
+			float u = (float)x / TEXTURE_SIZE, v = (float)y / TEXTURE_SIZE;
+			float color[3];
+			if (bumps)
+			{
+				// derivative of sin(fu) * sin(fv) bumps, remapped to [0, 1]
+				float f = frequency * 6.2831853f;
+				color[0] = 0.5f + 0.5f * cosf(f * u) * sinf(f * v);
+				color[1] = 0.5f + 0.5f * sinf(f * u) * cosf(f * v);
+				color[2] = 0.0f;
+			}
+			else
+			{
+				float du = u - 0.5f, dv = v - 0.5f;
+				float ring = 0.5f + 0.5f * sinf(sqrtf(du * du + dv * dv) * frequency * 12.0f);
+				bool checker = ((x / 32) + (y / 32)) % 2 == 0;
+				for (int c = 0; c < 3; c++)
+				{
+					float tint = 0.5f + 0.5f * cosf(hue + c * 2.0943951f);
+					color[c] = tint * (0.35f + 0.65f * ring) * (checker ? 1.0f : 0.7f);
+				}
+			}
+			unsigned char* texel = &image.rgba[((size_t)y * TEXTURE_SIZE + x) * 4];
+			for (int c = 0; c < 3; c++)
+			{
+				texel[c] = (unsigned char)(color[c] * 255.0f + 0.5f);
+			}
+			texel[3] = 255;
+		}
+	}
+
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+	return bakeTexture(path, image, bumps ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK);
+}
+
+// bake whichever of the built-in assets is missing on disk or in an older format, one job per asset
+// ---------------------------------------------------------------------------------------------
+bool bakeMissingAssets(JobSystem& jobs)
+{
+	struct AssetBake
+	{
+		const char* path;
+		std::function<bool(const char*)> bake;
+		bool texture;
+	};
+	std::vector<AssetBake> assets =
+	{
+		{ QUAD_MESH_PATH, bakeQuadMesh, false },
+		{ GRID_MESH_PATH, bakeGridMesh, false },
+		{ TRIANGLE_MESH_PATH, [](const char* path) { return bakeDiscMesh(path, 3); }, false },
+		{ HEXAGON_MESH_PATH, [](const char* path) { return bakeDiscMesh(path, 6); }, false },
+		{ CIRCLE_MESH_PATH, [](const char* path) { return bakeDiscMesh(path, 48); }, false }
+	};
+	for (uint32_t i = 0; i < sizeof(TEXTURE_PATHS) / sizeof(TEXTURE_PATHS[0]); i++)
+	{
+		assets.push_back({ TEXTURE_PATHS[i], [i](const char* path) { return bakePatternTexture(path, i); }, true });
+	}
+	std::vector<const AssetBake*> missing;
+	for (const AssetBake& asset : assets)
+	{
+		// texture files have a single version so far: present is current
+		if (asset.texture ? !std::filesystem::exists(asset.path) : !isCurrentMeshFile(asset.path))
+		{
+			missing.push_back(&asset);
+		}
+	}
+
+	std::atomic<bool> ok { true };
+	jobs.parallelFor((uint32_t)missing.size(), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (!missing[i]->bake(missing[i]->path))
+			{
+				ok.store(false);
+			}
+		}
+	});
+	return ok.load();
+}
@@ -0,0 +1,143 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX 1
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read-only memory mapped file
+// ----------------------------
+// The OS pages the file in on demand and can drop those pages again whenever it likes (they are
+// backed by the file), so reading an asset through a mapping never costs a private heap copy.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			close();
+			return false;
+		}
+		bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		length = (size_t)fileSize.QuadPart;
+#else
+		descriptor = ::open(path.c_str(), O_RDONLY);
+		if (descriptor < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		bytes = view == MAP_FAILED ? NULL : (const unsigned char*)view;
+		length = (size_t)info.st_size;
+		if (bytes != NULL)
+		{
+			// we stream through the file front to back exactly once
+			madvise(view, length, MADV_SEQUENTIAL);
+		}
+#endif
+		if (bytes == NULL)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes != NULL)
+		{
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping != NULL)
+		{
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes != NULL)
+		{
+			munmap((void*)bytes, length);
+		}
+		if (descriptor >= 0)
+		{
+			::close(descriptor);
+		}
+		descriptor = -1;
+#endif
+		bytes = NULL;
+		length = 0;
+	}
+
+	const unsigned char* data() const
+	{
+		return bytes;
+	}
+
+	size_t size() const
+	{
+		return length;
+	}
+
+private:
+	const unsigned char* bytes = NULL;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int descriptor = -1;
+#endif
+};
+
+#endif
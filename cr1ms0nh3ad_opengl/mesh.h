@@ -0,0 +1,133 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "mesh_file.h"
+#include "staging_buffer.h"
+
+#include <string>
+#include <vector>
+
+// a mesh living on the GPU (move-only: it owns its GL objects, see gpu_resources.h)
+// ---------------------------------------------------------------------------------
+struct Mesh
+{
+	GpuVertexArray VAO;
+	GpuBuffer VBO;
+	GpuBuffer EBO;
+	GpuBuffer decodeVBO;					// position center + extent, see vertex_quantize.h
+	unsigned int vertexCount = 0;
+	unsigned int indexCount = 0;			// full detail level (the index buffer holds every level, see lods)
+	GLenum indexType = GL_UNSIGNED_INT;
+	float boundsMin[3] = {};
+	float boundsMax[3] = {};
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+};
+
+// create a GPU buffer and fill it straight from the mapped file: through the persistent staging
+// buffer into immutable storage when we have GL 4.4, otherwise handed to glBufferData directly.
+// Either way no CPU side copy of the stream is ever made.
+inline unsigned int createStaticBuffer(const void* data, size_t size, StagingBuffer& staging)
+{
+	unsigned int buffer = glbuffers::createBuffer();
+	if (staging.isAvailable())
+	{
+		glbuffers::storage(buffer, size, NULL, 0);
+		staging.upload(buffer, 0, data, size);
+	}
+	else
+	{
+		glbuffers::data(buffer, size, data, GL_STATIC_DRAW);
+	}
+	return buffer;
+}
+
+// the CPU side of a mesh from its file: counts, bounds, levels of detail, meshlets (any thread)
+inline void describeMesh(const MeshFile& file, Mesh& mesh)
+{
+	const MeshFileHeader& info = file.info();
+	mesh.vertexCount = info.vertexCount;
+	mesh.lods.assign(file.lods(), file.lods() + info.lodCount);
+	mesh.indexCount = mesh.lods[0].indexCount;
+	mesh.indexType = info.indexType;
+	for (int k = 0; k < 3; k++)
+	{
+		mesh.boundsMin[k] = info.boundsMin[k];
+		mesh.boundsMax[k] = info.boundsMax[k];
+	}
+	mesh.meshlets.assign(file.meshlets(), file.meshlets() + info.meshletCount);
+}
+
+// set up the VAO of a mesh whose VBO and EBO are filled, from the attribute layout in its file
+// --------------------------------------------------------------------------------------------
+// Quantized positions decode as center + stored * extent (vertex_decode.glsl). The two vectors sit
+// in a buffer of their own, read through attributes with a divisor no instance count reaches, so
+// every vertex of every instance sees element 0: the decode is VAO state like the layout, and the
+// render queue, the instanced sprites and the benchmark paths draw the mesh without knowing about
+// it. Float meshes get the identity decode (center 0, extent 1). VAOs aren't shared between
+// contexts, so this is always the GL thread's, wherever the buffers were filled.
+inline void createMeshVertexArray(const MeshFileHeader& info, Mesh& mesh)
+{
+	mesh.VAO.create(GPU_CATEGORY_MESH);
+	glbuffers::elementBuffer(mesh.VAO.get(), mesh.EBO.get());
+	for (uint32_t i = 0; i < info.attributeCount; i++)
+	{
+		const MeshAttribute& attribute = info.attributes[i];
+		glbuffers::attribute
+		(
+			mesh.VAO.get(),
+			attribute.location,
+			mesh.VBO.get(),
+			attribute.components,
+			attribute.type,
+			attribute.normalized != 0,
+			info.vertexStride,
+			attribute.offset
+		);
+	}
+
+	float decode[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+	if (info.flags & MESH_FLAG_QUANTIZED)
+	{
+		boundsDecode(info.boundsMin, info.boundsMax, decode, decode + 3);
+	}
+	mesh.decodeVBO.create(GPU_CATEGORY_MESH, sizeof(decode));
+	glbuffers::data(mesh.decodeVBO.get(), sizeof(decode), decode, GL_STATIC_DRAW);
+	const unsigned int decodeLocations[2] = { MESH_POSITION_CENTER_LOCATION, MESH_POSITION_EXTENT_LOCATION };
+	for (int i = 0; i < 2; i++)
+	{
+		glbuffers::attribute(mesh.VAO.get(), decodeLocations[i], mesh.decodeVBO.get(), 3, GL_FLOAT, false, 3 * sizeof(float), i * 3 * sizeof(float), 0xFFFFFFFFu);
+	}
+
+	// the 3.3 path edited through real binds; leave no mesh VAO current for code that binds buffers next
+	glState.bindVertexArray(0);
+}
+
+// load a .crmesh on the GL thread, blocking until it is on the GPU (asset_loader.h streams them instead)
+inline bool loadMesh(const std::string& path, StagingBuffer& staging, Mesh& mesh)
+{
+	MeshFile file;
+	if (!file.open(path))
+	{
+		return false;
+	}
+	describeMesh(file, mesh);
+	mesh.VBO.adopt(createStaticBuffer(file.vertexData(), file.vertexBytes(), staging), GPU_CATEGORY_MESH, file.vertexBytes());
+	mesh.EBO.adopt(createStaticBuffer(file.indexData(), file.indexBytes(), staging), GPU_CATEGORY_MESH, file.indexBytes());
+	createMeshVertexArray(file.info(), mesh);
+	return true;
+}
+
+// the GL objects go once the frames still drawing the mesh are done (see gpu_resources.h)
+inline void destroyMesh(Mesh& mesh)
+{
+	mesh = Mesh();
+}
+
+#endif
@@ -0,0 +1,591 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <glad/glad.h>
+
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplify.h"
+#include "vertex_quantize.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// binary mesh format (.crmesh)
+// ----------------------------
+// header | interleaved vertex stream | index stream | meshlet table | LOD table
+// Every stream starts on a 16 byte boundary and is stored exactly as the GPU consumes it, so the
+// loader hands pointers into the mapped file straight to the upload and never copies on the CPU.
+// The index stream holds every level of detail back to back (full detail first), all indexing the
+// one vertex stream; the LOD table says where each level starts. Quantized files (MESH_FLAG_QUANTIZED,
+// what the bake writes) store compressed attributes with positions relative to the bounding box in
+// the header; see vertex_quantize.h.
+const uint32_t MESH_FILE_MAGIC = 0x534d5243;	// "CRMS"
+const uint32_t MESH_FILE_VERSION = 3;
+const uint32_t MESH_FLAG_QUANTIZED = 1 << 0;
+const int MESH_MAX_ATTRIBUTES = 8;
+const int MESH_MAX_LODS = 8;
+
+// meshlets: small clusters of triangles (at most 64 unique vertices / 124 triangles) with a bounding
+// sphere, contiguous in the index stream so each one is a plain (firstIndex, indexCount) draw range
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+struct MeshAttribute
+{
+	uint32_t location;
+	uint32_t components;
+	uint32_t type;			// GL_FLOAT, GL_HALF_FLOAT, GL_INT_2_10_10_10_REV, ...
+	uint32_t normalized;
+	uint32_t offset;		// byte offset inside one vertex
+};
+
+struct Meshlet
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+	float center[3];
+	float radius;
+	uint32_t padding;
+};
+
+// one level of detail: an index range plus the geometric error it was simplified with, in mesh
+// units (the furthest the surface may have moved); level 0 is the full mesh with error 0
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+	uint32_t padding;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	uint32_t indexType;		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t meshletCount;
+	uint32_t attributeCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t meshletOffset;
+	uint64_t lodOffset;
+	uint32_t lodCount;
+	uint32_t flags;			// MESH_FLAG_*
+	MeshAttribute attributes[MESH_MAX_ATTRIBUTES];
+};
+
+inline uint32_t meshIndexSize(uint32_t indexType)
+{
+	return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// read side: a validated view into a mapped .crmesh file
+// ------------------------------------------------------
+class MeshFile
+{
+public:
+	bool open(const std::string& path)
+	{
+		if (!file.open(path))
+		{
+			std::cout << "ERROR::MESH_FILE::OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+		if (file.size() < sizeof(MeshFileHeader))
+		{
+			return invalid(path, "truncated header");
+		}
+
+		header = (const MeshFileHeader*)file.data();
+		if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION)
+		{
+			return invalid(path, "unknown magic or version");
+		}
+		if (header->attributeCount > (uint32_t)MESH_MAX_ATTRIBUTES || header->vertexStride == 0)
+		{
+			return invalid(path, "bad vertex layout");
+		}
+		if (header->indexType != GL_UNSIGNED_SHORT && header->indexType != GL_UNSIGNED_INT)
+		{
+			return invalid(path, "bad index type");
+		}
+		if (!fits(header->vertexOffset, (uint64_t)header->vertexCount * header->vertexStride)
+			|| !fits(header->indexOffset, (uint64_t)header->indexCount * meshIndexSize(header->indexType))
+			|| !fits(header->meshletOffset, (uint64_t)header->meshletCount * sizeof(Meshlet))
+			|| !fits(header->lodOffset, (uint64_t)header->lodCount * sizeof(MeshLod)))
+		{
+			return invalid(path, "stream out of bounds");
+		}
+		if (header->lodCount == 0 || header->lodCount > (uint32_t)MESH_MAX_LODS)
+		{
+			return invalid(path, "bad LOD count");
+		}
+		for (uint32_t i = 0; i < header->lodCount; i++)
+		{
+			const MeshLod& lod = lods()[i];
+			if (lod.firstIndex > header->indexCount || lod.indexCount > header->indexCount - lod.firstIndex)
+			{
+				return invalid(path, "LOD out of bounds");
+			}
+		}
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		header = NULL;
+	}
+
+	const MeshFileHeader& info() const { return *header; }
+	const void* vertexData() const { return file.data() + header->vertexOffset; }
+	size_t vertexBytes() const { return (size_t)header->vertexCount * header->vertexStride; }
+	const void* indexData() const { return file.data() + header->indexOffset; }
+	size_t indexBytes() const { return (size_t)header->indexCount * meshIndexSize(header->indexType); }
+	const Meshlet* meshlets() const { return (const Meshlet*)(file.data() + header->meshletOffset); }
+	const MeshLod* lods() const { return (const MeshLod*)(file.data() + header->lodOffset); }
+
+private:
+	MappedFile file;
+	const MeshFileHeader* header = NULL;
+
+	bool fits(uint64_t offset, uint64_t size) const
+	{
+		return offset % 16 == 0 && offset <= file.size() && size <= file.size() - offset;
+	}
+
+	bool invalid(const std::string& path, const char* reason)
+	{
+		std::cout << "ERROR::MESH_FILE::INVALID " << path << " (" << reason << ")" << std::endl;
+		close();
+		return false;
+	}
+};
+
+// true when path holds a mesh file in the current format (quietly: a missing or outdated file is
+// just something to bake, not an error)
+inline bool isCurrentMeshFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t start[2] = {};
+	return file.read((char*)start, sizeof(start)) && start[0] == MESH_FILE_MAGIC && start[1] == MESH_FILE_VERSION;
+}
+
+// repack vertexCount float vertices (attributes as described, at stride) into the compressed formats
+// of vertex_quantize.h; the packed attributes and stride come back through packedAttributes / packedStride
+inline std::vector<unsigned char> quantizeVertices(const unsigned char* vertices, uint32_t vertexCount, uint32_t stride,
+	const MeshAttribute* attributes, uint32_t attributeCount, const float boundsMin[3], const float boundsMax[3],
+	std::vector<MeshAttribute>& packedAttributes, uint32_t& packedStride)
+{
+	float center[3], extent[3];
+	boundsDecode(boundsMin, boundsMax, center, extent);
+
+	enum Packing { PACK_POSITION, PACK_NORMAL, PACK_UV, PACK_COLOR, PACK_COPY };
+	std::vector<Packing> packing(attributeCount);
+	std::vector<uint32_t> sizes(attributeCount);
+	packedAttributes.resize(attributeCount);
+	packedStride = 0;
+	for (uint32_t i = 0; i < attributeCount; i++)
+	{
+		const MeshAttribute& attribute = attributes[i];
+		MeshAttribute& packed = packedAttributes[i];
+		packed = attribute;
+		packed.offset = packedStride;
+		bool floats = attribute.type == GL_FLOAT;
+		if (floats && attribute.location == MESH_POSITION_LOCATION && attribute.components == 3)
+		{
+			packing[i] = PACK_POSITION;
+			packed.type = GL_HALF_FLOAT;
+			sizes[i] = 8;
+		}
+		else if (floats && attribute.location == MESH_NORMAL_LOCATION && attribute.components == 3)
+		{
+			packing[i] = PACK_NORMAL;
+			packed.components = 4;
+			packed.type = GL_INT_2_10_10_10_REV;
+			packed.normalized = GL_TRUE;
+			sizes[i] = 4;
+		}
+		else if (floats && attribute.location == MESH_UV_LOCATION && attribute.components == 2)
+		{
+			packing[i] = PACK_UV;
+			packed.type = GL_UNSIGNED_SHORT;
+			packed.normalized = GL_TRUE;
+			sizes[i] = 4;
+		}
+		else if (floats && attribute.location == MESH_COLOR_LOCATION && attribute.components == 4)
+		{
+			packing[i] = PACK_COLOR;
+			packed.type = GL_UNSIGNED_BYTE;
+			packed.normalized = GL_TRUE;
+			sizes[i] = 4;
+		}
+		else
+		{
+			packing[i] = PACK_COPY;
+			uint32_t componentSize = attribute.type == GL_UNSIGNED_BYTE || attribute.type == GL_BYTE ? 1
+				: attribute.type == GL_UNSIGNED_SHORT || attribute.type == GL_SHORT || attribute.type == GL_HALF_FLOAT ? 2 : 4;
+			bool packed32 = attribute.type == GL_INT_2_10_10_10_REV || attribute.type == GL_UNSIGNED_INT_2_10_10_10_REV;
+			sizes[i] = packed32 ? 4 : (attribute.components * componentSize + 3) & ~3u;
+		}
+		packedStride += sizes[i];
+	}
+
+	std::vector<unsigned char> out((size_t)vertexCount * packedStride);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const unsigned char* vertex = vertices + (size_t)v * stride;
+		unsigned char* target = out.data() + (size_t)v * packedStride;
+		for (uint32_t i = 0; i < attributeCount; i++)
+		{
+			const unsigned char* from = vertex + attributes[i].offset;
+			unsigned char* to = target + packedAttributes[i].offset;
+			float value[4] = {};
+			if (packing[i] != PACK_COPY)
+			{
+				memcpy(value, from, attributes[i].components * sizeof(float));
+			}
+			switch (packing[i])
+			{
+			case PACK_POSITION:
+			{
+				uint16_t half[4] = {};
+				for (int k = 0; k < 3; k++)
+				{
+					half[k] = floatToHalf(extent[k] > 0.0f ? (value[k] - center[k]) / extent[k] : 0.0f);
+				}
+				memcpy(to, half, sizeof(half));
+				break;
+			}
+			case PACK_NORMAL:
+			{
+				float octahedral[2];
+				octahedralEncode(value, octahedral);
+				uint32_t word = packSnorm1010102(octahedral[0], octahedral[1], 0.0f, 0.0f);
+				memcpy(to, &word, sizeof(word));
+				break;
+			}
+			case PACK_UV:
+			{
+				uint16_t uv[2] = { packUnorm16(value[0]), packUnorm16(value[1]) };
+				memcpy(to, uv, sizeof(uv));
+				break;
+			}
+			case PACK_COLOR:
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					to[k] = packUnorm8(value[k]);
+				}
+				break;
+			}
+			case PACK_COPY:
+				memcpy(to, from, sizes[i] < stride - attributes[i].offset ? sizes[i] : stride - attributes[i].offset);
+				break;
+			}
+		}
+	}
+	return out;
+}
+
+// write side: interleaved vertices + 32 bit indices into a .crmesh (position = 3 floats at attribute location 0);
+// indices are narrowed to 16 bit on the way out whenever the vertex count allows it. Without a LOD table the
+// whole index stream is written as the only level; quantize packs the vertices (see quantizeVertices)
+// ---------------------------------------------------------------------------------------------------------------
+struct MeshSource
+{
+	const void* vertices;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	const MeshAttribute* attributes;
+	uint32_t attributeCount;
+	const uint32_t* indices;
+	uint32_t indexCount;
+	const MeshLod* lods;
+	uint32_t lodCount;
+};
+
+inline const float* meshPosition(const MeshSource& source, uint32_t vertex)
+{
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < source.attributeCount; i++)
+	{
+		if (source.attributes[i].location == 0)
+		{
+			offset = source.attributes[i].offset;
+		}
+	}
+	return (const float*)((const unsigned char*)source.vertices + (size_t)vertex * source.vertexStride + offset);
+}
+
+// greedy clustering in index order: a meshlet closes once the next triangle would overflow it
+inline std::vector<Meshlet> buildMeshlets(const MeshSource& source)
+{
+	std::vector<Meshlet> meshlets;
+	uint32_t unique[MESHLET_MAX_VERTICES];
+	Meshlet current = {};
+	float lo[3] = {}, hi[3] = {};
+
+	auto close = [&]()
+	{
+		if (current.indexCount == 0)
+		{
+			return;
+		}
+		float radius = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			current.center[k] = 0.5f * (lo[k] + hi[k]);
+		}
+		for (uint32_t v = 0; v < current.vertexCount; v++)
+		{
+			const float* p = meshPosition(source, unique[v]);
+			float dx = p[0] - current.center[0], dy = p[1] - current.center[1], dz = p[2] - current.center[2];
+			float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+			radius = distance > radius ? distance : radius;
+		}
+		current.radius = radius;
+		meshlets.push_back(current);
+		current = {};
+		current.firstIndex = meshlets.back().firstIndex + meshlets.back().indexCount;
+	};
+
+	for (uint32_t t = 0; t + 2 < source.indexCount; t += 3)
+	{
+		uint32_t added = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			bool seen = false;
+			for (uint32_t v = 0; v < current.vertexCount && !seen; v++)
+			{
+				seen = unique[v] == source.indices[t + c];
+			}
+			added += seen ? 0 : 1;
+		}
+		if (current.vertexCount + added > MESHLET_MAX_VERTICES || current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES)
+		{
+			close();
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t index = source.indices[t + c];
+			bool seen = false;
+			for (uint32_t v = 0; v < current.vertexCount && !seen; v++)
+			{
+				seen = unique[v] == index;
+			}
+			if (!seen)
+			{
+				unique[current.vertexCount++] = index;
+			}
+
+			const float* p = meshPosition(source, index);
+			for (int k = 0; k < 3; k++)
+			{
+				bool first = current.indexCount == 0 && c == 0;
+				lo[k] = first || p[k] < lo[k] ? p[k] : lo[k];
+				hi[k] = first || p[k] > hi[k] ? p[k] : hi[k];
+			}
+		}
+		current.indexCount += 3;
+	}
+	close();
+	return meshlets;
+}
+
+inline bool writeMeshFile(const std::string& path, const MeshSource& source, bool quantize = false)
+{
+	if (source.attributeCount > (uint32_t)MESH_MAX_ATTRIBUTES)
+	{
+		std::cout << "ERROR::MESH_FILE::TOO_MANY_ATTRIBUTES " << path << std::endl;
+		return false;
+	}
+	if (source.lodCount > (uint32_t)MESH_MAX_LODS)
+	{
+		std::cout << "ERROR::MESH_FILE::TOO_MANY_LODS " << path << std::endl;
+		return false;
+	}
+	std::vector<MeshLod> lods(source.lods, source.lods + source.lodCount);
+	if (lods.empty())
+	{
+		lods.push_back({ 0, source.indexCount, 0.0f, 0 });
+	}
+
+	// meshlets cluster the full detail level only
+	MeshSource fullDetail = source;
+	fullDetail.indices = source.indices + lods[0].firstIndex;
+	fullDetail.indexCount = lods[0].indexCount;
+	std::vector<Meshlet> meshlets = buildMeshlets(fullDetail);
+	for (Meshlet& meshlet : meshlets)
+	{
+		meshlet.firstIndex += lods[0].firstIndex;
+	}
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = source.vertexCount;
+	header.vertexStride = source.vertexStride;
+	header.indexCount = source.indexCount;
+	header.indexType = chooseIndexType(source.vertexCount);
+	header.meshletCount = (uint32_t)meshlets.size();
+	header.attributeCount = source.attributeCount;
+	header.lodCount = (uint32_t)lods.size();
+	memcpy(header.attributes, source.attributes, source.attributeCount * sizeof(MeshAttribute));
+
+	for (uint32_t v = 0; v < source.vertexCount; v++)
+	{
+		const float* p = meshPosition(source, v);
+		for (int k = 0; k < 3; k++)
+		{
+			header.boundsMin[k] = v == 0 || p[k] < header.boundsMin[k] ? p[k] : header.boundsMin[k];
+			header.boundsMax[k] = v == 0 || p[k] > header.boundsMax[k] ? p[k] : header.boundsMax[k];
+		}
+	}
+
+	// bounds and meshlets come from the float positions, the file gets the packed ones
+	const void* vertexData = source.vertices;
+	std::vector<unsigned char> packed;
+	if (quantize)
+	{
+		std::vector<MeshAttribute> packedAttributes;
+		packed = quantizeVertices((const unsigned char*)source.vertices, source.vertexCount, source.vertexStride, source.attributes,
+			source.attributeCount, header.boundsMin, header.boundsMax, packedAttributes, header.vertexStride);
+		memcpy(header.attributes, packedAttributes.data(), source.attributeCount * sizeof(MeshAttribute));
+		header.flags |= MESH_FLAG_QUANTIZED;
+		vertexData = packed.data();
+	}
+
+	auto align = [](uint64_t offset) { return (offset + 15) & ~(uint64_t)15; };
+	uint64_t vertexBytes = (uint64_t)source.vertexCount * header.vertexStride;
+	uint64_t indexBytes = (uint64_t)source.indexCount * meshIndexSize(header.indexType);
+	std::vector<uint16_t> shortIndices;
+	const void* indexData = source.indices;
+	if (header.indexType == GL_UNSIGNED_SHORT)
+	{
+		shortIndices.assign(source.indices, source.indices + source.indexCount);
+		indexData = shortIndices.data();
+	}
+	header.vertexOffset = align(sizeof(MeshFileHeader));
+	header.indexOffset = align(header.vertexOffset + vertexBytes);
+	header.meshletOffset = align(header.indexOffset + indexBytes);
+	header.lodOffset = align(header.meshletOffset + meshlets.size() * sizeof(Meshlet));
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::MESH_FILE::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+
+	const char zeros[16] = {};
+	auto pad = [&](uint64_t offset) { file.write(zeros, (std::streamsize)(offset - (uint64_t)file.tellp())); };
+
+	file.write((const char*)&header, sizeof(header));
+	pad(header.vertexOffset);
+	file.write((const char*)vertexData, (std::streamsize)vertexBytes);
+	pad(header.indexOffset);
+	file.write((const char*)indexData, (std::streamsize)indexBytes);
+	pad(header.meshletOffset);
+	file.write((const char*)meshlets.data(), (std::streamsize)(meshlets.size() * sizeof(Meshlet)));
+	pad(header.lodOffset);
+	file.write((const char*)lods.data(), (std::streamsize)(lods.size() * sizeof(MeshLod)));
+	return (bool)file;
+}
+
+// the bake stage: reorder triangles for the post-transform cache, build the simplified levels of
+// detail, reorder vertices for fetch locality over all of them, then write with the narrowest index
+// type. ACMR before/after and the triangles per level are printed so gains can be tracked
+// ------------------------------------------------------------------------------------------------
+struct MeshBuild
+{
+	std::vector<unsigned char> vertices;
+	uint32_t vertexStride = 0;
+	std::vector<MeshAttribute> attributes;
+	std::vector<uint32_t> indices;
+	bool quantize = true;			// write compressed attributes (see vertex_quantize.h)
+
+	uint32_t vertexCount() const
+	{
+		return vertexStride ? (uint32_t)(vertices.size() / vertexStride) : 0;
+	}
+};
+
+// each level aims for half the triangles of the one before; the chain ends when a level no longer
+// gets meaningfully smaller, or has moved the surface by more than half the mesh's bounding radius
+const float MESH_LOD_MIN_REDUCTION = 0.9f;
+const float MESH_LOD_MAX_RELATIVE_ERROR = 0.5f;
+
+inline bool bakeMesh(const std::string& path, MeshBuild& build)
+{
+	uint32_t vertexCount = build.vertexCount();
+	uint32_t indexCount = (uint32_t)build.indices.size();
+	float before = computeACMR(build.indices.data(), indexCount, vertexCount);
+
+	optimizeVertexCache(build.indices.data(), indexCount, vertexCount);
+	float after = computeACMR(build.indices.data(), indexCount, vertexCount);
+
+	// levels of detail: every level is simplified from the previous one (so the error only grows) and
+	// indexes the same vertices, which then only need one fetch reorder for all of them
+	MeshSource positions = { build.vertices.data(), vertexCount, build.vertexStride, build.attributes.data(), (uint32_t)build.attributes.size(), NULL, 0, NULL, 0 };
+	float radius = 0.0f;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = meshPosition(positions, v);
+		float distance = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		radius = distance > radius ? distance : radius;
+	}
+	std::vector<MeshLod> lods = { { 0, indexCount, 0.0f, 0 } };
+	MeshSimplifier simplifier(meshPosition(positions, 0), vertexCount, build.vertexStride, build.indices.data(), indexCount);
+	while (lods.size() < (size_t)MESH_MAX_LODS)
+	{
+		uint32_t previous = lods.back().indexCount / 3;
+		simplifier.simplify(previous / 2, radius * MESH_LOD_MAX_RELATIVE_ERROR);
+		if (simplifier.triangleCount() > previous * MESH_LOD_MIN_REDUCTION)
+		{
+			break;
+		}
+		std::vector<uint32_t> level = simplifier.indices();
+		optimizeVertexCache(level.data(), (uint32_t)level.size(), vertexCount);
+		lods.push_back({ (uint32_t)build.indices.size(), (uint32_t)level.size(), simplifier.error(), 0 });
+		build.indices.insert(build.indices.end(), level.begin(), level.end());
+	}
+
+	uint32_t allIndices = (uint32_t)build.indices.size();
+	vertexCount = optimizeVertexFetch(build.vertices.data(), vertexCount, build.vertexStride, build.indices.data(), allIndices);
+	build.vertices.resize((size_t)vertexCount * build.vertexStride);
+
+	std::cout << "MESH_BAKE::" << path << " " << indexCount / 3 << " triangles, " << vertexCount << " vertices, "
+		<< (chooseIndexType(vertexCount) == GL_UNSIGNED_SHORT ? 16 : 32) << " bit indices, "
+		<< (build.quantize ? "quantized" : "float") << " vertices, ACMR "
+		<< before << " -> " << after << ", LODs";
+	for (const MeshLod& lod : lods)
+	{
+		std::cout << " " << lod.indexCount / 3;
+	}
+	std::cout << std::endl;
+
+	MeshSource source =
+	{
+		build.vertices.data(), vertexCount, build.vertexStride,
+		build.attributes.data(), (uint32_t)build.attributes.size(),
+		build.indices.data(), allIndices,
+		lods.data(), (uint32_t)lods.size()
+	};
+	return writeMeshFile(path, source, build.quantize);
+}
+
+#endif
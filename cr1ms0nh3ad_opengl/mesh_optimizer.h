@@ -0,0 +1,251 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// mesh processing: index width selection, post-transform vertex cache and vertex fetch ordering
+// ---------------------------------------------------------------------------------------------
+// These run at bake time on the CPU (see bakeMesh in mesh_file.h), so they favour clarity over
+// squeezing out the last cycle; the runtime only ever sees the optimized streams.
+
+// 16 bit indices whenever every vertex is addressable with them
+inline uint32_t chooseIndexType(uint32_t vertexCount)
+{
+	return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// average cache miss ratio: transformed vertices per triangle for a FIFO post-transform cache
+// (0.5 is the ideal for a large regular grid, 3.0 means every vertex is transformed every time)
+inline float computeACMR(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 32)
+{
+	if (indexCount < 3)
+	{
+		return 0.0f;
+	}
+
+	// pushedAt is the 1-based number of the vertex's push; it is still in the FIFO while fewer than
+	// cacheSize pushes have come after it
+	std::vector<uint32_t> pushedAt(vertexCount, 0);
+	uint32_t pushes = 0;
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (pushedAt[v] == 0 || pushes - pushedAt[v] >= cacheSize)
+		{
+			pushedAt[v] = ++pushes;
+			misses++;
+		}
+	}
+	return (float)misses / (indexCount / 3);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation: greedily emit the triangle whose vertices
+// score highest, where recently used vertices and vertices with few remaining triangles score high
+// -------------------------------------------------------------------------------------------------
+namespace forsyth
+{
+	const int CACHE_SIZE = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	inline float vertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// the triangle just emitted: fixed score so we don't favour reusing it immediately
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				float scale = 1.0f / (CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+			}
+		}
+		score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+		return score;
+	}
+}
+
+inline void optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	using namespace forsyth;
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// vertex -> triangles adjacency, packed
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		remaining[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t v = indices[t * 3 + c];
+			adjacency[fill[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> output(indexCount);
+	uint32_t cache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+	uint32_t scanStart = 0;
+
+	int best = -1;
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (best < 0)
+		{
+			// nothing in the cache touches an open triangle: fall back to the best one overall
+			float bestScore = -1.0f;
+			while (scanStart < triangleCount && emitted[scanStart])
+			{
+				scanStart++;
+			}
+			for (uint32_t t = scanStart; t < triangleCount; t++)
+			{
+				if (!emitted[t] && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		uint32_t triangle = (uint32_t)best;
+		emitted[triangle] = true;
+		const uint32_t* corners = indices + triangle * 3;
+		memcpy(&output[emittedCount * 3], corners, 3 * sizeof(uint32_t));
+
+		// take the triangle out of its vertices' adjacency lists
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t v = corners[c];
+			uint32_t* list = &adjacency[adjacencyStart[v]];
+			for (uint32_t k = 0; k < remaining[v]; k++)
+			{
+				if (list[k] == triangle)
+				{
+					list[k] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// move the triangle's vertices to the front of the LRU cache
+		uint32_t newCache[CACHE_SIZE + 3];
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			newCache[newCount++] = corners[c];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			uint32_t v = cache[i];
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// rescore everything that was or is in the cache, and the triangles around it
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < CACHE_SIZE ? i : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+			const uint32_t* list = &adjacency[adjacencyStart[v]];
+			for (uint32_t k = 0; k < remaining[v]; k++)
+			{
+				uint32_t t = list[k];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+
+	memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+}
+
+// reorder vertices into first-use order of the (already cache optimized) index stream so vertex
+// fetch walks memory forward; unreferenced vertices are dropped. Returns the new vertex count.
+inline uint32_t optimizeVertexFetch(void* vertices, uint32_t vertexCount, uint32_t vertexStride, uint32_t* indices, uint32_t indexCount)
+{
+	const uint32_t UNUSED = 0xFFFFFFFFu;
+	std::vector<uint32_t> remap(vertexCount, UNUSED);
+	std::vector<unsigned char> reordered((size_t)vertexCount * vertexStride);
+	const unsigned char* source = (const unsigned char*)vertices;
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (remap[v] == UNUSED)
+		{
+			remap[v] = next;
+			memcpy(&reordered[(size_t)next * vertexStride], source + (size_t)v * vertexStride, vertexStride);
+			next++;
+		}
+		indices[i] = remap[v];
+	}
+
+	memcpy(vertices, reordered.data(), (size_t)next * vertexStride);
+	return next;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+// quadric error simplification (Garland & Heckbert 1997), vertex-restricted
+// -------------------------------------------------------------------------
+// Like the optimizer this runs at bake time. Every vertex accumulates the planes of the triangles
+// around it, plus a plane perpendicular to each open edge so outlines survive (a flat mesh has no
+// other error to keep them in place). Edges are collapsed cheapest first, always onto one of their
+// two endpoints: a simplified level is just another index list over the same vertices, which is
+// what lets every LOD share one vertex buffer. A collapse is rejected if it would flip a triangle or
+// break the local topology (the two endpoints may only share the neighbours of the triangles
+// between them), or if it would remove the last triangle. Positions are 3 floats; vertices are
+// matched by index, not welded by position.
+class MeshSimplifier
+{
+public:
+	// positions: vertexCount * positionStride bytes, each vertex starting with x, y, z floats
+	MeshSimplifier(const void* positions, uint32_t vertexCount, uint32_t positionStride, const uint32_t* indices, uint32_t indexCount)
+	{
+		points.resize(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			const float* p = (const float*)((const unsigned char*)positions + (size_t)v * positionStride);
+			points[v] = { p[0], p[1], p[2] };
+		}
+		triangles.assign(indices, indices + indexCount - indexCount % 3);
+		liveTriangles = (uint32_t)triangles.size() / 3;
+		triangleLive.assign(liveTriangles, true);
+		vertexTriangles.resize(vertexCount);
+		vertexLive.assign(vertexCount, true);
+		version.assign(vertexCount, 0);
+		quadrics.assign(vertexCount, Quadric());
+		for (uint32_t t = 0; t < liveTriangles; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				vertexTriangles[triangles[t * 3 + c]].push_back(t);
+			}
+		}
+		buildQuadrics();
+		for (uint32_t t = 0; t < liveTriangles; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				pushEdge(triangles[t * 3 + c], triangles[t * 3 + (c + 1) % 3]);
+			}
+		}
+	}
+
+	uint32_t triangleCount() const
+	{
+		return liveTriangles;
+	}
+
+	// collapse until at most targetTriangles are left, or the next collapse would exceed maxError
+	// (position units), or nothing more can go; returns false when the target wasn't reached
+	bool simplify(uint32_t targetTriangles, float maxError)
+	{
+		double maxAllowed = (double)maxError * maxError;
+		while (liveTriangles > targetTriangles && !candidates.empty())
+		{
+			Candidate candidate = candidates.top();
+			if (!vertexLive[candidate.from] || !vertexLive[candidate.to]
+				|| version[candidate.from] != candidate.fromVersion || version[candidate.to] != candidate.toVersion)
+			{
+				candidates.pop();
+				continue;
+			}
+			if (candidate.cost > maxAllowed)
+			{
+				break;
+			}
+			candidates.pop();
+			collapse(candidate);
+		}
+		return liveTriangles <= targetTriangles;
+	}
+
+	// largest deviation introduced so far, in position units: the square root of the worst quadric
+	// cost accepted, which bounds the distance to every plane it was summed from
+	float error() const
+	{
+		return std::sqrt((float)maxCost);
+	}
+
+	std::vector<uint32_t> indices() const
+	{
+		std::vector<uint32_t> result;
+		result.reserve((size_t)liveTriangles * 3);
+		for (uint32_t t = 0; t < triangleLive.size(); t++)
+		{
+			if (triangleLive[t])
+			{
+				result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+			}
+		}
+		return result;
+	}
+
+private:
+	struct Vector
+	{
+		double x, y, z;
+	};
+
+	// symmetric 4x4 in 10 coefficients: a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+	struct Quadric
+	{
+		double a[10] = {};
+
+		void addPlane(const Vector& n, double d)
+		{
+			double p[4] = { n.x, n.y, n.z, d };
+			int k = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = i; j < 4; j++)
+				{
+					a[k++] += p[i] * p[j];
+				}
+			}
+		}
+
+		void add(const Quadric& other)
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				a[i] += other.a[i];
+			}
+		}
+
+		double evaluate(const Vector& v) const
+		{
+			double result = a[0] * v.x * v.x + 2.0 * a[1] * v.x * v.y + 2.0 * a[2] * v.x * v.z + 2.0 * a[3] * v.x
+				+ a[4] * v.y * v.y + 2.0 * a[5] * v.y * v.z + 2.0 * a[6] * v.y
+				+ a[7] * v.z * v.z + 2.0 * a[8] * v.z
+				+ a[9];
+			return result > 0.0 ? result : 0.0;
+		}
+	};
+
+	struct Candidate
+	{
+		double cost;
+		double length;			// breaks ties (flat regions cost nothing) towards short edges, which keeps valences low
+		uint32_t from;
+		uint32_t to;
+		uint32_t fromVersion;
+		uint32_t toVersion;
+
+		bool operator>(const Candidate& other) const
+		{
+			return cost > other.cost || (cost == other.cost && length > other.length);
+		}
+	};
+
+	std::vector<Vector> points;
+	std::vector<uint32_t> triangles;
+	std::vector<bool> triangleLive;
+	uint32_t liveTriangles = 0;
+	std::vector<std::vector<uint32_t>> vertexTriangles;
+	std::vector<bool> vertexLive;
+	std::vector<uint32_t> version;
+	std::vector<Quadric> quadrics;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+	double maxCost = 0.0;
+
+	static Vector subtract(const Vector& a, const Vector& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	static Vector cross(const Vector& a, const Vector& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	static double dot(const Vector& a, const Vector& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	static Vector normalize(const Vector& v)
+	{
+		double length = std::sqrt(dot(v, v));
+		return length > 0.0 ? Vector { v.x / length, v.y / length, v.z / length } : Vector { 0.0, 0.0, 0.0 };
+	}
+
+	Vector faceNormal(uint32_t a, uint32_t b, uint32_t c) const
+	{
+		return cross(subtract(points[b], points[a]), subtract(points[c], points[a]));
+	}
+
+	void buildQuadrics()
+	{
+		for (uint32_t t = 0; t < liveTriangles; t++)
+		{
+			const uint32_t* corner = &triangles[t * 3];
+			Vector normal = normalize(faceNormal(corner[0], corner[1], corner[2]));
+			double d = -dot(normal, points[corner[0]]);
+			for (int c = 0; c < 3; c++)
+			{
+				quadrics[corner[c]].addPlane(normal, d);
+			}
+
+			// open edges (no other triangle has them) get a plane through the edge, perpendicular to the face
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t a = corner[c], b = corner[(c + 1) % 3];
+				if (edgeTriangles(a, b) != 1)
+				{
+					continue;
+				}
+				Vector side = normalize(cross(subtract(points[b], points[a]), normal));
+				double sideD = -dot(side, points[a]);
+				quadrics[a].addPlane(side, sideD);
+				quadrics[b].addPlane(side, sideD);
+			}
+		}
+	}
+
+	int edgeTriangles(uint32_t a, uint32_t b) const
+	{
+		int count = 0;
+		for (uint32_t t : vertexTriangles[a])
+		{
+			const uint32_t* corner = &triangles[t * 3];
+			count += triangleLive[t] && (corner[0] == b || corner[1] == b || corner[2] == b) ? 1 : 0;
+		}
+		return count;
+	}
+
+	// queue the cheaper direction of collapsing edge (a, b)
+	void pushEdge(uint32_t a, uint32_t b)
+	{
+		Quadric combined = quadrics[a];
+		combined.add(quadrics[b]);
+		double toB = combined.evaluate(points[b]);
+		double toA = combined.evaluate(points[a]);
+		Vector edge = subtract(points[b], points[a]);
+		double length = dot(edge, edge);
+		if (toB <= toA)
+		{
+			candidates.push({ toB, length, a, b, version[a], version[b] });
+		}
+		else
+		{
+			candidates.push({ toA, length, b, a, version[b], version[a] });
+		}
+	}
+
+	void neighbours(uint32_t v, std::vector<uint32_t>& result) const
+	{
+		result.clear();
+		for (uint32_t t : vertexTriangles[v])
+		{
+			if (!triangleLive[t])
+			{
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t other = triangles[t * 3 + c];
+				if (other != v && std::find(result.begin(), result.end(), other) == result.end())
+				{
+					result.push_back(other);
+				}
+			}
+		}
+	}
+
+	bool collapsePreservesTopology(uint32_t from, uint32_t to) const
+	{
+		// link condition: every vertex next to both ends must be the third corner of a shared triangle
+		std::vector<uint32_t> fromRing, toRing;
+		neighbours(from, fromRing);
+		neighbours(to, toRing);
+		for (uint32_t v : fromRing)
+		{
+			if (v == to || std::find(toRing.begin(), toRing.end(), v) == toRing.end())
+			{
+				continue;
+			}
+			bool shared = false;
+			for (uint32_t t : vertexTriangles[from])
+			{
+				const uint32_t* corner = &triangles[t * 3];
+				bool hasTo = corner[0] == to || corner[1] == to || corner[2] == to;
+				bool hasV = corner[0] == v || corner[1] == v || corner[2] == v;
+				shared = shared || (triangleLive[t] && hasTo && hasV);
+			}
+			if (!shared)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool collapseFlips(uint32_t from, uint32_t to) const
+	{
+		for (uint32_t t : vertexTriangles[from])
+		{
+			const uint32_t* corner = &triangles[t * 3];
+			if (!triangleLive[t] || corner[0] == to || corner[1] == to || corner[2] == to)
+			{
+				continue;
+			}
+			uint32_t moved[3] = { corner[0], corner[1], corner[2] };
+			for (int c = 0; c < 3; c++)
+			{
+				moved[c] = moved[c] == from ? to : moved[c];
+			}
+			Vector before = faceNormal(corner[0], corner[1], corner[2]);
+			Vector after = faceNormal(moved[0], moved[1], moved[2]);
+			// flipped, or squashed down to (almost) nothing
+			if (dot(before, after) <= 1e-6 * dot(before, before))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void collapse(const Candidate& candidate)
+	{
+		uint32_t from = candidate.from, to = candidate.to;
+		if (!collapsePreservesTopology(from, to) || collapseFlips(from, to) || edgeTriangles(from, to) >= (int)liveTriangles)
+		{
+			return;
+		}
+
+		for (uint32_t t : vertexTriangles[from])
+		{
+			if (!triangleLive[t])
+			{
+				continue;
+			}
+			uint32_t* corner = &triangles[t * 3];
+			if (corner[0] == to || corner[1] == to || corner[2] == to)
+			{
+				triangleLive[t] = false;
+				liveTriangles--;
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				corner[c] = corner[c] == from ? to : corner[c];
+			}
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+		vertexLive[from] = false;
+		quadrics[to].add(quadrics[from]);
+		version[to]++;
+		maxCost = candidate.cost > maxCost ? candidate.cost : maxCost;
+
+		// the survivor inherits the moved triangles; drop the ones that just died so its list stays short
+		std::vector<uint32_t>& list = vertexTriangles[to];
+		list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return !triangleLive[t]; }), list.end());
+
+		std::vector<uint32_t> ring;
+		neighbours(to, ring);
+		for (uint32_t v : ring)
+		{
+			pushEdge(to, v);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <glad/glad.h>
+
+#include "mesh_file.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// procedural geometry, fed to bakeMesh
+// ------------------------------------
+
+// append one position-only vertex
+inline void addPosition(MeshBuild& build, float x, float y, float z)
+{
+	float position[3] = { x, y, z };
+	size_t offset = build.vertices.size();
+	build.vertices.resize(offset + sizeof(position));
+	memcpy(&build.vertices[offset], position, sizeof(position));
+}
+
+inline MeshBuild makePositionBuild()
+{
+	MeshBuild build;
+	build.vertexStride = 3 * sizeof(float);
+	build.attributes.push_back({ MESH_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0 });
+	return build;
+}
+
+// append one position + texture coordinate vertex
+inline void addPositionUv(MeshBuild& build, float x, float y, float z, float u, float v)
+{
+	float vertex[5] = { x, y, z, u, v };
+	size_t offset = build.vertices.size();
+	build.vertices.resize(offset + sizeof(vertex));
+	memcpy(&build.vertices[offset], vertex, sizeof(vertex));
+}
+
+inline MeshBuild makePositionUvBuild()
+{
+	MeshBuild build;
+	build.vertexStride = 5 * sizeof(float);
+	build.attributes.push_back({ MESH_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0 });
+	build.attributes.push_back({ MESH_UV_LOCATION, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float) });
+	return build;
+}
+
+// cells x cells quads spanning [-extent, extent] with the texture stretched over them; the triangles
+// are shuffled (deterministically) the way exporters that walk unordered face lists tend to leave
+// them, which is what the optimizer is for
+inline MeshBuild makeGrid(uint32_t cells, float extent, bool shuffle)
+{
+	MeshBuild build = makePositionUvBuild();
+	uint32_t side = cells + 1;
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			addPositionUv(build, -extent + 2.0f * extent * x / cells, -extent + 2.0f * extent * y / cells, 0.0f,
+				(float)x / cells, 1.0f - (float)y / cells);
+		}
+	}
+
+	for (uint32_t y = 0; y < cells; y++)
+	{
+		for (uint32_t x = 0; x < cells; x++)
+		{
+			uint32_t topLeft = y * side + x;
+			uint32_t topRight = topLeft + 1;
+			uint32_t bottomLeft = topLeft + side;
+			uint32_t bottomRight = bottomLeft + 1;
+			uint32_t quad[6] = { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight };
+			build.indices.insert(build.indices.end(), quad, quad + 6);
+		}
+	}
+
+	if (shuffle)
+	{
+		uint32_t state = 0x12345678u;
+		uint32_t triangles = (uint32_t)build.indices.size() / 3;
+		for (uint32_t t = triangles - 1; t > 0; t--)
+		{
+			state = state * 1664525u + 1013904223u;
+			uint32_t other = state % (t + 1);
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t swap = build.indices[t * 3 + c];
+				build.indices[t * 3 + c] = build.indices[other * 3 + c];
+				build.indices[other * 3 + c] = swap;
+			}
+		}
+	}
+	return build;
+}
+
+// regular polygon / disc of the given radius in the z = 0 plane: a center vertex fanned out to
+// segments rim vertices (3 -> triangle, 6 -> hexagon, 48 -> close enough to a circle)
+inline MeshBuild makeDisc(uint32_t segments, float radius)
+{
+	MeshBuild build = makePositionBuild();
+	addPosition(build, 0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < segments; i++)
+	{
+		float angle = 6.28318530718f * i / segments;
+		addPosition(build, radius * std::cos(angle), radius * std::sin(angle), 0.0f);
+	}
+	for (uint32_t i = 0; i < segments; i++)
+	{
+		uint32_t triangle[3] = { 0, 1 + i, 1 + (i + 1) % segments };
+		build.indices.insert(build.indices.end(), triangle, triangle + 3);
+	}
+	return build;
+}
+
+#endif
@@ -0,0 +1,527 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// frame profiler
+// --------------
+// GPU passes are timed with GL_TIME_ELAPSED queries kept in a ring QUERY_FRAMES deep: a frame's
+// queries are only read back when its slot comes around again, so the GPU has had QUERY_FRAMES - 1
+// whole frames to finish them and the readback never stalls. CPU scopes use std::chrono.
+class Profiler
+{
+public:
+	static const int MAX_PASSES = 8;
+	static const int MAX_SCOPES = 8;
+	static const int QUERY_FRAMES = 4;
+	static const int HISTORY = 1024;				// frames kept for the overlay and the CSV dump
+	static const int HISTOGRAM_BUCKETS = 34;		// 1 ms buckets, the last one collects everything >= 33 ms
+	static const int OVERLAY_FRAMES = 240;			// frames shown by the overlay timeline
+
+	struct FrameRecord
+	{
+		long long frame = -1;
+		float frameMs = 0.0f;
+		float cpuMs[MAX_SCOPES] = {};
+		float gpuMs[MAX_PASSES] = {};
+		bool gpuResolved = false;
+	};
+
+	// create the query ring and the overlay resources (needs a current GL context)
+	void init()
+	{
+		glGenQueries(QUERY_FRAMES * MAX_PASSES, &queries[0][0]);
+		initOverlay();
+		lastFrameStart = Clock::now();
+	}
+
+	void destroy()
+	{
+		glDeleteQueries(QUERY_FRAMES * MAX_PASSES, &queries[0][0]);
+		glState.deleteVertexArrays(1, &overlayVAO);
+		glState.deleteBuffers(1, &overlayVBO);
+		glState.deleteProgram(overlayProgram);
+	}
+
+	// register a named GPU pass or CPU scope, returns the id used to time it
+	int gpuPass(const char* name)
+	{
+		if (passCount == MAX_PASSES)
+		{
+			std::cout << "ERROR::PROFILER::TOO_MANY_GPU_PASSES" << std::endl;
+			return MAX_PASSES - 1;
+		}
+		passNames[passCount] = name;
+		return passCount++;
+	}
+
+	int cpuScope(const char* name)
+	{
+		if (scopeCount == MAX_SCOPES)
+		{
+			std::cout << "ERROR::PROFILER::TOO_MANY_CPU_SCOPES" << std::endl;
+			return MAX_SCOPES - 1;
+		}
+		scopeNames[scopeCount] = name;
+		return scopeCount++;
+	}
+
+	// call once at the top of every frame: closes the previous frame's record and
+	// resolves the queries of the frame that last used this ring slot
+	void beginFrame()
+	{
+		Clock::time_point now = Clock::now();
+		if (frameIndex >= 0)
+		{
+			FrameRecord& previous = record(frameIndex);
+			previous.frameMs = milliseconds(lastFrameStart, now);
+			accumulate(previous);
+		}
+		lastFrameStart = now;
+
+		frameIndex++;
+		int slot = (int)(frameIndex % QUERY_FRAMES);
+		resolve(slot);
+
+		FrameRecord& current = record(frameIndex);
+		current = FrameRecord();
+		current.frame = frameIndex;
+		for (int i = 0; i < MAX_PASSES; i++)
+		{
+			issued[slot][i] = false;
+		}
+	}
+
+	void beginGpu(int pass)
+	{
+		if (activePass != -1)
+		{
+			// GL_TIME_ELAPSED queries cannot nest
+			std::cout << "ERROR::PROFILER::GPU_PASS_ALREADY_ACTIVE " << passNames[activePass] << std::endl;
+			return;
+		}
+		int slot = (int)(frameIndex % QUERY_FRAMES);
+		glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass]);
+		issued[slot][pass] = true;
+		activePass = pass;
+	}
+
+	void endGpu()
+	{
+		if (activePass == -1)
+		{
+			return;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		activePass = -1;
+	}
+
+	void beginCpu(int scope)
+	{
+		scopeStart[scope] = Clock::now();
+	}
+
+	void endCpu(int scope)
+	{
+		record(frameIndex).cpuMs[scope] += milliseconds(scopeStart[scope], Clock::now());
+	}
+
+	// time spent on this frame elsewhere (another thread measured it and handed it over)
+	void addCpu(int scope, float ms)
+	{
+		record(frameIndex).cpuMs[scope] += ms;
+	}
+
+	// draw the frame time timeline and histogram into the lower left corner of the current framebuffer
+	void drawOverlay()
+	{
+		int vertexCount = buildOverlay();
+
+		GLenum polygonMode = glState.currentPolygonMode();
+		glState.polygonMode(GL_FILL);
+
+		glState.useProgram(overlayProgram);
+		glbuffers::subData(overlayVBO, 0, vertexCount * sizeof(OverlayVertex), overlayVertices);
+		glState.bindVertexArray(overlayVAO);
+		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+
+		glState.polygonMode(polygonMode);
+	}
+
+	// one line summary of the frames since the last call, averaged (meant for the window title)
+	bool summary(char* buffer, size_t size, double intervalSeconds)
+	{
+		if (milliseconds(lastSummary, Clock::now()) < intervalSeconds * 1000.0 || summaryFrames == 0)
+		{
+			return false;
+		}
+
+		int written = snprintf(buffer, size, "frame %.2f ms | cpu", summaryFrameMs / summaryFrames);
+		for (int i = 0; i < scopeCount && written < (int)size; i++)
+		{
+			written += snprintf(buffer + written, size - written, " %s %.2f", scopeNames[i], summaryCpuMs[i] / summaryFrames);
+		}
+		if (written < (int)size)
+		{
+			written += snprintf(buffer + written, size - written, " | gpu");
+		}
+		for (int i = 0; i < passCount && written < (int)size; i++)
+		{
+			written += snprintf(buffer + written, size - written, " %s %.3f", passNames[i], summaryGpuFrames ? summaryGpuMs[i] / summaryGpuFrames : 0.0f);
+		}
+
+		summaryFrames = 0;
+		summaryGpuFrames = 0;
+		summaryFrameMs = 0.0f;
+		for (int i = 0; i < MAX_SCOPES; i++)
+		{
+			summaryCpuMs[i] = 0.0f;
+		}
+		for (int i = 0; i < MAX_PASSES; i++)
+		{
+			summaryGpuMs[i] = 0.0f;
+		}
+		lastSummary = Clock::now();
+		return true;
+	}
+
+	// dump the frame history (one row per frame) and the frame time histogram as CSV
+	bool writeCsv(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			std::cout << "ERROR::PROFILER::CSV_OPEN_FAILED " << path << std::endl;
+			return false;
+		}
+
+		file << "frame,frame_ms";
+		for (int i = 0; i < scopeCount; i++)
+		{
+			file << ",cpu_" << scopeNames[i] << "_ms";
+		}
+		for (int i = 0; i < passCount; i++)
+		{
+			file << ",gpu_" << passNames[i] << "_ms";
+		}
+		file << "\n";
+
+		// the current frame is still open, everything before it is complete
+		long long first = frameIndex - HISTORY + 1 > 0 ? frameIndex - HISTORY + 1 : 0;
+		for (long long frame = first; frame < frameIndex; frame++)
+		{
+			const FrameRecord& row = history[frame % HISTORY];
+			file << row.frame << "," << row.frameMs;
+			for (int i = 0; i < scopeCount; i++)
+			{
+				file << "," << row.cpuMs[i];
+			}
+			for (int i = 0; i < passCount; i++)
+			{
+				file << ",";
+				if (row.gpuResolved)
+				{
+					file << row.gpuMs[i];
+				}
+			}
+			file << "\n";
+		}
+
+		std::ofstream histogramFile(path.substr(0, path.find_last_of('.')) + "_histogram.csv");
+		histogramFile << "bucket_ms,frames\n";
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			histogramFile << i << (i == HISTOGRAM_BUCKETS - 1 ? "+" : "") << "," << histogram[i] << "\n";
+		}
+
+		std::cout << "PROFILER::CSV_WRITTEN " << path << std::endl;
+		return true;
+	}
+
+	const FrameRecord& lastResolved() const
+	{
+		return history[(resolvedFrame < 0 ? 0 : resolvedFrame) % HISTORY];
+	}
+
+	// summed GPU time of the newest frame whose queries came back, -1 if none has yet
+	float lastGpuFrameMs() const
+	{
+		if (resolvedFrame < 0)
+		{
+			return -1.0f;
+		}
+		const FrameRecord& row = lastResolved();
+		float total = 0.0f;
+		for (int i = 0; i < passCount; i++)
+		{
+			total += row.gpuMs[i];
+		}
+		return total;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct OverlayVertex
+	{
+		float x, y;
+		float r, g, b, a;
+	};
+
+	static const int OVERLAY_MAX_VERTICES = (OVERLAY_FRAMES + HISTOGRAM_BUCKETS + 3) * 6;
+
+	unsigned int queries[QUERY_FRAMES][MAX_PASSES] = {};
+	bool issued[QUERY_FRAMES][MAX_PASSES] = {};
+	const char* passNames[MAX_PASSES] = {};
+	const char* scopeNames[MAX_SCOPES] = {};
+	int passCount = 0;
+	int scopeCount = 0;
+	int activePass = -1;
+
+	long long frameIndex = -1;
+	long long resolvedFrame = -1;
+	Clock::time_point lastFrameStart;
+	Clock::time_point scopeStart[MAX_SCOPES];
+
+	FrameRecord history[HISTORY];
+	unsigned int histogram[HISTOGRAM_BUCKETS] = {};
+
+	Clock::time_point lastSummary;
+	int summaryFrames = 0;
+	int summaryGpuFrames = 0;
+	float summaryFrameMs = 0.0f;
+	float summaryCpuMs[MAX_SCOPES] = {};
+	float summaryGpuMs[MAX_PASSES] = {};
+
+	unsigned int overlayProgram = 0;
+	unsigned int overlayVAO = 0;
+	unsigned int overlayVBO = 0;
+	OverlayVertex overlayVertices[OVERLAY_MAX_VERTICES];
+
+	static float milliseconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<float, std::milli>(to - from).count();
+	}
+
+	FrameRecord& record(long long frame)
+	{
+		return history[frame % HISTORY];
+	}
+
+	void accumulate(const FrameRecord& row)
+	{
+		int bucket = (int)row.frameMs;
+		histogram[bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1]++;
+
+		summaryFrames++;
+		summaryFrameMs += row.frameMs;
+		for (int i = 0; i < scopeCount; i++)
+		{
+			summaryCpuMs[i] += row.cpuMs[i];
+		}
+	}
+
+	// read back the queries the frame QUERY_FRAMES ago issued into this slot; if the GPU is
+	// still not done with them we drop that frame's GPU timings instead of waiting
+	void resolve(int slot)
+	{
+		long long frame = frameIndex - QUERY_FRAMES;
+		if (frame < 0)
+		{
+			return;
+		}
+
+		FrameRecord& row = record(frame);
+		for (int i = 0; i < passCount; i++)
+		{
+			if (!issued[slot][i])
+			{
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				return;
+			}
+		}
+
+		for (int i = 0; i < passCount; i++)
+		{
+			GLuint64 elapsed = 0;
+			if (issued[slot][i])
+			{
+				glGetQueryObjectui64v(queries[slot][i], GL_QUERY_RESULT, &elapsed);
+			}
+			row.gpuMs[i] = (float)(elapsed / 1000000.0);
+			summaryGpuMs[i] += row.gpuMs[i];
+		}
+		row.gpuResolved = true;
+		resolvedFrame = frame;
+		summaryGpuFrames++;
+	}
+
+	void initOverlay()
+	{
+		const char* vertexSource =
+			"#version 330 core\n"
+			"layout (location = 0) in vec2 aPos;\n"
+			"layout (location = 1) in vec4 aColor;\n"
+			"out vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	color = aColor;\n"
+			"	gl_Position = vec4(aPos, 0.0, 1.0);\n"
+			"}\0";
+		const char* fragmentSource =
+			"#version 330 core\n"
+			"in vec4 color;\n"
+			"out vec4 FragColor;\n"
+			"void main()\n"
+			"{\n"
+			"	FragColor = color;\n"
+			"}\0";
+
+		unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &vertexSource, NULL);
+		glCompileShader(vertexShader);
+		unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+		glCompileShader(fragmentShader);
+
+		overlayProgram = glCreateProgram();
+		glAttachShader(overlayProgram, vertexShader);
+		glAttachShader(overlayProgram, fragmentShader);
+		glLinkProgram(overlayProgram);
+
+		int success;
+		glGetProgramiv(overlayProgram, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[512];
+			glGetProgramInfoLog(overlayProgram, 512, NULL, infoLog);
+			std::cout << "ERROR::PROFILER::OVERLAY::LINKING::FAILED\n" << infoLog << std::endl;
+		}
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		overlayVAO = glbuffers::createVertexArray();
+		overlayVBO = glbuffers::createBuffer();
+		glbuffers::data(overlayVBO, sizeof(overlayVertices), NULL, GL_DYNAMIC_DRAW);
+		glbuffers::attribute(overlayVAO, 0, overlayVBO, 2, GL_FLOAT, false, sizeof(OverlayVertex), 0);
+		glbuffers::attribute(overlayVAO, 1, overlayVBO, 4, GL_FLOAT, false, sizeof(OverlayVertex), 2 * sizeof(float));
+		glState.bindVertexArray(0);
+	}
+
+	int addQuad(int count, float x0, float y0, float x1, float y1, float r, float g, float b, float a)
+	{
+		OverlayVertex* v = overlayVertices + count;
+		v[0] = { x0, y0, r, g, b, a };
+		v[1] = { x1, y0, r, g, b, a };
+		v[2] = { x1, y1, r, g, b, a };
+		v[3] = { x0, y0, r, g, b, a };
+		v[4] = { x1, y1, r, g, b, a };
+		v[5] = { x0, y1, r, g, b, a };
+		return count + 6;
+	}
+
+	// timeline: one bar per frame scaled so 33.3 ms fills the graph, green under 16.7 ms, yellow
+	// under 33.3 ms, red above; histogram: bucket heights relative to the fullest bucket
+	int buildOverlay()
+	{
+		const float left = -0.98f, bottom = -0.98f;
+		const float width = 0.9f, height = 0.3f;
+		int count = 0;
+
+		count = addQuad(count, left, bottom, left + width, bottom + height, 0.0f, 0.0f, 0.0f, 1.0f);
+		count = addQuad(count, left, bottom + height * 0.5f, left + width, bottom + height * 0.5f + 0.003f, 0.3f, 0.3f, 0.3f, 1.0f);
+
+		float barWidth = width / OVERLAY_FRAMES;
+		for (int i = 0; i < OVERLAY_FRAMES; i++)
+		{
+			long long frame = frameIndex - OVERLAY_FRAMES + i;
+			if (frame < 0)
+			{
+				continue;
+			}
+			float ms = history[frame % HISTORY].frameMs;
+			float h = height * (ms > 33.3f ? 1.0f : ms / 33.3f);
+			float r = ms > 16.7f ? 1.0f : 0.0f;
+			float g = ms > 33.3f ? 0.0f : 1.0f;
+			float x = left + i * barWidth;
+			count = addQuad(count, x, bottom, x + barWidth * 0.8f, bottom + h, r, g, 0.0f, 1.0f);
+		}
+
+		const float histogramLeft = left + width + 0.02f;
+		const float histogramWidth = 0.5f;
+		count = addQuad(count, histogramLeft, bottom, histogramLeft + histogramWidth, bottom + height, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		unsigned int fullest = 1;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			fullest = histogram[i] > fullest ? histogram[i] : fullest;
+		}
+
+		float bucketWidth = histogramWidth / HISTOGRAM_BUCKETS;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			float h = height * histogram[i] / fullest;
+			float x = histogramLeft + i * bucketWidth;
+			count = addQuad(count, x, bottom, x + bucketWidth * 0.8f, bottom + h, 0.2f, 0.5f, 1.0f, 1.0f);
+		}
+		return count;
+	}
+};
+
+// min / average / percentiles of a run of frame times (nearest rank), for benchmark output
+struct FrameTimeStats
+{
+	size_t count = 0;
+	float minMs = 0.0f;
+	float avgMs = 0.0f;
+	float p50Ms = 0.0f;
+	float p99Ms = 0.0f;
+	float maxMs = 0.0f;
+};
+
+// sorts samples in place
+inline FrameTimeStats summarizeFrameTimes(std::vector<float>& samples)
+{
+	FrameTimeStats stats;
+	if (samples.empty())
+	{
+		return stats;
+	}
+	std::sort(samples.begin(), samples.end());
+	double total = 0.0;
+	for (float ms : samples)
+	{
+		total += ms;
+	}
+	auto percentile = [&](double fraction)
+	{
+		size_t rank = (size_t)std::ceil(fraction * samples.size());
+		return samples[rank > 0 ? rank - 1 : 0];
+	};
+	stats.count = samples.size();
+	stats.minMs = samples.front();
+	stats.avgMs = (float)(total / samples.size());
+	stats.p50Ms = percentile(0.50);
+	stats.p99Ms = percentile(0.99);
+	stats.maxMs = samples.back();
+	return stats;
+}
+
+#endif
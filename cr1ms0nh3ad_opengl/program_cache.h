@@ -0,0 +1,270 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "shader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// persistent shader program binary cache
+// --------------------------------------
+// Linked programs are written to disk with glGetProgramBinary and restored with glProgramBinary on
+// the next launch, skipping the compiler entirely. Entries are keyed by a hash of the sources, the
+// defines and the driver's vendor/renderer/version strings, so a driver update simply misses. A
+// binary the driver refuses (glProgramBinary leaves the program unlinked) is deleted and the program
+// is rebuilt from source.
+class ProgramCache
+{
+public:
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	unsigned int rejected = 0;
+
+	// needs a current context with glext::load() done
+	void init(const std::string& cacheDirectory)
+	{
+		directory = cacheDirectory;
+
+		GLint formats = 0;
+		if (glext::programBinary)
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		}
+		enabled = formats > 0;
+
+		if (enabled)
+		{
+			std::error_code error;
+			std::filesystem::create_directories(directory, error);
+			if (error)
+			{
+				std::cout << "ERROR::PROGRAM_CACHE::DIRECTORY_FAILED " << directory << std::endl;
+				enabled = false;
+			}
+		}
+
+		// the driver identity goes into every key: binaries are only valid for the exact driver that made them
+		driverSeed = FNV_OFFSET;
+		driverSeed = hash(driverSeed, (const char*)glGetString(GL_VENDOR));
+		driverSeed = hash(driverSeed, (const char*)glGetString(GL_RENDERER));
+		driverSeed = hash(driverSeed, (const char*)glGetString(GL_VERSION));
+
+		if (!enabled)
+		{
+			std::cout << "PROGRAM_CACHE::DISABLED (no program binary formats)" << std::endl;
+		}
+	}
+
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	uint64_t key(const char* vertexSource, const char* fragmentSource, const std::string& defines) const
+	{
+		uint64_t h = driverSeed;
+		h = hash(h, vertexSource);
+		h = hash(h, fragmentSource);
+		h = hash(h, defines.c_str());
+		return h;
+	}
+
+	// mark a program (before glLinkProgram) so its binary can be fetched for store()
+	void prepare(unsigned int program) const
+	{
+		if (enabled)
+		{
+			glext::ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	// try to restore a program from disk, true when it is linked and ready to use
+	bool load(uint64_t key, unsigned int program)
+	{
+		if (!enabled)
+		{
+			return false;
+		}
+
+		std::ifstream file(path(key), std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		FileHeader header;
+		file.read((char*)&header, sizeof(header));
+		bool valid = file && header.magic == MAGIC && header.version == VERSION && header.key == key && header.length > 0;
+
+		std::vector<char> binary;
+		if (valid)
+		{
+			binary.resize(header.length);
+			file.read(binary.data(), header.length);
+			valid = file && hashBytes(binary.data(), binary.size()) == header.checksum;
+		}
+		file.close();
+
+		if (valid)
+		{
+			glext::ProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+			int success;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			valid = success != 0;
+		}
+
+		if (!valid)
+		{
+			rejected++;
+			std::error_code error;
+			std::filesystem::remove(path(key), error);
+			return false;
+		}
+		hits++;
+		return true;
+	}
+
+	// write a linked program's binary to disk (written to a temporary file first so a crash never leaves half an entry)
+	void store(uint64_t key, unsigned int program) const
+	{
+		if (!enabled)
+		{
+			return;
+		}
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return;
+		}
+
+		std::vector<char> binary(length);
+		FileHeader header;
+		glext::GetProgramBinary(program, length, NULL, &header.format, binary.data());
+		header.key = key;
+		header.length = (uint32_t)length;
+		header.checksum = hashBytes(binary.data(), binary.size());
+
+		std::string target = path(key);
+		std::string temporary = target + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write(binary.data(), binary.size());
+			if (!file)
+			{
+				std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << temporary << std::endl;
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, target, error);
+	}
+
+	// the synchronous path: restore from the cache, or compile + link from source and store the result
+	// returns 0 when the sources do not compile or link (the info log is printed)
+	unsigned int build(const char* vertexSource, const char* fragmentSource, const std::string& defines = "")
+	{
+		uint64_t programKey = key(vertexSource, fragmentSource, defines);
+
+		unsigned int program = glCreateProgram();
+		if (load(programKey, program))
+		{
+			return program;
+		}
+		glState.deleteProgram(program);
+		misses++;
+
+		unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, injectDefines(vertexSource, defines));
+		unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, injectDefines(fragmentSource, defines));
+		if (vertexShader == 0 || fragmentShader == 0)
+		{
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return 0;
+		}
+
+		program = glCreateProgram();
+		prepare(program);
+		glAttachShader(program, vertexShader);
+		glAttachShader(program, fragmentShader);
+		glLinkProgram(program);
+
+		// once linked into the program object the shader objects are not needed anymore
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		if (!checkLinkStatus(program))
+		{
+			glState.deleteProgram(program);
+			return 0;
+		}
+		store(programKey, program);
+		return program;
+	}
+
+private:
+	static const uint32_t MAGIC = 0x42505243;	// "CRPB"
+	static const uint32_t VERSION = 1;
+	static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+	static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+	struct FileHeader
+	{
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint64_t key = 0;
+		GLenum format = 0;
+		uint32_t length = 0;
+		uint64_t checksum = 0;
+	};
+
+	std::string directory;
+	bool enabled = false;
+	uint64_t driverSeed = FNV_OFFSET;
+
+	// FNV-1a, strings are hashed with their terminator so "ab" + "c" and "a" + "bc" differ
+	static uint64_t hash(uint64_t h, const char* text)
+	{
+		if (text == NULL)
+		{
+			text = "";
+		}
+		do
+		{
+			h ^= (unsigned char)*text;
+			h *= FNV_PRIME;
+		} while (*text++);
+		return h;
+	}
+
+	static uint64_t hashBytes(const char* data, size_t size)
+	{
+		uint64_t h = FNV_OFFSET;
+		for (size_t i = 0; i < size; i++)
+		{
+			h ^= (unsigned char)data[i];
+			h *= FNV_PRIME;
+		}
+		return h;
+	}
+
+	std::string path(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return (std::filesystem::path(directory) / name).string();
+	}
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 64 bit draw sort key
+// --------------------
+// | pass 4 | program 12 | material 16 | depth 32 |, most significant first, so sorting by key
+// groups draws by pass, then by program, then by material (texture set), and orders by depth last.
+// Only the low bits of the program and material names are kept: a collision costs a state switch,
+// never a wrong draw. Depth is [0, 1]; backToFront flips it for blended passes.
+inline uint64_t makeSortKey(unsigned int pass, unsigned int program, unsigned int material, float depth, bool backToFront = false)
+{
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	uint32_t depthBits = (uint32_t)(depth * 4294967295.0);
+	if (backToFront)
+	{
+		depthBits = ~depthBits;
+	}
+	return ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(program & 0xFFF) << 48) | ((uint64_t)(material & 0xFFFF) << 32) | depthBits;
+}
+
+// one queued draw: the state it needs plus either an indexed draw or a callback that issues its
+// own (instanced / multi-draw) calls once that state is bound
+// --------------------------------------------------------------------------------------------
+struct DrawItem
+{
+	typedef void (*Callback)(void* user);
+
+	unsigned int program = 0;
+	unsigned int vertexArray = 0;		// 0: left to the callback
+	unsigned int texture = 0;			// bound to unit 0 as GL_TEXTURE_2D when non-zero
+	GLenum mode = GL_TRIANGLES;
+	GLenum indexType = GL_UNSIGNED_INT;
+	uint32_t indexCount = 0;
+	size_t indexOffset = 0;				// bytes into the element buffer
+	uint32_t instanceCount = 1;
+	Callback callback = NULL;
+	void* user = NULL;
+};
+
+// sorted render queue
+// -------------------
+// Any thread may push() during a frame: a slot is claimed with one atomic increment into
+// fixed-capacity arrays, nothing is locked. On the GL thread submit() radix sorts the keys and
+// issues everything in key order through glState, so program and VAO changes only happen at the
+// boundaries between groups. begin() (GL thread, no pushes in flight) starts the next frame.
+class RenderQueue
+{
+public:
+	struct Stats
+	{
+		unsigned int draws = 0;
+		unsigned int dropped = 0;			// pushes past capacity
+		unsigned int programSwitches = 0;
+		unsigned int vertexArraySwitches = 0;
+		unsigned int textureSwitches = 0;
+	};
+
+	void init(uint32_t maxItems)
+	{
+		capacity = maxItems;
+		items.resize(maxItems);
+		keys.resize(maxItems);
+		scratch.resize(maxItems);
+	}
+
+	void begin()
+	{
+		count.store(0, std::memory_order_relaxed);
+		dropped.store(0, std::memory_order_relaxed);
+	}
+
+	// thread safe; returns false when the queue is full and the draw was dropped
+	bool push(uint64_t key, const DrawItem& item)
+	{
+		uint32_t slot = count.fetch_add(1, std::memory_order_relaxed);
+		if (slot >= capacity)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		items[slot] = item;
+		keys[slot] = { key, slot };
+		return true;
+	}
+
+	// sort and draw everything pushed since begin()
+	void submit()
+	{
+		uint32_t size = count.load(std::memory_order_acquire);
+		size = size < capacity ? size : capacity;
+		sort(size);
+
+		Stats frame;
+		frame.draws = size;
+		frame.dropped = dropped.load(std::memory_order_relaxed);
+		unsigned int program = GLStateCache::UNKNOWN, vertexArray = GLStateCache::UNKNOWN, texture = 0;
+		for (uint32_t i = 0; i < size; i++)
+		{
+			const DrawItem& item = items[keys[i].index];
+			if (item.program != program)
+			{
+				frame.programSwitches++;
+				program = item.program;
+				glState.useProgram(program);
+			}
+			if (item.vertexArray != 0 && item.vertexArray != vertexArray)
+			{
+				frame.vertexArraySwitches++;
+				vertexArray = item.vertexArray;
+				glState.bindVertexArray(vertexArray);
+			}
+			if (item.texture != 0 && item.texture != texture)
+			{
+				frame.textureSwitches++;
+				texture = item.texture;
+				glState.bindTexture(0, GL_TEXTURE_2D, texture);
+			}
+
+			if (item.callback != NULL)
+			{
+				// the callback may bind whatever it likes; don't trust our view of it afterwards
+				item.callback(item.user);
+				program = vertexArray = GLStateCache::UNKNOWN;
+				texture = 0;
+			}
+			else if (item.instanceCount == 1)
+			{
+				glDrawElements(item.mode, item.indexCount, item.indexType, (void*)item.indexOffset);
+			}
+			else
+			{
+				glDrawElementsInstanced(item.mode, item.indexCount, item.indexType, (void*)item.indexOffset, item.instanceCount);
+			}
+		}
+		last = frame;
+	}
+
+	const Stats& stats() const
+	{
+		return last;
+	}
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	uint32_t capacity = 0;
+	std::atomic<uint32_t> count { 0 };
+	std::atomic<uint32_t> dropped { 0 };
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> keys;
+	std::vector<SortEntry> scratch;
+	Stats last;
+
+	// LSD radix sort, 8 bits per pass; passes where every key has the same byte are skipped, which
+	// for typical keys (few passes/programs/materials) is most of them. Stable, so equal keys keep
+	// submission order.
+	void sort(uint32_t size)
+	{
+		if (size < 2)
+		{
+			return;
+		}
+		SortEntry* source = keys.data();
+		SortEntry* destination = scratch.data();
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			uint32_t histogram[256] = {};
+			for (uint32_t i = 0; i < size; i++)
+			{
+				histogram[(source[i].key >> shift) & 0xFF]++;
+			}
+			if (histogram[(source[0].key >> shift) & 0xFF] == size)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (int b = 0; b < 256; b++)
+			{
+				uint32_t bucket = histogram[b];
+				histogram[b] = offset;
+				offset += bucket;
+			}
+			for (uint32_t i = 0; i < size; i++)
+			{
+				destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+			}
+			SortEntry* swap = source;
+			source = destination;
+			destination = swap;
+		}
+		if (source != keys.data())
+		{
+			memcpy(keys.data(), source, size * sizeof(SortEntry));
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef RENDER_SCALE_H
+#define RENDER_SCALE_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "render_target.h"
+
+#include <cmath>
+
+// how the scene gets from its render resolution to the output's
+enum UpscaleFilter
+{
+	UPSCALE_BILINEAR,
+	UPSCALE_SHARPEN,		// bilinear plus a contrast-limited sharpen
+	UPSCALE_FILTER_COUNT
+};
+
+inline const char* upscaleFilterName(UpscaleFilter filter)
+{
+	static const char* names[UPSCALE_FILTER_COUNT] = { "bilinear", "sharpen" };
+	return filter < UPSCALE_FILTER_COUNT ? names[filter] : "?";
+}
+
+// dynamic resolution controller
+// -----------------------------
+// Picks the render scale (per axis, of the output size) that holds the frame's GPU time at the
+// target. Fill cost goes with the pixel count, i.e. the square of the scale, so the scale moves by
+// the square root of target / measured. It only ever moves in STEP increments and settles in a band
+// below the target, so a steady load keeps one size (the target and the culler's depth pyramid are
+// reallocated when it changes); it drops as far as needed at once but climbs one step at a time.
+// GPU times arrive a few frames late, so after every change it ignores COOLDOWN_FRAMES of
+// measurements that were still taken at the old size.
+class ResolutionController
+{
+public:
+	static constexpr float STEP = 1.0f / 16.0f;
+	static const int COOLDOWN_FRAMES = 8;
+
+	void init(float frameTargetMs, float lowestScale, float highestScale = 1.0f)
+	{
+		targetMs = frameTargetMs;
+		minScale = lowestScale;
+		maxScale = highestScale;
+		current = highestScale;
+		smoothedMs = -1.0f;
+		cooldown = 0;
+	}
+
+	// feed the GPU time of the newest frame measured (negative: none yet); the scale to render at
+	float update(float gpuMs)
+	{
+		if (gpuMs < 0.0f)
+		{
+			return current;
+		}
+		if (cooldown > 0)
+		{
+			cooldown--;
+			return current;
+		}
+		smoothedMs = smoothedMs < 0.0f ? gpuMs : smoothedMs + (gpuMs - smoothedMs) * 0.25f;
+
+		float next = current;
+		if (smoothedMs > targetMs)
+		{
+			float wanted = current * sqrtf(targetMs / smoothedMs);
+			next = floorf(wanted / STEP) * STEP;
+		}
+		else if (smoothedMs < targetMs * HEADROOM)
+		{
+			next = current + STEP;
+		}
+		next = next < minScale ? minScale : next > maxScale ? maxScale : next;
+		if (next != current)
+		{
+			current = next;
+			smoothedMs = -1.0f;
+			cooldown = COOLDOWN_FRAMES;
+		}
+		return current;
+	}
+
+	float scale() const
+	{
+		return current;
+	}
+
+private:
+	static constexpr float HEADROOM = 0.8f;		// climb only while this far under the target
+
+	float targetMs = 16.0f;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float current = 1.0f;
+	float smoothedMs = -1.0f;
+	int cooldown = 0;
+};
+
+// scaled scene target and the upscale pass
+// ----------------------------------------
+// The scene draws into the lower left renderWidth x renderHeight of an offscreen target as big as
+// the output, so a new scale is only a viewport change; the target is reallocated when the output
+// size changes. draw() then covers the output with a fullscreen triangle sampling that corner:
+// bilinear, or (UPSCALE_SHARPEN) with an unsharp mask over the four neighbouring source texels,
+// clamped to their range so edges don't ring. The program comes from shaders/upscale.vert / .frag.
+// GL thread only.
+class Upscaler
+{
+public:
+	// the scene target for an output of this size (false: it couldn't be created, render natively)
+	bool prepare(int outputWidth, int outputHeight)
+	{
+		if (broken)
+		{
+			return false;
+		}
+		if (!target || target.width() != outputWidth || target.height() != outputHeight)
+		{
+			if (!emptyVAO)
+			{
+				emptyVAO.create(GPU_CATEGORY_OTHER);
+			}
+			broken = !target.init(outputWidth, outputHeight);
+		}
+		return !broken;
+	}
+
+	void destroy()
+	{
+		target.destroy();
+		emptyVAO.reset();
+	}
+
+	const RenderTarget& sceneTarget() const
+	{
+		return target;
+	}
+
+	// sample the scene's renderWidth x renderHeight into outputFramebuffer's whole viewport
+	void draw(unsigned int program, unsigned int outputFramebuffer, int renderWidth, int renderHeight, float sharpness)
+	{
+		if (program != locationProgram)
+		{
+			locationProgram = program;
+			scaleLocation = glGetUniformLocation(program, "uScale");
+			texelLocation = glGetUniformLocation(program, "uTexel");
+			sharpnessLocation = glGetUniformLocation(program, "uSharpness");
+		}
+		GLenum polygonMode = glState.currentPolygonMode();
+		glState.polygonMode(GL_FILL);
+		glState.setEnabled(GL_DEPTH_TEST, false);
+		glState.setEnabled(GL_BLEND, false);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+		glState.useProgram(program);
+		glState.bindVertexArray(emptyVAO.get());
+		glState.bindTexture(0, GL_TEXTURE_2D, target.colorTexture());
+		glUniform2f(scaleLocation, (float)renderWidth / target.width(), (float)renderHeight / target.height());
+		glUniform2f(texelLocation, 1.0f / target.width(), 1.0f / target.height());
+		glUniform1f(sharpnessLocation, sharpness);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		glState.polygonMode(polygonMode);
+	}
+
+private:
+	RenderTarget target;
+	GpuVertexArray emptyVAO;		// core profile draws need a VAO, even one without attributes
+	bool broken = false;
+	unsigned int locationProgram = 0;
+	int scaleLocation = -1;
+	int texelLocation = -1;
+	int sharpnessLocation = -1;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+#include <iostream>
+
+// offscreen render target
+// -----------------------
+// One framebuffer with an RGBA8 color and a DEPTH24_STENCIL8 depth texture: the formats the window
+// gets, so whatever copies depth out of the scene (the culler's depth pyramid) works the same on
+// both. init() again with another size to resize; the old textures are retired like any GpuObject,
+// so frames still reading them are unaffected. The viewport is the caller's, as for the window.
+// GL thread only.
+class RenderTarget
+{
+public:
+	bool init(int targetWidth, int targetHeight)
+	{
+		destroy();
+		color.create(GPU_CATEGORY_OTHER, (size_t)targetWidth * targetHeight * 4);
+		createTexture(color.get(), GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, targetWidth, targetHeight);
+		depth.create(GPU_CATEGORY_OTHER, (size_t)targetWidth * targetHeight * 4);
+		createTexture(depth.get(), GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, targetWidth, targetHeight);
+
+		target.create(GPU_CATEGORY_OTHER);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.get());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.get(), 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth.get(), 0);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::RENDER_TARGET::INCOMPLETE (status 0x" << std::hex << status << std::dec << ", "
+				<< targetWidth << "x" << targetHeight << ")" << std::endl;
+			destroy();
+			return false;
+		}
+		widthPixels = targetWidth;
+		heightPixels = targetHeight;
+		return true;
+	}
+
+	void destroy()
+	{
+		target.reset();
+		color.reset();
+		depth.reset();
+		widthPixels = heightPixels = 0;
+	}
+
+	// draws from here on land in the target
+	void bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, target.get());
+	}
+
+	unsigned int framebuffer() const
+	{
+		return target.get();
+	}
+
+	unsigned int colorTexture() const
+	{
+		return color.get();
+	}
+
+	unsigned int depthTexture() const
+	{
+		return depth.get();
+	}
+
+	int width() const
+	{
+		return widthPixels;
+	}
+
+	int height() const
+	{
+		return heightPixels;
+	}
+
+	explicit operator bool() const
+	{
+		return (bool)target;
+	}
+
+private:
+	GpuFramebuffer target;
+	GpuTexture color;
+	GpuTexture depth;
+	int widthPixels = 0;
+	int heightPixels = 0;
+
+	static void createTexture(unsigned int texture, GLint internalFormat, GLenum format, GLenum type, int textureWidth, int textureHeight)
+	{
+		glState.bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, textureWidth, textureHeight, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glState.bindTexture(0, GL_TEXTURE_2D, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <glfw3.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// render thread
+// -------------
+// Owns the window's GL context and runs render(slot) for every submitted frame slot. There are
+// SLOTS slots, so the main thread records frame N + 1 while frame N is still being replayed and
+// presented; acquire() only blocks once the main thread gets a whole frame ahead. Without a thread
+// (start(..., false)) submit() renders inline, which keeps a single threaded build of the same loop.
+class RenderThread
+{
+public:
+	static const int SLOTS = 2;
+	typedef std::function<void(int slot)> RenderFunction;
+
+	// the context moves to the render thread; call from the thread that has it current
+	void start(GLFWwindow* targetWindow, bool threaded, RenderFunction renderFunction)
+	{
+		window = targetWindow;
+		render = renderFunction;
+		running = threaded;
+		if (running)
+		{
+			glfwMakeContextCurrent(NULL);
+			thread = std::thread([this] { loop(); });
+		}
+	}
+
+	// hand the context back to the calling thread once everything submitted has been rendered
+	void stop()
+	{
+		if (!running)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		changed.notify_all();
+		thread.join();
+		running = false;
+		glfwMakeContextCurrent(window);
+	}
+
+	bool isThreaded() const
+	{
+		return running;
+	}
+
+	// the next slot to record into, waiting until the render thread is done with it
+	int acquire()
+	{
+		int slot = nextRecord;
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return !submitted[slot]; });
+		return slot;
+	}
+
+	void submit(int slot)
+	{
+		nextRecord = (slot + 1) % SLOTS;
+		if (!running)
+		{
+			render(slot);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			submitted[slot] = true;
+		}
+		changed.notify_all();
+	}
+
+private:
+	GLFWwindow* window = NULL;
+	RenderFunction render;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool submitted[SLOTS] = {};
+	bool running = false;
+	bool quit = false;
+	int nextRecord = 0;
+
+	void loop()
+	{
+		glfwMakeContextCurrent(window);
+		int slot = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return quit || submitted[slot]; });
+				if (!submitted[slot])
+				{
+					break;
+				}
+			}
+
+			render(slot);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				submitted[slot] = false;
+			}
+			changed.notify_all();
+			slot = (slot + 1) % SLOTS;
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+};
+
+#endif
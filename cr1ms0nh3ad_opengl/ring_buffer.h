@@ -0,0 +1,170 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+#include <cstddef>
+#include <iostream>
+
+// per-frame streaming ring buffer
+// -------------------------------
+// One buffer split into REGIONS equal parts, one per frame in flight. Each frame gets the next
+// region, allocates from it with a bump pointer and writes straight into mapped memory; endFrame()
+// drops a fence behind the frame's GL commands and beginFrame() only reuses a region once its
+// fence has signalled, so the CPU never overwrites data the GPU is still reading and the driver
+// never has to synchronise implicitly. Any binding point works (vertex, uniform, storage, indirect)
+// since allocations are just (buffer, offset) ranges.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistent and coherent, for its
+// whole life. Without it each region is mapped GL_MAP_UNSYNCHRONIZED_BIT at beginFrame() (safe: its
+// fence has already been waited on) and unmapped at commit(); allocations therefore have to happen
+// before commit(), i.e. write all of the frame's dynamic data first, then issue the draws.
+class FrameRingBuffer
+{
+public:
+	static const int REGIONS = 3;
+
+	struct Allocation
+	{
+		unsigned char* data = NULL;
+		size_t offset = 0;			// byte offset into buffer()
+		size_t size = 0;
+	};
+
+	// frames that had to wait for the GPU before their region could be reused, and the largest region use seen
+	unsigned int stalls = 0;
+	size_t highWater = 0;
+
+	bool init(size_t bytesPerRegion)
+	{
+		regionSize = (bytesPerRegion + 255) & ~(size_t)255;
+		persistent = glext::bufferStorage;
+
+		ring.create(GPU_CATEGORY_STREAMING, regionSize * REGIONS);
+		if (persistent)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glbuffers::storage(ring.get(), regionSize * REGIONS, NULL, flags);
+			mapped = (unsigned char*)glbuffers::mapRange(ring.get(), 0, regionSize * REGIONS, flags);
+			if (mapped == NULL)
+			{
+				std::cout << "ERROR::RING_BUFFER::MAP_FAILED" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			glbuffers::data(ring.get(), regionSize * REGIONS, NULL, GL_STREAM_DRAW);
+		}
+		return true;
+	}
+
+	void destroy()
+	{
+		for (int i = 0; i < REGIONS; i++)
+		{
+			wait(i);
+		}
+		if (persistent || current != NULL)
+		{
+			glbuffers::unmap(ring.get());
+		}
+		ring.reset();
+		mapped = NULL;
+		current = NULL;
+	}
+
+	// move to the next region, waiting for the GPU only if it is still reading it
+	void beginFrame()
+	{
+		region = (region + 1) % REGIONS;
+		wait(region);
+		head = 0;
+
+		if (persistent)
+		{
+			current = mapped + region * regionSize;
+			return;
+		}
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+		current = (unsigned char*)glbuffers::mapRange(ring.get(), region * regionSize, regionSize, flags);
+	}
+
+	// bump allocate from this frame's region; data is NULL when the region is full (or already committed)
+	Allocation allocate(size_t size, size_t alignment = 16)
+	{
+		Allocation allocation;
+		size_t start = (head + alignment - 1) / alignment * alignment;
+		if (current == NULL || start + size > regionSize)
+		{
+			std::cout << "ERROR::RING_BUFFER::REGION_FULL" << std::endl;
+			return allocation;
+		}
+		head = start + size;
+		highWater = head > highWater ? head : highWater;
+
+		allocation.data = current + start;
+		allocation.offset = region * regionSize + start;
+		allocation.size = size;
+		return allocation;
+	}
+
+	// everything for this frame is written: make it visible to the GL commands that follow
+	void commit()
+	{
+		if (!persistent && current != NULL)
+		{
+			glbuffers::unmap(ring.get());
+			current = NULL;
+		}
+	}
+
+	// fence the region behind every command of this frame that reads from it
+	void endFrame()
+	{
+		commit();
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	unsigned int buffer() const
+	{
+		return ring.get();
+	}
+
+private:
+	GpuBuffer ring;
+	bool persistent = false;
+	unsigned char* mapped = NULL;		// whole buffer (persistent path)
+	unsigned char* current = NULL;		// this frame's region while writable
+	size_t regionSize = 0;
+	size_t head = 0;
+	int region = REGIONS - 1;
+	GLsync fences[REGIONS] = {};
+
+	void wait(int index)
+	{
+		if (fences[index] == NULL)
+		{
+			return;
+		}
+		GLenum result = glClientWaitSync(fences[index], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			stalls++;
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (glClientWaitSync(fences[index], flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+			{
+				flags = 0;
+			}
+		}
+		glDeleteSync(fences[index]);
+		fences[index] = NULL;
+	}
+};
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include "frame_arena.h"
+#include "job_system.h"
+#include "simd_math.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// one entity as spawn() takes it
+struct SceneEntity
+{
+	uint32_t mesh;			// whatever the consumer draws with (a BatchRenderer handle, say)
+	uint32_t texture;		// a TextureTable entry or similar
+	float x, y;				// home position
+	float scale;
+	float phase;			// rotation = phase + spin * time
+	float spin;
+	float color[4];
+	float radius;			// bounding sphere at scale 1, around the entity's origin
+};
+
+// one frame of a scene as the backend reads it: pointers straight into the store, nothing copied.
+// x, y, scale, rotation and radius (world bounding sphere) are that frame's transforms, the rest is
+// shared by all frames. visible is NULL unless the frame was culled on the CPU
+struct SceneView
+{
+	uint32_t count = 0;
+	uint32_t visibleCount = 0;
+	const float* x = NULL;
+	const float* y = NULL;
+	const float* scale = NULL;
+	const float* rotation = NULL;
+	const float* radius = NULL;
+	const float* red = NULL;
+	const float* green = NULL;
+	const float* blue = NULL;
+	const float* alpha = NULL;
+	const uint32_t* mesh = NULL;
+	const uint32_t* texture = NULL;
+	const uint8_t* visible = NULL;		// 1 for entities whose sphere is inside the frustum
+};
+
+// data-oriented scene storage
+// ---------------------------
+// Every component is its own array (structure of arrays) in one block, each array starting on a
+// cache line, so a pass only pulls in the components it reads or writes: the transform update
+// streams 24 bytes in and 20 bytes out per entity, where an array of entity structs drags every
+// component of every entity through the cache. update() runs as jobs over whole CHUNKs (a 64 byte
+// line of floats) so no two threads ever write the same line, and the inner loop is plain float
+// arithmetic over contiguous arrays, with the sphere transform and the frustum test done by the SIMD
+// kernels of simd_math.h a chunk at a time, while the chunk is still in L1.
+//
+// The per-frame components (the transforms) exist once per frame in flight: the main thread updates
+// frame slot N + 1 while the GL thread still reads slot N through its view(), the same way the
+// command buffers are double buffered. Entities are dense indices; spawn() appends and clear() drops
+// everything, both only while no view is in use (between frames, or before the render thread runs).
+class SceneStore
+{
+public:
+	static const uint32_t CHUNK = 16;
+	static const int FRAMES = 2;				// RenderThread::SLOTS
+	static const uint32_t INVALID_ENTITY = 0xFFFFFFFFu;
+
+	void init(uint32_t maxEntities)
+	{
+		capacity = (maxEntities + CHUNK - 1) / CHUNK * CHUNK;
+		// one extra line between arrays: sizes are often powers of two, and arrays a multiple of 4 KB
+		// apart would make the loads and stores of one entity alias each other in the cache
+		size_t arrayBytes = (size_t)capacity * sizeof(float) + LINE;
+		size_t visibleBytes = ((size_t)capacity + 2 * LINE - 1) / LINE * LINE;
+		size_t arrays = STATIC_FLOATS + FRAMES * FRAME_FLOATS + 2;
+		storage.resize(arrays * arrayBytes + FRAMES * visibleBytes + LINE);
+		size_t misalignment = (size_t)storage.data() % LINE;
+		unsigned char* next = storage.data() + (misalignment ? LINE - misalignment : 0);
+		for (int i = 0; i < STATIC_FLOATS; i++, next += arrayBytes)
+		{
+			statics[i] = (float*)next;
+		}
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			for (int i = 0; i < FRAME_FLOATS; i++, next += arrayBytes)
+			{
+				frames[frame][i] = (float*)next;
+			}
+			viewCount[frame] = 0;
+		}
+		meshes = (uint32_t*)next;
+		textures = (uint32_t*)(next + arrayBytes);
+		next += 2 * arrayBytes;
+		for (int frame = 0; frame < FRAMES; frame++, next += visibleBytes)
+		{
+			visibility[frame] = next;
+			culled[frame] = false;
+		}
+		count = 0;
+	}
+
+	uint32_t spawn(const SceneEntity& entity)
+	{
+		if (count == capacity)
+		{
+			std::cout << "ERROR::SCENE_STORE::FULL (" << capacity << " entities)" << std::endl;
+			return INVALID_ENTITY;
+		}
+		uint32_t id = count++;
+		statics[HOME_X][id] = entity.x;
+		statics[HOME_Y][id] = entity.y;
+		statics[HOME_SCALE][id] = entity.scale;
+		statics[PHASE][id] = entity.phase;
+		statics[SPIN][id] = entity.spin;
+		statics[LOCAL_RADIUS][id] = entity.radius;
+		statics[RED][id] = entity.color[0];
+		statics[GREEN][id] = entity.color[1];
+		statics[BLUE][id] = entity.color[2];
+		statics[ALPHA][id] = entity.color[3];
+		meshes[id] = entity.mesh;
+		textures[id] = entity.texture;
+		return id;
+	}
+
+	void clear()
+	{
+		count = 0;
+	}
+
+	uint32_t size() const
+	{
+		return count;
+	}
+
+	// this frame's transforms: the rotation runs with time, the whole scene is moved by transform
+	// (an affine matrix, typically a translation) and with a frustum every entity is tested against it
+	void update(JobSystem& jobs, int frame, float time, const Mat4& transform, const Frustum* frustum = NULL)
+	{
+		uint32_t chunks = (count + CHUNK - 1) / CHUNK;
+		std::atomic<uint32_t> visible { 0 };
+		jobs.parallelFor(chunks, 0, [&](uint32_t first, uint32_t end)
+		{
+			HeapAllocationScope counted;
+			visible.fetch_add(updateRange(frame, first * CHUNK, end * CHUNK, time, transform, frustum), std::memory_order_relaxed);
+		});
+		finishUpdate(frame, frustum != NULL, visible.load(std::memory_order_relaxed));
+	}
+
+	// the same on the calling thread only
+	void updateSerial(int frame, float time, const Mat4& transform, const Frustum* frustum = NULL)
+	{
+		uint32_t visible = updateRange(frame, 0, (count + CHUNK - 1) / CHUNK * CHUNK, time, transform, frustum);
+		finishUpdate(frame, frustum != NULL, visible);
+	}
+
+	// what the last update() of frame wrote, valid until frame is updated again
+	SceneView view(int frame) const
+	{
+		SceneView result;
+		result.count = viewCount[frame];
+		result.x = frames[frame][X];
+		result.y = frames[frame][Y];
+		result.scale = frames[frame][SCALE];
+		result.rotation = frames[frame][ROTATION];
+		result.radius = frames[frame][RADIUS];
+		result.red = statics[RED];
+		result.green = statics[GREEN];
+		result.blue = statics[BLUE];
+		result.alpha = statics[ALPHA];
+		result.mesh = meshes;
+		result.texture = textures;
+		result.visible = culled[frame] ? visibility[frame] : NULL;
+		result.visibleCount = visibleCount[frame];
+		return result;
+	}
+
+private:
+	static const size_t LINE = 64;
+
+	enum StaticFloat { HOME_X, HOME_Y, HOME_SCALE, PHASE, SPIN, LOCAL_RADIUS, RED, GREEN, BLUE, ALPHA, STATIC_FLOATS };
+	enum FrameFloat { X, Y, SCALE, ROTATION, RADIUS, FRAME_FLOATS };
+
+	std::vector<unsigned char> storage;
+	float* statics[STATIC_FLOATS] = {};
+	float* frames[FRAMES][FRAME_FLOATS] = {};
+	uint32_t* meshes = NULL;
+	uint32_t* textures = NULL;
+	uint32_t capacity = 0;
+	uint32_t count = 0;
+	uint32_t viewCount[FRAMES] = {};
+	uint8_t* visibility[FRAMES] = {};
+	bool culled[FRAMES] = {};
+	uint32_t visibleCount[FRAMES] = {};
+
+	void finishUpdate(int frame, bool culledFrame, uint32_t visible)
+	{
+		viewCount[frame] = count;
+		culled[frame] = culledFrame;
+		visibleCount[frame] = culledFrame ? visible : count;
+	}
+
+	// [begin, end) in whole chunks; the tail past count is scratch, updating it keeps the loops branch
+	// free (only the visible count stops at count). Returns how many entities passed the frustum
+	uint32_t updateRange(int frame, uint32_t begin, uint32_t end, float time, const Mat4& transform, const Frustum* frustum)
+	{
+		const float* __restrict homeX = statics[HOME_X];
+		const float* __restrict homeY = statics[HOME_Y];
+		const float* __restrict homeScale = statics[HOME_SCALE];
+		const float* __restrict phase = statics[PHASE];
+		const float* __restrict spin = statics[SPIN];
+		const float* __restrict localRadius = statics[LOCAL_RADIUS];
+		float* __restrict x = frames[frame][X];
+		float* __restrict y = frames[frame][Y];
+		float* __restrict scale = frames[frame][SCALE];
+		float* __restrict rotation = frames[frame][ROTATION];
+		float* __restrict radius = frames[frame][RADIUS];
+		uint32_t visible = 0;
+		for (uint32_t chunk = begin; chunk < end; chunk += CHUNK)
+		{
+			for (uint32_t i = chunk; i < chunk + CHUNK; i++)
+			{
+				scale[i] = homeScale[i];
+				rotation[i] = phase[i] + spin[i] * time;
+				radius[i] = localRadius[i] * homeScale[i];
+			}
+			transformSpheres(transform, homeX + chunk, homeY + chunk, NULL, radius + chunk, x + chunk, y + chunk, NULL, radius + chunk, CHUNK);
+			if (frustum != NULL && chunk < count)
+			{
+				uint32_t live = count - chunk < CHUNK ? count - chunk : CHUNK;
+				visible += cullSpheres(*frustum, x + chunk, y + chunk, NULL, radius + chunk, live, visibility[frame] + chunk);
+			}
+		}
+		return visible;
+	}
+};
+
+// scene update benchmark: the SoA store against an array of entity structs
+// -------------------------------------------------------------------------
+// Same transform update both ways, at sizes from inside L1/L2 to well past the last level cache.
+// The bytes column is what each layout moves through the cache per entity: the AoS pass touches
+// a few fields of every struct but pays for whole lines. For the miss rates themselves run this
+// under a counter tool (perf stat -e L1-dcache-load-misses,l2_rqsts.miss on Linux, VTune or uProf
+// on Windows): expect the AoS misses to scale with the struct size, the SoA ones with the 44 bytes.
+struct SceneEntityAoS
+{
+	uint32_t mesh, texture;
+	float homeX, homeY, homeScale, phase, spin, localRadius;
+	float color[4];
+	float x, y, scale, rotation, radius;
+};
+
+inline void runSceneBenchmark(JobSystem& jobs)
+{
+	typedef std::chrono::steady_clock Clock;
+	const uint32_t COUNTS[] = { 1024, 16384, 262144, 1 << 21 };
+	const int REPEATS = 20;
+
+	printf("scene update: %d job threads, AoS entity %zu bytes, SoA 44 bytes touched per entity\n", jobs.size(), sizeof(SceneEntityAoS));
+	printf("%10s  %-10s  %10s  %12s  %12s\n", "entities", "layout", "ms", "ns/entity", "bytes/entity");
+	for (uint32_t count : COUNTS)
+	{
+		SceneStore store;
+		store.init(count);
+		std::vector<SceneEntityAoS> entities(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			SceneEntity entity = { i % 4, i % 6, (float)(i % 64), (float)(i / 64), 1.0f + (i % 3), 0.1f * i, 0.3f + (i % 5) * 0.2f, { 1, 1, 1, 1 }, 0.75f };
+			store.spawn(entity);
+			SceneEntityAoS& aos = entities[i];
+			aos = SceneEntityAoS();
+			aos.mesh = entity.mesh;
+			aos.texture = entity.texture;
+			aos.homeX = entity.x;
+			aos.homeY = entity.y;
+			aos.homeScale = entity.scale;
+			aos.phase = entity.phase;
+			aos.spin = entity.spin;
+			aos.localRadius = entity.radius;
+		}
+
+		for (int layout = 0; layout < 3; layout++)
+		{
+			double best = 1e30;
+			for (int r = 0; r < REPEATS; r++)
+			{
+				float time = 0.016f * r;
+				Mat4 transform = mat4Translation(0.5f * sinf(time), 0.0f, 0.0f);
+				const float* m = transform.m;
+				float radiusScale = mat4MaxScale(transform);
+				Clock::time_point start = Clock::now();
+				if (layout == 0)
+				{
+					for (SceneEntityAoS& entity : entities)
+					{
+						entity.x = m[4] * entity.homeY + (m[0] * entity.homeX + m[12]);
+						entity.y = m[5] * entity.homeY + (m[1] * entity.homeX + m[13]);
+						entity.scale = entity.homeScale;
+						entity.rotation = entity.phase + entity.spin * time;
+						entity.radius = entity.localRadius * entity.homeScale * radiusScale;
+					}
+				}
+				else if (layout == 1)
+				{
+					store.updateSerial(0, time, transform);
+				}
+				else
+				{
+					store.update(jobs, 0, time, transform);
+				}
+				double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				best = ms < best ? ms : best;
+			}
+			const char* names[] = { "AoS", "SoA", "SoA jobs" };
+			printf("%10u  %-10s  %10.3f  %12.2f  %12zu\n", count, names[layout], best, best * 1e6 / count,
+				layout == 0 ? sizeof(SceneEntityAoS) : (size_t)44);
+		}
+		// keep the AoS results observable so the pass isn't optimized away
+		if (entities[count / 2].rotation < -1e30f)
+		{
+			printf("\n");
+		}
+	}
+}
+
+#endif
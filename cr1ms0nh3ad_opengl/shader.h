@@ -0,0 +1,94 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+
+#include <iostream>
+#include <string>
+
+// shader stage name used in the diagnostics below
+// -----------------------------------------------
+inline const char* shaderStageName(GLenum type)
+{
+	switch (type)
+	{
+	case GL_VERTEX_SHADER: return "VERTEX";
+	case GL_FRAGMENT_SHADER: return "FRAGMENT";
+	case GL_GEOMETRY_SHADER: return "GEOMETRY";
+	case GL_COMPUTE_SHADER: return "COMPUTE";
+	default: return "UNKNOWN";
+	}
+}
+
+// prepend #define lines to a source, keeping the #version directive on the first line; a #line
+// after them puts the source back on its own numbering (string 0, the root of a ShaderSource), so
+// driver diagnostics point at the same lines with or without the defines
+// ------------------------------------------------------------------------------------------------
+inline std::string injectDefines(const char* source, const std::string& defines)
+{
+	std::string result(source);
+	if (defines.empty())
+	{
+		return result;
+	}
+
+	size_t versionEnd = result.find('\n');
+	if (result.compare(0, 8, "#version") != 0 || versionEnd == std::string::npos)
+	{
+		return defines + "#line 1 0\n" + result;
+	}
+	return result.insert(versionEnd + 1, defines + "#line 2 0\n");
+}
+
+// compilation status logging
+// --------------------------
+inline bool checkCompileStatus(unsigned int shader, GLenum type)
+{
+	int success;
+	char infoLog[512];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+	if (!success)
+	{
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::" << shaderStageName(type) << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+	return success != 0;
+}
+
+// linking status logging
+// ----------------------
+inline bool checkLinkStatus(unsigned int program)
+{
+	int success;
+	char infoLog[512];
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (!success)
+	{
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING::FAILED\n" << infoLog << std::endl;
+	}
+	return success != 0;
+}
+
+// compile a single stage, 0 when it fails (the info log is printed)
+// -----------------------------------------------------------------
+inline unsigned int compileShader(GLenum type, const std::string& source)
+{
+	const char* text = source.c_str();
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+
+	if (!checkCompileStatus(shader, type))
+	{
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+#endif
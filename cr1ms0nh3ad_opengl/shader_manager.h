@@ -0,0 +1,515 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <glad/glad.h>
+
+#include "file_watcher.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "program_cache.h"
+#include "shader.h"
+#include "shader_source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// asynchronous shader program manager
+// -----------------------------------
+// Every program is submitted up front: sources go to the driver immediately and nothing waits on
+// the result. poll() runs once per frame and moves each program through compile -> link -> ready.
+// With KHR/ARB_parallel_shader_compile the driver compiles on its own threads and we only look at
+// GL_COMPLETION_STATUS_KHR, which never blocks; without it the first status query would block, so
+// poll() advances a single program per frame to spread the cost. Until a program is ready program()
+// hands out the fallback so the render loop keeps presenting something.
+// Programs from files (submitFiles) can hot reload: with a FileWatcher attached, poll() rebuilds
+// every program that has a changed file anywhere in its include graph, in the background like the
+// first build, while its current program stays in use. A good build replaces it inside poll(), so
+// between frames; a failed one prints the driver log and keeps the old program.
+// Variants (submitVariants) are a family of file programs, one per combination of feature bits, each
+// bit a #define, so a feature costs a compile instead of a runtime branch. Their handles are reserved
+// up front and variant() only computes one from what submitVariants() fixed, so the main thread picks
+// variants while recording a frame slot and the render thread while replaying one, neither touching
+// GL; nothing is compiled until program() first sees a handle. Every variant that was used is
+// remembered, and writeUsage() / prewarm() carry that list to the next run so the usual set is already
+// building (usually straight from the binary cache) before the first frame asks for it.
+class ShaderManager
+{
+public:
+	static const int MAX_FEATURES = 6;
+
+	// compile the fallback synchronously (it has to exist from the very first frame)
+	void init(ProgramCache& programCache, const char* fallbackVertexSource, const char* fallbackFragmentSource)
+	{
+		cache = &programCache;
+		if (glext::parallelShaderCompile)
+		{
+			// let the driver pick as many compiler threads as it sees fit
+			glext::MaxShaderCompilerThreads(0xFFFFFFFFu);
+		}
+		fallback = cache->build(fallbackVertexSource, fallbackFragmentSource);
+	}
+
+	// rebuild file programs when their files change (the watcher must outlive the manager's use of it)
+	void enableHotReload(FileWatcher& fileWatcher)
+	{
+		watcher = &fileWatcher;
+		updateWatch();
+	}
+
+	void destroy()
+	{
+		for (Program& entry : programs)
+		{
+			discardPending(entry);
+			if (entry.current != 0)
+			{
+				glState.deleteProgram(entry.current);
+			}
+		}
+		programs.clear();
+		glState.deleteProgram(fallback);
+		fallback = 0;
+	}
+
+	// queue a program for compilation, returns the handle used with program()
+	int submit(const char* name, const char* vertexSource, const char* fragmentSource, const std::string& defines = "")
+	{
+		Program entry;
+		entry.name = name;
+		programs.push_back(entry);
+		int handle = (int)programs.size() - 1;
+		start(programs[handle], vertexSource, fragmentSource, defines);
+		return handle;
+	}
+
+	// the same from shader files (see shader_source.h); a file that won't load leaves the fallback in place
+	int submitFiles(const char* name, const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "")
+	{
+		Program entry;
+		entry.name = name;
+		entry.vertexPath = vertexPath;
+		entry.fragmentPath = fragmentPath;
+		entry.defines = defines;
+		programs.push_back(entry);
+		int handle = (int)programs.size() - 1;
+		reload(programs[handle]);
+		updateWatch();
+		return handle;
+	}
+
+	// a family of variants; bit i of a variant's mask defines features[i] (on top of defines)
+	int submitVariants(const char* name, const std::string& vertexPath, const std::string& fragmentPath,
+		const std::vector<std::string>& features, const std::string& defines = "")
+	{
+		Family family;
+		family.name = name;
+		family.features = features;
+		family.first = (int)programs.size();
+		if (family.features.size() > (size_t)MAX_FEATURES)
+		{
+			std::cout << "ERROR::SHADER_MANAGER::TOO_MANY_FEATURES " << name << std::endl;
+			family.features.resize(MAX_FEATURES);
+		}
+		for (uint32_t mask = 0; mask < (1u << family.features.size()); mask++)
+		{
+			Program entry;
+			entry.name = family.name + variantSuffix(family, mask);
+			entry.vertexPath = vertexPath;
+			entry.fragmentPath = fragmentPath;
+			entry.defines = defines;
+			for (size_t bit = 0; bit < family.features.size(); bit++)
+			{
+				entry.defines += (mask >> bit) & 1 ? "#define " + family.features[bit] + "\n" : "";
+			}
+			entry.state = DEFERRED;
+			programs.push_back(entry);
+		}
+		families.push_back(family);
+		return (int)families.size() - 1;
+	}
+
+	// the program handle of a variant; any thread, never compiles anything itself
+	int variant(int family, uint32_t mask) const
+	{
+		const Family& entry = families[family];
+		return entry.first + (int)(mask & ((1u << entry.features.size()) - 1));
+	}
+
+	// start building the variants listed by an earlier writeUsage() (unknown names are skipped)
+	void prewarm(const std::string& path)
+	{
+		std::ifstream file(path);
+		std::string line;
+		int started = 0;
+		while (std::getline(file, line))
+		{
+			std::istringstream words(line);
+			std::string familyName, feature;
+			words >> familyName;
+			for (size_t f = 0; f < families.size(); f++)
+			{
+				if (families[f].name != familyName)
+				{
+					continue;
+				}
+				uint32_t mask = 0;
+				while (words >> feature)
+				{
+					auto found = std::find(families[f].features.begin(), families[f].features.end(), feature);
+					mask |= found != families[f].features.end() ? 1u << (found - families[f].features.begin()) : 0u;
+				}
+				started += use(variant((int)f, mask)) ? 1 : 0;
+			}
+		}
+		if (started > 0)
+		{
+			std::cout << "SHADER_MANAGER::PREWARM " << started << " variants from " << path << std::endl;
+		}
+	}
+
+	// every variant used this run or prewarmed, one per line: family name, then its feature names
+	void writeUsage(const std::string& path) const
+	{
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+		std::ofstream file(path, std::ios::trunc);
+		for (const std::string& line : usage)
+		{
+			file << line << "\n";
+		}
+	}
+
+	// advance in-flight programs, call once per frame
+	void poll()
+	{
+		if (watcher != NULL)
+		{
+			reloadChanged(watcher->takeChanged());
+		}
+
+		bool budgetSpent = false;
+		for (Program& entry : programs)
+		{
+			if (entry.state != COMPILING && entry.state != LINKING)
+			{
+				continue;
+			}
+			if (!glext::parallelShaderCompile)
+			{
+				// status queries block here, so only pay for one program per frame
+				if (budgetSpent)
+				{
+					return;
+				}
+				budgetSpent = true;
+			}
+			advance(entry);
+		}
+	}
+
+	// the linked program for a handle, or the fallback while it is still building (or failed); the
+	// first call for a variant starts its build (GL thread)
+	unsigned int program(int handle)
+	{
+		Program& entry = programs[handle];
+		if (entry.state == DEFERRED)
+		{
+			use(handle);
+		}
+		return entry.current != 0 ? entry.current : fallback;
+	}
+
+	bool isReady(int handle) const
+	{
+		return programs[handle].current != 0;
+	}
+
+	// true once nothing is compiling or linking anymore
+	bool isIdle() const
+	{
+		for (const Program& entry : programs)
+		{
+			if (entry.state == COMPILING || entry.state == LINKING)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	enum State
+	{
+		DEFERRED,			// a variant nobody asked for yet
+		COMPILING,
+		LINKING,
+		READY,
+		FAILED
+	};
+
+	struct Program
+	{
+		std::string name;
+		State state = COMPILING;
+		unsigned int current = 0;			// program in use (survives failed rebuilds)
+		unsigned int pending = 0;			// program object being built
+		unsigned int vertexShader = 0;
+		unsigned int fragmentShader = 0;
+		uint64_t key = 0;
+		Clock::time_point submitted;
+
+		// file programs only
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::string defines;
+		ShaderSource vertexSource;
+		ShaderSource fragmentSource;
+	};
+
+	struct Family
+	{
+		std::string name;
+		std::vector<std::string> features;
+		int first = 0;					// handle of mask 0, the other masks follow
+	};
+
+	ProgramCache* cache = NULL;
+	unsigned int fallback = 0;
+	std::vector<Program> programs;
+	std::vector<Family> families;
+	std::set<std::string> usage;
+	FileWatcher* watcher = NULL;
+
+	static std::string variantSuffix(const Family& family, uint32_t mask)
+	{
+		std::string suffix;
+		for (size_t bit = 0; bit < family.features.size(); bit++)
+		{
+			suffix += (mask >> bit) & 1 ? " " + family.features[bit] : "";
+		}
+		return suffix;
+	}
+
+	// start a deferred variant and note it for writeUsage(); false if it was already going
+	bool use(int handle)
+	{
+		Program& entry = programs[handle];
+		if (entry.state != DEFERRED)
+		{
+			return false;
+		}
+		usage.insert(entry.name);
+		reload(entry);
+		updateWatch();
+		return true;
+	}
+
+	static bool dependsOn(const Program& entry, const std::string& path)
+	{
+		const std::vector<std::string>& vertexFiles = entry.vertexSource.files;
+		const std::vector<std::string>& fragmentFiles = entry.fragmentSource.files;
+		return std::find(vertexFiles.begin(), vertexFiles.end(), path) != vertexFiles.end()
+			|| std::find(fragmentFiles.begin(), fragmentFiles.end(), path) != fragmentFiles.end();
+	}
+
+	void reloadChanged(const std::vector<std::string>& changed)
+	{
+		if (changed.empty())
+		{
+			return;
+		}
+		for (Program& entry : programs)
+		{
+			bool affected = false;
+			for (const std::string& path : changed)
+			{
+				affected = affected || (!entry.vertexPath.empty() && dependsOn(entry, path));
+			}
+			if (affected)
+			{
+				std::cout << "SHADER_MANAGER::RELOAD " << entry.name << std::endl;
+				reload(entry);
+			}
+		}
+		// an edit may have added or dropped includes
+		updateWatch();
+	}
+
+	// (re)read a file program's sources and start building it; a build still in flight is dropped
+	void reload(Program& entry)
+	{
+		discardPending(entry);
+		bool loaded = loadShaderSource(entry.vertexPath, entry.vertexSource);
+		loaded = loadShaderSource(entry.fragmentPath, entry.fragmentSource) && loaded;
+		if (!loaded)
+		{
+			const std::string& error = entry.vertexSource.error.empty() ? entry.fragmentSource.error : entry.vertexSource.error;
+			std::cout << "ERROR::SHADER_MANAGER::SOURCE_FAILED " << entry.name << ": " << error << std::endl;
+			entry.state = FAILED;
+			return;
+		}
+		start(entry, entry.vertexSource.text.c_str(), entry.fragmentSource.text.c_str(), entry.defines);
+	}
+
+	void updateWatch()
+	{
+		if (watcher == NULL)
+		{
+			return;
+		}
+		std::vector<std::string> files;
+		for (const Program& entry : programs)
+		{
+			files.insert(files.end(), entry.vertexSource.files.begin(), entry.vertexSource.files.end());
+			files.insert(files.end(), entry.fragmentSource.files.begin(), entry.fragmentSource.files.end());
+		}
+		std::sort(files.begin(), files.end());
+		files.erase(std::unique(files.begin(), files.end()), files.end());
+		watcher->watch(files);
+	}
+
+	void start(Program& entry, const char* vertexSource, const char* fragmentSource, const std::string& defines)
+	{
+		entry.submitted = Clock::now();
+		entry.key = cache->key(vertexSource, fragmentSource, defines);
+
+		entry.pending = glCreateProgram();
+		if (cache->load(entry.key, entry.pending))
+		{
+			finish(entry);
+			return;
+		}
+		cache->misses++;
+
+		entry.vertexShader = submitShader(GL_VERTEX_SHADER, injectDefines(vertexSource, defines));
+		entry.fragmentShader = submitShader(GL_FRAGMENT_SHADER, injectDefines(fragmentSource, defines));
+		entry.state = COMPILING;
+	}
+
+	static unsigned int submitShader(GLenum type, const std::string& source)
+	{
+		const char* text = source.c_str();
+		unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	static bool isComplete(unsigned int object, bool program)
+	{
+		if (!glext::parallelShaderCompile)
+		{
+			return true;
+		}
+		int complete = 0;
+		if (program)
+		{
+			glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+		}
+		else
+		{
+			glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+		}
+		return complete != 0;
+	}
+
+	void advance(Program& entry)
+	{
+		if (entry.state == COMPILING)
+		{
+			if (!isComplete(entry.vertexShader, false) || !isComplete(entry.fragmentShader, false))
+			{
+				return;
+			}
+			bool compiled = checkCompileStatus(entry.vertexShader, GL_VERTEX_SHADER);
+			compiled = checkCompileStatus(entry.fragmentShader, GL_FRAGMENT_SHADER) && compiled;
+			if (!compiled)
+			{
+				fail(entry);
+				return;
+			}
+
+			cache->prepare(entry.pending);
+			glAttachShader(entry.pending, entry.vertexShader);
+			glAttachShader(entry.pending, entry.fragmentShader);
+			glLinkProgram(entry.pending);
+			entry.state = LINKING;
+			if (glext::parallelShaderCompile)
+			{
+				return;
+			}
+		}
+
+		if (entry.state == LINKING)
+		{
+			if (!isComplete(entry.pending, true))
+			{
+				return;
+			}
+			if (!checkLinkStatus(entry.pending))
+			{
+				fail(entry);
+				return;
+			}
+			cache->store(entry.key, entry.pending);
+			finish(entry);
+		}
+	}
+
+	void finish(Program& entry)
+	{
+		deleteShaders(entry);
+		if (entry.current != 0)
+		{
+			glState.deleteProgram(entry.current);
+		}
+		entry.current = entry.pending;
+		entry.pending = 0;
+		entry.state = READY;
+		std::cout << "SHADER_MANAGER::READY " << entry.name << " after "
+			<< std::chrono::duration<double, std::milli>(Clock::now() - entry.submitted).count() << " ms" << std::endl;
+	}
+
+	void fail(Program& entry)
+	{
+		std::cout << "ERROR::SHADER_MANAGER::BUILD_FAILED " << entry.name << (entry.current != 0 ? " (keeping the previous program)" : "") << std::endl;
+		if (!entry.vertexPath.empty())
+		{
+			std::cout << "  vertex sources: " << shaderSourceFileList(entry.vertexSource) << "\n"
+				<< "  fragment sources: " << shaderSourceFileList(entry.fragmentSource) << std::endl;
+		}
+		discardPending(entry);
+		entry.state = FAILED;
+	}
+
+	void deleteShaders(Program& entry)
+	{
+		// glDeleteShader ignores 0, and attached shaders are only flagged until the program goes away
+		glDeleteShader(entry.vertexShader);
+		glDeleteShader(entry.fragmentShader);
+		entry.vertexShader = 0;
+		entry.fragmentShader = 0;
+	}
+
+	void discardPending(Program& entry)
+	{
+		deleteShaders(entry);
+		if (entry.pending != 0)
+		{
+			glState.deleteProgram(entry.pending);
+			entry.pending = 0;
+		}
+	}
+};
+
+#endif
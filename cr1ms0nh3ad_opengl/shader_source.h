@@ -0,0 +1,106 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// a shader stage loaded from disk with its #include "file" lines expanded
+// -----------------------------------------------------------------------
+// Include paths are relative to the file doing the including, and each file goes in once per stage
+// (a second #include of it is dropped, like #pragma once) so shared snippets need no include guards.
+// Every switch between files leaves a #line directive whose source string number is the file's
+// index in files, which is how driver diagnostics like "2(14)" map back to a file and line.
+// Included files must not have a #version line; the root keeps its own on the first line.
+struct ShaderSource
+{
+	std::string text;
+	std::vector<std::string> files;		// files[0] is the root; everything here is a dependency
+	std::string error;					// what went wrong when loadShaderSource() returned false
+};
+
+inline bool expandShaderFile(const std::string& path, ShaderSource& source, std::vector<std::string>& stack)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		source.error = "can't open " + path;
+		return false;
+	}
+	int index = (int)source.files.size() - 1;
+	stack.push_back(path);
+
+	std::string line;
+	int number = 0;
+	while (std::getline(file, line))
+	{
+		number++;
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+		{
+			source.text += line;
+			source.text += '\n';
+			continue;
+		}
+
+		size_t open = line.find('"', start + 8);
+		size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		if (close == std::string::npos)
+		{
+			source.error = path + "(" + std::to_string(number) + "): #include needs a \"file\"";
+			return false;
+		}
+		std::filesystem::path included = std::filesystem::path(path).parent_path() / line.substr(open + 1, close - open - 1);
+		std::string includedPath = included.lexically_normal().generic_string();
+		for (const std::string& parent : stack)
+		{
+			if (parent == includedPath)
+			{
+				source.error = path + "(" + std::to_string(number) + "): include cycle through " + includedPath;
+				return false;
+			}
+		}
+		bool seen = false;
+		for (const std::string& known : source.files)
+		{
+			seen = seen || known == includedPath;
+		}
+		if (!seen)
+		{
+			source.files.push_back(includedPath);
+			source.text += "#line 1 " + std::to_string(source.files.size() - 1) + "\n";
+			if (!expandShaderFile(includedPath, source, stack))
+			{
+				return false;
+			}
+		}
+		source.text += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + "\n";
+	}
+	stack.pop_back();
+	return true;
+}
+
+// load path and everything it includes; false with source.error set when a file is missing or
+// malformed (source.files still lists what was reached, so a watcher can wait for the fix)
+inline bool loadShaderSource(const std::string& path, ShaderSource& source)
+{
+	source = ShaderSource();
+	source.files.push_back(std::filesystem::path(path).lexically_normal().generic_string());
+	std::vector<std::string> stack;
+	return expandShaderFile(source.files[0], source, stack);
+}
+
+// "0 = shaders/batch.frag, 1 = shaders/include/dither.glsl", for reading driver logs
+inline std::string shaderSourceFileList(const ShaderSource& source)
+{
+	std::ostringstream list;
+	for (size_t i = 0; i < source.files.size(); i++)
+	{
+		list << (i > 0 ? ", " : "") << i << " = " << source.files[i];
+	}
+	return list.str();
+}
+
+#endif
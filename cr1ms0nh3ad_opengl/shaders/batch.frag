@@ -0,0 +1,35 @@
+#version 430 core
+// variants: LOD_FADE honours the dither coverage in alpha while objects cross-fade between levels
+// of detail (without it nothing discards, which keeps early depth testing); the texture comes from
+// the texture table (texture_table.h), BINDLESS or TEXTURE_ARRAY picking how (the handle index is the
+// same for a whole draw, which is what bindless sampling asks for)
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+layout (std430, binding = 6) readonly buffer Textures { uvec2 handles[]; };
+#elif defined(TEXTURE_ARRAY)
+layout (binding = 1) uniform sampler2DArray uTextures;
+#endif
+#include "include/dither.glsl"
+in vec4 color;
+in vec2 uv;
+flat in uint textureIndex;
+out vec4 FragColor;
+void main()
+{
+#ifdef LOD_FADE
+	if (ditherDiscards(color.a))
+	{
+		discard;
+	}
+#endif
+	vec3 albedo = vec3(1.0);
+	if (textureIndex != 0xFFFFFFFFu)
+	{
+#ifdef BINDLESS
+		albedo = texture(sampler2D(handles[textureIndex]), uv).rgb;
+#elif defined(TEXTURE_ARRAY)
+		albedo = texture(uTextures, vec3(uv, float(textureIndex))).rgb;
+#endif
+	}
+	FragColor = vec4(color.rgb * albedo, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 430 core
+// per-draw data in an SSBO indexed by the draw id attribute (see batch_renderer.h)
+#include "include/transform.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawId;
+struct DrawData
+{
+	vec4 transform;
+	vec4 color;
+	uint texture;
+};
+layout (std430, binding = 0) readonly buffer Draws
+{
+	DrawData draws[];
+};
+out vec4 color;
+out vec2 uv;
+flat out uint textureIndex;
+void main()
+{
+	DrawData draw = draws[aDrawId];
+	gl_Position = vec4(placeSprite(aPos.xy, draw.transform), aPos.z, 1.0);
+	color = draw.color;
+	uv = vec2(aPos.x + 0.5, 0.5 - aPos.y);
+	textureIndex = draw.texture;
+}
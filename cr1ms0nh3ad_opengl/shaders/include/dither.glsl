@@ -0,0 +1,9 @@
+// screen-door coverage for LOD cross-fades (see selectLod in gpu_culling.h): a 4x4 ordered dither,
+// a in [0, 1] keeps the pixels whose dither value is below a, a in [-1, 0) the ones at or above a + 1
+const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+bool ditherDiscards(float coverage)
+{
+	ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+	float dither = (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+	return coverage < 0.0 ? dither < coverage + 1.0 : dither >= coverage;
+}
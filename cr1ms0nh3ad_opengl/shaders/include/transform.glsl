@@ -0,0 +1,8 @@
+// sprite style placement: x, y offset, uniform scale, rotation in radians
+vec2 placeSprite(vec2 position, vec4 transform)
+{
+	float s = sin(transform.w);
+	float c = cos(transform.w);
+	vec2 p = position * transform.z;
+	return vec2(c * p.x - s * p.y, s * p.x + c * p.y) + transform.xy;
+}
@@ -0,0 +1,16 @@
+// quantized mesh attributes (see vertex_quantize.h): positions are half floats over the mesh's
+// bounding box, its center and extent come in as attributes every vertex reads the same value of
+layout (location = 14) in vec3 aPositionCenter;
+layout (location = 15) in vec3 aPositionExtent;
+vec3 decodePosition(vec3 stored)
+{
+	return aPositionCenter + stored * aPositionExtent;
+}
+// octahedral normal from the snorm x, y of an INT_2_10_10_10_REV attribute
+vec3 decodeNormal(vec2 octahedral)
+{
+	vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+	return normalize(normal);
+}
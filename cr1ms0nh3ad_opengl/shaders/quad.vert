@@ -0,0 +1,7 @@
+#version 330 core
+#include "include/vertex_decode.glsl"
+layout (location = 0) in vec3 aPos;
+void main()
+{
+	gl_Position = vec4(decodePosition(aPos), 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// instanced: per-instance transform + color from vertex attributes (see instancing.h)
+#include "include/transform.glsl"
+#include "include/vertex_decode.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aTransform;
+layout (location = 2) in vec4 aColor;
+out vec4 color;
+void main()
+{
+	vec3 position = decodePosition(aPos);
+	gl_Position = vec4(placeSprite(position.xy, aTransform), position.z, 1.0);
+	color = aColor;
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// the same data from uniforms, for the per-draw benchmark path
+#include "include/transform.glsl"
+#include "include/vertex_decode.glsl"
+layout (location = 0) in vec3 aPos;
+uniform vec4 uTransform;
+uniform vec4 uColor;
+out vec4 color;
+void main()
+{
+	vec3 position = decodePosition(aPos);
+	gl_Position = vec4(placeSprite(position.xy, uTransform), position.z, 1.0);
+	color = uColor;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// variants: NORMAL_MAP reads a two channel tangent space normal and lights it, otherwise the
+// texture is the color
+in vec2 uv;
+uniform sampler2D uTexture;
+out vec4 FragColor;
+void main()
+{
+#ifdef NORMAL_MAP
+	vec2 xy = texture(uTexture, uv).rg * 2.0 - 1.0;
+	vec3 normal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+	float light = max(dot(normal, normalize(vec3(0.4, 0.6, 0.7))), 0.0);
+	FragColor = vec4(vec3(0.15 + 0.85 * light), 1.0);
+#else
+	FragColor = vec4(texture(uTexture, uv).rgb, 1.0);
+#endif
+}
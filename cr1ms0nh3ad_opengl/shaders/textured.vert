@@ -0,0 +1,13 @@
+#version 330 core
+// a streamed texture on the quad, placed like the single sprite (no rotation)
+#include "include/vertex_decode.glsl"
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in vec2 aUv;
+uniform vec4 uTransform;
+out vec2 uv;
+void main()
+{
+	vec3 position = decodePosition(aPos);
+	gl_Position = vec4(position.xy * uTransform.z + uTransform.xy, position.z, 1.0);
+	uv = aUv;
+}
@@ -0,0 +1,29 @@
+#version 330 core
+// variants: SHARPEN adds an unsharp mask over the four neighbouring source texels, clamped to
+// their range so it can't overshoot into halos; otherwise plain bilinear. Samples stay half a texel
+// inside the rendered corner (uScale) so the filter never reads what this frame didn't draw.
+in vec2 uv;
+uniform sampler2D uSource;
+uniform vec2 uScale;
+uniform vec2 uTexel;
+uniform float uSharpness;
+out vec4 FragColor;
+vec3 source(vec2 at)
+{
+	return texture(uSource, clamp(at, uTexel * 0.5, uScale - uTexel * 0.5)).rgb;
+}
+void main()
+{
+	vec3 center = source(uv);
+#ifdef SHARPEN
+	vec3 north = source(uv + vec2(0.0, uTexel.y));
+	vec3 south = source(uv - vec2(0.0, uTexel.y));
+	vec3 east = source(uv + vec2(uTexel.x, 0.0));
+	vec3 west = source(uv - vec2(uTexel.x, 0.0));
+	vec3 low = min(center, min(min(north, south), min(east, west)));
+	vec3 high = max(center, max(max(north, south), max(east, west)));
+	vec3 sharpened = center + uSharpness * (center - 0.25 * (north + south + east + west));
+	center = clamp(sharpened, low, high);
+#endif
+	FragColor = vec4(center, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+// fullscreen triangle from the vertex id alone (no attributes), uv over the scene's used corner
+uniform vec2 uScale;
+out vec2 uv;
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+	uv = corner * uScale;
+}
@@ -0,0 +1,529 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// instruction set: picked at compile time from what the compiler targets
+// -----------------------------------------------------------------------
+// AVX2 when the build enables it (/arch:AVX2, -mavx2), SSE2 on any other x86 (always there on x64),
+// NEON on 64-bit ARM, plain scalar code elsewhere. The SoA kernels below run at the full register
+// width (8 lanes with AVX2, 4 otherwise); the 4x4 matrix product works a column at a time in 4-wide
+// registers whatever the width.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
+namespace simd
+{
+#if SIMD_AVX2
+	typedef __m256 Floats;
+	typedef __m256 Mask;
+	const int WIDTH = 8;
+	const char* const NAME = "AVX2";
+	inline Floats load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void store(float* p, Floats v) { _mm256_storeu_ps(p, v); }
+	inline Floats splat(float x) { return _mm256_set1_ps(x); }
+	inline Floats add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+	inline Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+	inline Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+	inline Mask greater(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	inline int bits(Mask m) { return _mm256_movemask_ps(m); }
+#elif SIMD_X86
+	typedef __m128 Floats;
+	typedef __m128 Mask;
+	const int WIDTH = 4;
+	const char* const NAME = "SSE2";
+	inline Floats load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, Floats v) { _mm_storeu_ps(p, v); }
+	inline Floats splat(float x) { return _mm_set1_ps(x); }
+	inline Floats add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+	inline Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+	inline Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+	inline Mask greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+	inline Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	inline int bits(Mask m) { return _mm_movemask_ps(m); }
+#elif SIMD_NEON
+	typedef float32x4_t Floats;
+	typedef uint32x4_t Mask;
+	const int WIDTH = 4;
+	const char* const NAME = "NEON";
+	inline Floats load(const float* p) { return vld1q_f32(p); }
+	inline void store(float* p, Floats v) { vst1q_f32(p, v); }
+	inline Floats splat(float x) { return vdupq_n_f32(x); }
+	inline Floats add(Floats a, Floats b) { return vaddq_f32(a, b); }
+	inline Floats sub(Floats a, Floats b) { return vsubq_f32(a, b); }
+	inline Floats mul(Floats a, Floats b) { return vmulq_f32(a, b); }
+	inline Mask greater(Floats a, Floats b) { return vcgtq_f32(a, b); }
+	inline Mask both(Mask a, Mask b) { return vandq_u32(a, b); }
+	inline int bits(Mask m)
+	{
+		const uint32_t weights[4] = { 1, 2, 4, 8 };
+		return (int)vaddvq_u32(vandq_u32(m, vld1q_u32(weights)));
+	}
+#else
+	typedef float Floats;
+	typedef bool Mask;
+	const int WIDTH = 1;
+	const char* const NAME = "scalar";
+	inline Floats load(const float* p) { return *p; }
+	inline void store(float* p, Floats v) { *p = v; }
+	inline Floats splat(float x) { return x; }
+	inline Floats add(Floats a, Floats b) { return a + b; }
+	inline Floats sub(Floats a, Floats b) { return a - b; }
+	inline Floats mul(Floats a, Floats b) { return a * b; }
+	inline Mask greater(Floats a, Floats b) { return a > b; }
+	inline Mask both(Mask a, Mask b) { return a && b; }
+	inline int bits(Mask m) { return m ? 1 : 0; }
+#endif
+
+	// a * b + c (kept as two operations, so results match the scalar code bit for bit)
+	inline Floats madd(Floats a, Floats b, Floats c) { return add(mul(a, b), c); }
+}
+
+// 4x4 matrix, column-major like GL takes it (m[column * 4 + row])
+// ----------------------------------------------------------------
+struct alignas(16) Mat4
+{
+	float m[16];
+};
+
+inline Mat4 mat4Identity()
+{
+	Mat4 result = {};
+	result.m[0] = result.m[5] = result.m[10] = result.m[15] = 1.0f;
+	return result;
+}
+
+inline Mat4 mat4Translation(float x, float y, float z)
+{
+	Mat4 result = mat4Identity();
+	result.m[12] = x;
+	result.m[13] = y;
+	result.m[14] = z;
+	return result;
+}
+
+inline Mat4 mat4Scale(float x, float y, float z)
+{
+	Mat4 result = mat4Identity();
+	result.m[0] = x;
+	result.m[5] = y;
+	result.m[10] = z;
+	return result;
+}
+
+// rotation about z, angle in radians
+inline Mat4 mat4RotationZ(float angle)
+{
+	Mat4 result = mat4Identity();
+	float c = cosf(angle), s = sinf(angle);
+	result.m[0] = c;
+	result.m[1] = s;
+	result.m[4] = -s;
+	result.m[5] = c;
+	return result;
+}
+
+// like glOrtho: the box maps to clip space, near and far are distances along -z
+inline Mat4 mat4Orthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+	Mat4 result = mat4Identity();
+	result.m[0] = 2.0f / (right - left);
+	result.m[5] = 2.0f / (top - bottom);
+	result.m[10] = -2.0f / (zFar - zNear);
+	result.m[12] = -(right + left) / (right - left);
+	result.m[13] = -(top + bottom) / (top - bottom);
+	result.m[14] = -(zFar + zNear) / (zFar - zNear);
+	return result;
+}
+
+// like gluPerspective: vertical field of view in radians
+inline Mat4 mat4Perspective(float fovY, float aspect, float zNear, float zFar)
+{
+	Mat4 result = {};
+	float f = 1.0f / tanf(fovY * 0.5f);
+	result.m[0] = f / aspect;
+	result.m[5] = f;
+	result.m[10] = (zFar + zNear) / (zNear - zFar);
+	result.m[11] = -1.0f;
+	result.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+	return result;
+}
+
+// out = a * b, one element at a time (the reference the SIMD version is checked against)
+inline void mat4MultiplyScalar(const Mat4& a, const Mat4& b, Mat4& out)
+{
+	Mat4 result;
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+			{
+				sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+			}
+			result.m[column * 4 + row] = sum;
+		}
+	}
+	out = result;
+}
+
+// out = a * b: every result column is a's columns weighted by one column of b (out may alias either)
+inline void mat4Multiply(const Mat4& a, const Mat4& b, Mat4& out)
+{
+#if SIMD_X86
+	__m128 a0 = _mm_load_ps(a.m), a1 = _mm_load_ps(a.m + 4), a2 = _mm_load_ps(a.m + 8), a3 = _mm_load_ps(a.m + 12);
+	__m128 columns[4];
+	for (int c = 0; c < 4; c++)
+	{
+		const float* bc = b.m + c * 4;
+		__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+		columns[c] = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		_mm_store_ps(out.m + c * 4, columns[c]);
+	}
+#elif SIMD_NEON
+	float32x4_t a0 = vld1q_f32(a.m), a1 = vld1q_f32(a.m + 4), a2 = vld1q_f32(a.m + 8), a3 = vld1q_f32(a.m + 12);
+	float32x4_t columns[4];
+	for (int c = 0; c < 4; c++)
+	{
+		float32x4_t bc = vld1q_f32(b.m + c * 4);
+		float32x4_t sum = vmulq_laneq_f32(a0, bc, 0);
+		sum = vaddq_f32(sum, vmulq_laneq_f32(a1, bc, 1));
+		sum = vaddq_f32(sum, vmulq_laneq_f32(a2, bc, 2));
+		columns[c] = vaddq_f32(sum, vmulq_laneq_f32(a3, bc, 3));
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		vst1q_f32(out.m + c * 4, columns[c]);
+	}
+#else
+	mat4MultiplyScalar(a, b, out);
+#endif
+}
+
+// out[i] = left * right[i], e.g. view-projection times every model matrix
+inline void mat4MultiplyBatch(const Mat4& left, const Mat4* right, Mat4* out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		mat4Multiply(left, right[i], out[i]);
+	}
+}
+
+inline void mat4MultiplyBatchScalar(const Mat4& left, const Mat4* right, Mat4* out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		mat4MultiplyScalar(left, right[i], out[i]);
+	}
+}
+
+// how much the matrix can grow a radius: its longest basis vector (exact for similarity transforms)
+inline float mat4MaxScale(const Mat4& matrix)
+{
+	float scale = 0.0f;
+	for (int c = 0; c < 3; c++)
+	{
+		float x = matrix.m[c * 4], y = matrix.m[c * 4 + 1], z = matrix.m[c * 4 + 2];
+		float length = sqrtf(x * x + y * y + z * z);
+		scale = length > scale ? length : scale;
+	}
+	return scale;
+}
+
+// six clip planes (ax + by + cz + d >= 0 inside), normalized so distances are real
+struct Frustum
+{
+	float planes[6][4];
+};
+
+// the rows of a view-projection combined into its planes (Gribb / Hartmann)
+inline Frustum frustumFromMatrix(const Mat4& matrix)
+{
+	Frustum frustum;
+	for (int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		float sign = p % 2 == 0 ? 1.0f : -1.0f;
+		float* plane = frustum.planes[p];
+		for (int c = 0; c < 4; c++)
+		{
+			plane[c] = matrix.m[c * 4 + 3] + sign * matrix.m[c * 4 + row];
+		}
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		length = length > 0.0f ? length : 1.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			plane[c] /= length;
+		}
+	}
+	return frustum;
+}
+
+// SoA sphere kernels
+// ------------------
+// Spheres come as separate x, y, z and radius arrays and SIMD_WIDTH of them are handled per
+// iteration, one per lane, with a scalar loop for the rest. z (and outZ) may be NULL for a flat
+// scene at z = 0, which spares the loads. Outputs may be the inputs themselves: every lane is read
+// before it is written.
+namespace simd
+{
+	template <bool FLAT>
+	inline void transformSpheres(const Mat4& matrix, const float* x, const float* y, const float* z, const float* radius,
+		float* outX, float* outY, float* outZ, float* outRadius, uint32_t count)
+	{
+		const float* m = matrix.m;
+		float scale = mat4MaxScale(matrix);
+		Floats m0 = splat(m[0]), m1 = splat(m[1]), m2 = splat(m[2]);
+		Floats m4 = splat(m[4]), m5 = splat(m[5]), m6 = splat(m[6]);
+		Floats m8 = splat(m[8]), m9 = splat(m[9]), m10 = splat(m[10]);
+		Floats m12 = splat(m[12]), m13 = splat(m[13]), m14 = splat(m[14]);
+		Floats scales = splat(scale);
+		uint32_t i = 0;
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			Floats px = load(x + i), py = load(y + i);
+			Floats rx = madd(m4, py, madd(m0, px, m12));
+			Floats ry = madd(m5, py, madd(m1, px, m13));
+			if (FLAT)
+			{
+				store(outX + i, rx);
+				store(outY + i, ry);
+			}
+			else
+			{
+				Floats pz = load(z + i);
+				Floats rz = madd(m6, py, madd(m2, px, m14));
+				store(outX + i, madd(m8, pz, rx));
+				store(outY + i, madd(m9, pz, ry));
+				store(outZ + i, madd(m10, pz, rz));
+			}
+			store(outRadius + i, mul(load(radius + i), scales));
+		}
+		for (; i < count; i++)
+		{
+			float px = x[i], py = y[i], pz = FLAT ? 0.0f : z[i];
+			outX[i] = m[8] * pz + (m[4] * py + (m[0] * px + m[12]));
+			outY[i] = m[9] * pz + (m[5] * py + (m[1] * px + m[13]));
+			if (!FLAT)
+			{
+				outZ[i] = m[10] * pz + (m[6] * py + (m[2] * px + m[14]));
+			}
+			outRadius[i] = radius[i] * scale;
+		}
+	}
+
+	// visible[i] = 1 when sphere i isn't entirely outside any plane, 0 otherwise; returns the 1s
+	template <bool FLAT>
+	inline uint32_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+		uint32_t count, uint8_t* visible)
+	{
+		Floats a[6], b[6], c[6], d[6];
+		for (int p = 0; p < 6; p++)
+		{
+			a[p] = splat(frustum.planes[p][0]);
+			b[p] = splat(frustum.planes[p][1]);
+			c[p] = splat(frustum.planes[p][2]);
+			d[p] = splat(frustum.planes[p][3]);
+		}
+		Floats zero = splat(0.0f);
+		uint32_t inside = 0;
+		uint32_t i = 0;
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			Floats px = load(x + i), py = load(y + i), pz = FLAT ? zero : load(z + i);
+			Floats limit = sub(zero, load(radius + i));
+			Mask in = greater(madd(c[0], pz, madd(b[0], py, madd(a[0], px, d[0]))), limit);
+			for (int p = 1; p < 6; p++)
+			{
+				in = both(in, greater(madd(c[p], pz, madd(b[p], py, madd(a[p], px, d[p]))), limit));
+			}
+			int laneBits = bits(in);
+			for (int lane = 0; lane < WIDTH; lane++)
+			{
+				uint8_t bit = (uint8_t)((laneBits >> lane) & 1);
+				visible[i + lane] = bit;
+				inside += bit;
+			}
+		}
+		for (; i < count; i++)
+		{
+			float px = x[i], py = y[i], pz = FLAT ? 0.0f : z[i];
+			bool in = true;
+			for (int p = 0; p < 6; p++)
+			{
+				const float* plane = frustum.planes[p];
+				in = in && plane[2] * pz + (plane[1] * py + (plane[0] * px + plane[3])) > -radius[i];
+			}
+			visible[i] = in ? 1 : 0;
+			inside += in ? 1 : 0;
+		}
+		return inside;
+	}
+}
+
+inline void transformSpheres(const Mat4& matrix, const float* x, const float* y, const float* z, const float* radius,
+	float* outX, float* outY, float* outZ, float* outRadius, uint32_t count)
+{
+	if (z == NULL)
+	{
+		simd::transformSpheres<true>(matrix, x, y, z, radius, outX, outY, outZ, outRadius, count);
+	}
+	else
+	{
+		simd::transformSpheres<false>(matrix, x, y, z, radius, outX, outY, outZ, outRadius, count);
+	}
+}
+
+inline uint32_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	uint32_t count, uint8_t* visible)
+{
+	return z == NULL ? simd::cullSpheres<true>(frustum, x, y, z, radius, count, visible)
+		: simd::cullSpheres<false>(frustum, x, y, z, radius, count, visible);
+}
+
+// the same one sphere at a time, for reference
+inline void transformSpheresScalar(const Mat4& matrix, const float* x, const float* y, const float* z, const float* radius,
+	float* outX, float* outY, float* outZ, float* outRadius, uint32_t count)
+{
+	const float* m = matrix.m;
+	float scale = mat4MaxScale(matrix);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float px = x[i], py = y[i], pz = z != NULL ? z[i] : 0.0f;
+		outX[i] = m[8] * pz + (m[4] * py + (m[0] * px + m[12]));
+		outY[i] = m[9] * pz + (m[5] * py + (m[1] * px + m[13]));
+		if (outZ != NULL)
+		{
+			outZ[i] = m[10] * pz + (m[6] * py + (m[2] * px + m[14]));
+		}
+		outRadius[i] = radius[i] * scale;
+	}
+}
+
+inline uint32_t cullSpheresScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	uint32_t count, uint8_t* visible)
+{
+	uint32_t inside = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float px = x[i], py = y[i], pz = z != NULL ? z[i] : 0.0f;
+		bool in = true;
+		for (int p = 0; p < 6; p++)
+		{
+			const float* plane = frustum.planes[p];
+			in = in && plane[2] * pz + (plane[1] * py + (plane[0] * px + plane[3])) > -radius[i];
+		}
+		visible[i] = in ? 1 : 0;
+		inside += in ? 1 : 0;
+	}
+	return inside;
+}
+
+// math benchmark: every kernel against its scalar reference
+// ----------------------------------------------------------
+// Best of REPEATS runs for each, plus the largest difference between the two results (culling
+// reports the spheres the two disagree on, which should be none). The compiler may vectorize the
+// scalar loops on its own; that only narrows the gap.
+inline void runMathBenchmark()
+{
+	typedef std::chrono::steady_clock Clock;
+	const uint32_t COUNTS[] = { 1024, 16384, 262144 };
+	const int REPEATS = 20;
+
+	printf("math kernels: %s, %d lanes\n", simd::NAME, simd::WIDTH);
+	printf("%-18s  %9s  %10s  %10s  %8s  %10s\n", "kernel", "count", "scalar ms", "simd ms", "speedup", "max diff");
+	for (uint32_t count : COUNTS)
+	{
+		std::vector<float> x(count), y(count), z(count), radius(count);
+		std::vector<float> outs[2][4];
+		std::vector<uint8_t> visible[2];
+		std::vector<Mat4> models(count), products[2];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			x[i] = sinf(i * 0.37f) * 1.6f;
+			y[i] = cosf(i * 0.11f) * 1.6f;
+			z[i] = sinf(i * 0.05f) * 8.0f - 10.0f;
+			radius[i] = 0.05f + 0.1f * (i % 7);
+			Mat4 translation = mat4Translation(x[i], y[i], z[i]);
+			mat4Multiply(translation, mat4RotationZ(i * 0.01f), models[i]);
+		}
+		for (int k = 0; k < 2; k++)
+		{
+			for (std::vector<float>& out : outs[k])
+			{
+				out.resize(count);
+			}
+			visible[k].resize(count);
+			products[k].resize(count);
+		}
+		Mat4 view = mat4Translation(0.0f, 0.0f, -2.0f);
+		Mat4 viewProjection;
+		mat4Multiply(mat4Perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f), view, viewProjection);
+		Frustum frustum = frustumFromMatrix(viewProjection);
+
+		for (int kernel = 0; kernel < 3; kernel++)
+		{
+			double best[2] = { 1e30, 1e30 };
+			for (int r = 0; r < REPEATS; r++)
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					Clock::time_point start = Clock::now();
+					if (kernel == 0)
+					{
+						(k == 0 ? mat4MultiplyBatchScalar : mat4MultiplyBatch)(viewProjection, models.data(), products[k].data(), count);
+					}
+					else if (kernel == 1)
+					{
+						(k == 0 ? transformSpheresScalar : transformSpheres)(view, x.data(), y.data(), z.data(), radius.data(),
+							outs[k][0].data(), outs[k][1].data(), outs[k][2].data(), outs[k][3].data(), count);
+					}
+					else
+					{
+						(k == 0 ? cullSpheresScalar : cullSpheres)(frustum, outs[0][0].data(), outs[0][1].data(), outs[0][2].data(),
+							outs[0][3].data(), count, visible[k].data());
+					}
+					double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+					best[k] = ms < best[k] ? ms : best[k];
+				}
+			}
+			double difference = 0.0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				for (int e = 0; kernel == 0 && e < 16; e++)
+				{
+					difference = fmax(difference, fabs(products[0][i].m[e] - products[1][i].m[e]));
+				}
+				for (int e = 0; kernel == 1 && e < 4; e++)
+				{
+					difference = fmax(difference, fabs(outs[0][e][i] - outs[1][e][i]));
+				}
+				difference += kernel == 2 && visible[0][i] != visible[1][i] ? 1.0 : 0.0;
+			}
+			const char* names[] = { "mat4 multiply", "transform spheres", "frustum cull" };
+			printf("%-18s  %9u  %10.3f  %10.3f  %7.2fx  %10g\n", names[kernel], count, best[0], best[1], best[0] / best[1], difference);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef STAGING_BUFFER_H
+#define STAGING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+#include <cstdint>
+#include <cstring>
+
+// persistently mapped upload staging
+// ----------------------------------
+// A small GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT buffer split into CHUNKS pieces. upload()
+// streams any amount of data through it one chunk at a time: memcpy into the chunk, let the GPU
+// copy it into the destination with glCopyBufferSubData, fence the chunk. A chunk is reused once
+// its fence has signalled, so the CPU touches every byte exactly once and staging memory stays at
+// CHUNKS * chunkSize regardless of how big the upload is. uploadCompressedLevel() does the same for
+// block compressed texture levels, with the buffer bound as the pixel unpack source: a level bigger
+// than a chunk goes up in bands of whole block rows. Needs GL 4.4 / ARB_buffer_storage.
+class StagingBuffer
+{
+public:
+	static const int CHUNKS = 4;
+
+	bool init(size_t bytesPerChunk = 1 << 20)
+	{
+		if (!glext::bufferStorage)
+		{
+			return false;
+		}
+		chunkSize = bytesPerChunk;
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		buffer.create(GPU_CATEGORY_STREAMING, chunkSize * CHUNKS);
+		glbuffers::storage(buffer.get(), chunkSize * CHUNKS, NULL, flags);
+		mapped = (unsigned char*)glbuffers::mapRange(buffer.get(), 0, chunkSize * CHUNKS, flags);
+
+		if (mapped == NULL)
+		{
+			buffer.reset();
+			return false;
+		}
+		return true;
+	}
+
+	void destroy()
+	{
+		for (int i = 0; i < CHUNKS; i++)
+		{
+			waitChunk(i);
+		}
+		if (buffer)
+		{
+			glbuffers::unmap(buffer.get());
+			buffer.reset();
+		}
+		mapped = NULL;
+	}
+
+	bool isAvailable() const
+	{
+		return mapped != NULL;
+	}
+
+	// copy size bytes from source into destination at offset (destination may be immutable, GPU only storage)
+	void upload(unsigned int destination, size_t offset, const void* source, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)source;
+		while (size > 0)
+		{
+			size_t count = size < chunkSize ? size : chunkSize;
+			waitChunk(next);
+			memcpy(mapped + next * chunkSize, bytes, count);
+			glbuffers::copy(buffer.get(), destination, next * chunkSize, offset, count);
+			fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			next = (next + 1) % CHUNKS;
+			bytes += count;
+			offset += count;
+			size -= count;
+		}
+	}
+
+	// one block compressed level of the texture bound to GL_TEXTURE_2D on the active unit
+	void uploadCompressedLevel(int level, uint32_t width, uint32_t height, GLenum internalFormat,
+		uint32_t blockWidth, uint32_t blockHeight, uint32_t blockBytes, const void* source)
+	{
+		const unsigned char* bytes = (const unsigned char*)source;
+		size_t rowBytes = (size_t)((width + blockWidth - 1) / blockWidth) * blockBytes;
+		uint32_t blockRows = (height + blockHeight - 1) / blockHeight;
+		if (rowBytes > chunkSize)
+		{
+			// a single row of blocks wouldn't fit a chunk: let the driver copy it from our memory
+			glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, (GLsizei)width, (GLsizei)height, internalFormat, (GLsizei)(rowBytes * blockRows), source);
+			return;
+		}
+		uint32_t rowsPerChunk = (uint32_t)(chunkSize / rowBytes);
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.get());
+		for (uint32_t row = 0; row < blockRows; row += rowsPerChunk)
+		{
+			uint32_t rows = blockRows - row < rowsPerChunk ? blockRows - row : rowsPerChunk;
+			uint32_t y = row * blockHeight;
+			uint32_t bandHeight = y + rows * blockHeight <= height ? rows * blockHeight : height - y;
+			size_t count = rows * rowBytes;
+			waitChunk(next);
+			memcpy(mapped + next * chunkSize, bytes, count);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, (GLint)y, (GLsizei)width, (GLsizei)bandHeight, internalFormat,
+				(GLsizei)count, (void*)(next * chunkSize));
+			fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			next = (next + 1) % CHUNKS;
+			bytes += count;
+		}
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+private:
+	GpuBuffer buffer;
+	unsigned char* mapped = NULL;
+	size_t chunkSize = 0;
+	GLsync fences[CHUNKS] = {};
+	int next = 0;
+
+	void waitChunk(int chunk)
+	{
+		if (fences[chunk] == NULL)
+		{
+			return;
+		}
+		// the first wait flushes so the fence is guaranteed to reach the GPU
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (glClientWaitSync(fences[chunk], flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+		{
+			flags = 0;
+		}
+		glDeleteSync(fences[chunk]);
+		fences[chunk] = NULL;
+	}
+};
+
+#endif
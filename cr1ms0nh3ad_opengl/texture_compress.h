@@ -0,0 +1,320 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include "ktx2.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// RGBA8 image, rows top to bottom
+// -------------------------------
+struct TextureImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<unsigned char> rgba;
+
+	const unsigned char* texel(uint32_t x, uint32_t y) const
+	{
+		x = x < width ? x : width - 1;
+		y = y < height ? y : height - 1;
+		return &rgba[((size_t)y * width + x) * 4];
+	}
+};
+
+// next mip level: 2x2 box filter (an odd last row / column is folded into its neighbour)
+inline TextureImage downsampleImage(const TextureImage& image)
+{
+	TextureImage result;
+	result.width = mipSize(image.width, 1);
+	result.height = mipSize(image.height, 1);
+	result.rgba.resize((size_t)result.width * result.height * 4);
+	for (uint32_t y = 0; y < result.height; y++)
+	{
+		for (uint32_t x = 0; x < result.width; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				uint32_t sum = image.texel(x * 2, y * 2)[c] + image.texel(x * 2 + 1, y * 2)[c]
+					+ image.texel(x * 2, y * 2 + 1)[c] + image.texel(x * 2 + 1, y * 2 + 1)[c];
+				result.rgba[((size_t)y * result.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return result;
+}
+
+// BC4 block (one channel, also the halves of BC5): two 8 bit endpoints and 16 3 bit indices
+// -----------------------------------------------------------------------------------------
+// Endpoints are the block's min and max stored max first, which selects the 8 value palette
+// (both ends plus six steps between); every texel takes the nearest palette entry.
+inline void encodeBC4Block(const unsigned char values[16], unsigned char out[8])
+{
+	unsigned char lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		lo = values[i] < lo ? values[i] : lo;
+		hi = values[i] > hi ? values[i] : hi;
+	}
+	out[0] = hi;
+	out[1] = lo;
+	uint64_t indices = 0;
+	if (hi > lo)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			// palette order: 0 = hi, 1 = lo, 2..7 = hi towards lo in sevenths
+			int step = (int)std::lround((float)(hi - values[i]) * 7.0f / (hi - lo));
+			uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : (uint64_t)step + 1);
+			indices |= index << (3 * i);
+		}
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		out[2 + i] = (unsigned char)(indices >> (8 * i));
+	}
+}
+
+// BC7 block in mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit each, 4 bit indices
+// ---------------------------------------------------------------------------------------------------
+// The endpoints sit on the block's principal axis (power iteration on the RGBA covariance) at the
+// extreme projections; each texel takes the nearest of the 16 interpolated colors. Mode 6 alone is
+// the usual fast preset: it handles smooth color and alpha well and loses to the multi-subset modes
+// only on blocks with several distinct colors.
+inline void encodeBC7Block(const unsigned char texels[16][4], unsigned char out[16])
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float mean[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			mean[c] += texels[i][c] / 16.0f;
+		}
+	}
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int a = 0; a < 4; a++)
+		{
+			for (int b = 0; b < 4; b++)
+			{
+				covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+			}
+		}
+	}
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (int a = 0; a < 4; a++)
+		{
+			for (int b = 0; b < 4; b++)
+			{
+				next[a] += covariance[a][b] * axis[b];
+			}
+			length += next[a] * next[a];
+		}
+		if (length < 1e-8f)
+		{
+			break;
+		}
+		length = std::sqrt(length);
+		for (int c = 0; c < 4; c++)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+	float lo = 0.0f, hi = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			t += (texels[i][c] - mean[c]) * axis[c];
+		}
+		lo = t < lo ? t : lo;
+		hi = t > hi ? t : hi;
+	}
+
+	// quantize both endpoints to 7 bits + p bit, picking the p bit that lands closer
+	int endpoints[2][4];
+	int pbits[2];
+	for (int e = 0; e < 2; e++)
+	{
+		float target[4];
+		for (int c = 0; c < 4; c++)
+		{
+			float value = mean[c] + axis[c] * (e == 0 ? lo : hi);
+			target[c] = value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+		}
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; p++)
+		{
+			int quantized[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				int q = (int)std::lround((target[c] - p) / 2.0f);
+				quantized[c] = q < 0 ? 0 : (q > 127 ? 127 : q);
+				float decoded = (float)((quantized[c] << 1) | p);
+				error += (decoded - target[c]) * (decoded - target[c]);
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				memcpy(endpoints[e], quantized, sizeof(quantized));
+			}
+		}
+	}
+
+	int palette[16][4];
+	for (int c = 0; c < 4; c++)
+	{
+		int e0 = (endpoints[0][c] << 1) | pbits[0];
+		int e1 = (endpoints[1][c] << 1) | pbits[1];
+		for (int i = 0; i < 16; i++)
+		{
+			palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+		}
+	}
+	int indices[16];
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = 1 << 30;
+		for (int p = 0; p < 16; p++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int d = texels[i][c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = p;
+			}
+		}
+		indices[i] = best;
+	}
+
+	// the first index is stored without its top bit, which must therefore be 0: swap the ends if not
+	if (indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int swap = endpoints[0][c];
+			endpoints[0][c] = endpoints[1][c];
+			endpoints[1][c] = swap;
+		}
+		int swap = pbits[0];
+		pbits[0] = pbits[1];
+		pbits[1] = swap;
+		for (int i = 0; i < 16; i++)
+		{
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	// pack LSB first: mode (bit 6 set), R0 R1 G0 G1 B0 B1 A0 A1 (7 bits each), P0, P1, indices
+	memset(out, 0, 16);
+	int bit = 0;
+	auto put = [&](uint32_t value, int bits)
+	{
+		for (int i = 0; i < bits; i++, bit++)
+		{
+			out[bit >> 3] |= (unsigned char)(((value >> i) & 1) << (bit & 7));
+		}
+	};
+	put(1u << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		put((uint32_t)endpoints[0][c], 7);
+		put((uint32_t)endpoints[1][c], 7);
+	}
+	put((uint32_t)pbits[0], 1);
+	put((uint32_t)pbits[1], 1);
+	put((uint32_t)indices[0], 3);
+	for (int i = 1; i < 16; i++)
+	{
+		put((uint32_t)indices[i], 4);
+	}
+}
+
+// encode one level in format (BC5 stores red and green, BC7 all four channels)
+inline std::vector<unsigned char> compressImage(const TextureImage& image, const TextureFormat& format)
+{
+	uint32_t blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+	std::vector<unsigned char> result((size_t)blocksX * blocksY * format.blockBytes);
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			// edge blocks of levels smaller than 4x4 repeat the last row / column
+			unsigned char texels[16][4];
+			for (int i = 0; i < 16; i++)
+			{
+				memcpy(texels[i], image.texel(bx * 4 + i % 4, by * 4 + i / 4), 4);
+			}
+			unsigned char* block = &result[((size_t)by * blocksX + bx) * format.blockBytes];
+			if (format.vkFormat == VK_FORMAT_BC7_UNORM_BLOCK || format.vkFormat == VK_FORMAT_BC7_SRGB_BLOCK)
+			{
+				encodeBC7Block(texels, block);
+				continue;
+			}
+			int channels = format.vkFormat == VK_FORMAT_BC4_UNORM_BLOCK ? 1 : 2;
+			for (int c = 0; c < channels; c++)
+			{
+				unsigned char values[16];
+				for (int i = 0; i < 16; i++)
+				{
+					values[i] = texels[i][c];
+				}
+				encodeBC4Block(values, block + 8 * c);
+			}
+		}
+	}
+	return result;
+}
+
+// the texture bake stage: full mip chain, each level block compressed, written as KTX2 (only the
+// unsigned BC4 / BC5 / BC7 formats have an encoder here)
+// -----------------------------------------------------------------------------------------------
+inline bool bakeTexture(const std::string& path, const TextureImage& image, uint32_t vkFormat)
+{
+	const TextureFormat* format = findTextureFormat(vkFormat);
+	bool encodable = vkFormat == VK_FORMAT_BC4_UNORM_BLOCK || vkFormat == VK_FORMAT_BC5_UNORM_BLOCK
+		|| vkFormat == VK_FORMAT_BC7_UNORM_BLOCK || vkFormat == VK_FORMAT_BC7_SRGB_BLOCK;
+	if (format == NULL || !encodable || image.width == 0 || image.height == 0)
+	{
+		std::cout << "ERROR::TEXTURE_BAKE::UNSUPPORTED " << path << std::endl;
+		return false;
+	}
+
+	std::vector<std::vector<unsigned char>> levels;
+	TextureImage level = image;
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < fullMipCount(image.width, image.height); i++)
+	{
+		if (i > 0)
+		{
+			level = downsampleImage(level);
+		}
+		levels.push_back(compressImage(level, *format));
+		bytes += levels.back().size();
+	}
+
+	std::cout << "TEXTURE_BAKE::" << path << " " << image.width << "x" << image.height << " " << format->name << ", "
+		<< levels.size() << " levels, " << bytes / 1024 << " KB (RGBA8 would be " << (size_t)image.width * image.height * 4 * 4 / 3 / 1024 << " KB)" << std::endl;
+	return writeTextureFile(path, *format, image.width, image.height, levels);
+}
+
+#endif
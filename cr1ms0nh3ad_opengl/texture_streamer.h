@@ -0,0 +1,399 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "frame_arena.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "ktx2.h"
+#include "staging_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// mip residency streaming for block compressed textures
+// -----------------------------------------------------
+// Every texture stays mapped from its KTX2 file and keeps a contiguous run of its finest-to-coarsest
+// chain on the GPU: levels [resident, levels) are there, so the sampler clamps to the finest one we
+// have. The small tail (levels of ALWAYS_RESIDENT_SIZE and under) is uploaded by add() and never
+// leaves, which means a texture always draws something. During the frame request() records how many
+// pixels a texture covers on screen; that picks the finest level worth having. update() then
+// plans the frame: textures used this frame move up one level at a time, biggest deficit first,
+// within uploadBytesPerFrame; when a level doesn't fit the budget, the least recently used texture
+// (or one that is now finer than it needs to be) gives up its finest level. Plain GL has no way to
+// add or drop the top of a mip chain in place (short of ARB_sparse_texture), so a residency change
+// reallocates the texture with the new chain and copies the levels that stay (GL 4.3 copy image,
+// otherwise they're uploaded again from the file); new levels go out through the staging buffer.
+// The screen-space estimate is the stand-in for sampler feedback: anything that can tell which level
+// was sampled (a feedback buffer written by the fragment shader, say) can feed request() instead.
+// With enableBindless() every texture also keeps a resident ARB_bindless_texture handle, replaced
+// along with the texture; generation() moves whenever any name or handle did. A replaced texture
+// (and its handle) is retired through gpuResources, so it goes once the frames sampling it are done.
+class TextureStreamer
+{
+public:
+	static const uint32_t INVALID_TEXTURE = 0xFFFFFFFFu;
+	static const size_t MAX_TEXTURES = 128;
+	static const uint32_t ALWAYS_RESIDENT_SIZE = 64;
+	static const unsigned int UPLOAD_UNIT = GLStateCache::TEXTURE_UNITS - 1;		// bound while (re)building, never sampled
+
+	struct Stats
+	{
+		size_t residentBytes = 0;
+		size_t budgetBytes = 0;
+		size_t fullBytes = 0;			// every level of every texture
+		size_t uploadedBytes = 0;		// this frame's new levels
+		uint32_t evictedLevels = 0;		// this frame
+		uint32_t deferredLevels = 0;	// wanted this frame, but the budget was taken by textures in use
+	};
+
+	// staging may be unavailable (no persistent mapping), levels are then uploaded from the file mapping
+	void init(StagingBuffer& stagingBuffer, size_t budgetBytes, size_t uploadBytesPerFrame)
+	{
+		staging = &stagingBuffer;
+		budget = budgetBytes;
+		uploadBudget = uploadBytesPerFrame;
+		status = Stats();
+		status.budgetBytes = budget;
+	}
+
+	// call before add(); false (and no handles) without ARB_bindless_texture
+	bool enableBindless()
+	{
+		bindless = glext::bindlessTexture;
+		return bindless;
+	}
+
+	void destroy()
+	{
+		for (Texture& texture : textures)
+		{
+			release(texture);
+			files.release(texture.file);
+		}
+		textures.clear();
+		status = Stats();
+	}
+
+	// open a texture file and upload its tail; INVALID_TEXTURE when it can't be read or the GL can't sample its format
+	uint32_t add(const std::string& path)
+	{
+		Texture texture;
+		texture.file = files.acquire();
+		if (texture.file == NULL)
+		{
+			return INVALID_TEXTURE;
+		}
+		if (!texture.file->open(path))
+		{
+			files.release(texture.file);
+			return INVALID_TEXTURE;
+		}
+		const TextureFormat& format = texture.file->format();
+		if (!isTextureFormatSupported(format))
+		{
+			std::cout << "ERROR::TEXTURE_STREAMER::FORMAT_NOT_SUPPORTED " << path << " (" << format.name << ")" << std::endl;
+			files.release(texture.file);
+			return INVALID_TEXTURE;
+		}
+
+		texture.levels = texture.file->levelCount();
+		texture.tail = texture.levels - 1;
+		while (texture.tail > 0 && largerSide(*texture.file, texture.tail - 1) <= ALWAYS_RESIDENT_SIZE)
+		{
+			texture.tail--;
+		}
+		texture.resident = texture.levels;
+		texture.wanted = texture.tail;
+		for (uint32_t level = 0; level < texture.levels; level++)
+		{
+			status.fullBytes += texture.file->levelBytes(level);
+		}
+		rebuild(texture, texture.tail);
+		status.residentBytes += residentBytes(texture, texture.resident);
+
+		textures.push_back(std::move(texture));
+		return (uint32_t)textures.size() - 1;
+	}
+
+	// this frame the texture covers about screenPixels along its larger side (call before update())
+	void request(uint32_t handle, float screenPixels)
+	{
+		if (handle >= textures.size())
+		{
+			return;
+		}
+		Texture& texture = textures[handle];
+		uint32_t size = largerSide(*texture.file, 0);
+		uint32_t level = 0;
+		if (screenPixels > 0.0f && screenPixels < (float)size)
+		{
+			level = (uint32_t)std::floor(std::log2((float)size / screenPixels));
+		}
+		else if (screenPixels <= 0.0f)
+		{
+			level = texture.tail;
+		}
+		level = level < texture.tail ? level : texture.tail;
+		texture.wanted = texture.lastUsed == frame && texture.wanted < level ? texture.wanted : level;
+		texture.lastUsed = frame;
+	}
+
+	// once per frame on the GL thread, after this frame's requests and before anything samples the
+	// textures; the plan's temporaries come from scratch and are gone again on return
+	void update(LinearArena& scratch)
+	{
+		status.uploadedBytes = 0;
+		status.evictedLevels = 0;
+		status.deferredLevels = 0;
+		for (Texture& texture : textures)
+		{
+			texture.target = texture.resident;
+		}
+
+		// without room for the plan nothing moves up this frame (the arena reports the overflow)
+		size_t marker = scratch.mark();
+		uint32_t* order = scratch.allocate<uint32_t>(textures.size());
+		uint32_t upgrades = 0;
+		for (uint32_t i = 0; order != NULL && i < textures.size(); i++)
+		{
+			if (textures[i].lastUsed == frame && textures[i].wanted < textures[i].resident)
+			{
+				order[upgrades++] = i;
+			}
+		}
+		std::sort(order, order + upgrades, [&](uint32_t a, uint32_t b)
+		{
+			return textures[a].resident - textures[a].wanted > textures[b].resident - textures[b].wanted;
+		});
+
+		size_t total = status.residentBytes;
+		size_t uploaded = 0;
+		for (uint32_t u = 0; u < upgrades; u++)
+		{
+			uint32_t handle = order[u];
+			Texture& texture = textures[handle];
+			while (texture.target > texture.wanted)
+			{
+				size_t cost = texture.file->levelBytes(texture.target - 1);
+				if (uploaded > 0 && uploaded + cost > uploadBudget)
+				{
+					break;
+				}
+				while (total + cost > budget && evictOne(handle, total))
+				{
+				}
+				if (total + cost > budget)
+				{
+					status.deferredLevels += texture.target - texture.wanted;
+					break;
+				}
+				texture.target--;
+				total += cost;
+				uploaded += cost;
+			}
+		}
+
+		for (Texture& texture : textures)
+		{
+			if (texture.target != texture.resident)
+			{
+				status.residentBytes -= residentBytes(texture, texture.resident);
+				if (texture.target < texture.resident)
+				{
+					status.uploadedBytes += residentBytes(texture, texture.target) - residentBytes(texture, texture.resident);
+				}
+				rebuild(texture, texture.target);
+				status.residentBytes += residentBytes(texture, texture.resident);
+			}
+		}
+		scratch.rewind(marker);
+		frame++;
+	}
+
+	// GL texture name to sample (0 for INVALID_TEXTURE); changes whenever residency does
+	unsigned int name(uint32_t handle) const
+	{
+		return handle < textures.size() ? textures[handle].name.get() : 0;
+	}
+
+	// resident bindless handle for name(handle), 0 without enableBindless()
+	uint64_t bindlessHandle(uint32_t handle) const
+	{
+		return handle < textures.size() ? textures[handle].bindlessHandle : 0;
+	}
+
+	uint32_t generation() const
+	{
+		return changes;
+	}
+
+	// the mapped file behind a texture (its data stays valid until destroy())
+	const TextureFile* file(uint32_t handle) const
+	{
+		return handle < textures.size() ? textures[handle].file : NULL;
+	}
+
+	// finest level on the GPU, 0 being the full size
+	uint32_t residentLevel(uint32_t handle) const
+	{
+		return handle < textures.size() ? textures[handle].resident : 0;
+	}
+
+	size_t size() const
+	{
+		return textures.size();
+	}
+
+	const Stats& stats() const
+	{
+		return status;
+	}
+
+private:
+	struct Texture
+	{
+		TextureFile* file = NULL;			// from files, so it stays put while textures grows
+		GpuTexture name;
+		uint64_t bindlessHandle = 0;
+		uint32_t levels = 0;
+		uint32_t tail = 0;			// coarsest levels from here on always stay
+		uint32_t resident = 0;		// [resident, levels) are on the GPU
+		uint32_t target = 0;		// update()'s plan for resident
+		uint32_t wanted = 0;		// finest level asked for on lastUsed
+		uint64_t lastUsed = 0;
+	};
+
+	StagingBuffer* staging = NULL;
+	std::vector<Texture> textures;
+	FixedPool<TextureFile, MAX_TEXTURES> files;
+	size_t budget = 0;
+	size_t uploadBudget = 0;
+	uint64_t frame = 1;				// 0 is "never used"
+	uint32_t changes = 0;
+	bool bindless = false;
+	Stats status;
+
+	// the GpuTexture takes the handle out of residency before the texture goes
+	void release(Texture& texture)
+	{
+		texture.name.reset();
+		texture.bindlessHandle = 0;
+	}
+
+	static uint32_t largerSide(const TextureFile& file, uint32_t level)
+	{
+		return file.width(level) > file.height(level) ? file.width(level) : file.height(level);
+	}
+
+	size_t residentBytes(const Texture& texture, uint32_t top) const
+	{
+		size_t bytes = 0;
+		for (uint32_t level = top; level < texture.levels; level++)
+		{
+			bytes += texture.file->levelBytes(level);
+		}
+		return bytes;
+	}
+
+	// plan dropping the finest planned level of the least recently used texture that can spare one
+	// (not used this frame, or finer than this frame asked for); false when none can
+	bool evictOne(uint32_t except, size_t& total)
+	{
+		uint32_t victim = INVALID_TEXTURE;
+		for (uint32_t i = 0; i < textures.size(); i++)
+		{
+			const Texture& texture = textures[i];
+			bool spare = texture.target < texture.tail && (texture.lastUsed != frame || texture.target < texture.wanted);
+			if (i == except || !spare)
+			{
+				continue;
+			}
+			if (victim == INVALID_TEXTURE || texture.lastUsed < textures[victim].lastUsed
+				|| (texture.lastUsed == textures[victim].lastUsed && texture.target < textures[victim].target))
+			{
+				victim = i;
+			}
+		}
+		if (victim == INVALID_TEXTURE)
+		{
+			return false;
+		}
+		Texture& texture = textures[victim];
+		total -= texture.file->levelBytes(texture.target);
+		texture.target++;
+		status.evictedLevels++;
+		return true;
+	}
+
+	// reallocate the texture holding levels [top, levels): keep what's already there, upload the rest
+	void rebuild(Texture& texture, uint32_t top)
+	{
+		const TextureFormat& format = texture.file->format();
+		GLsizei count = (GLsizei)(texture.levels - top);
+		GpuTexture replacement;
+		unsigned int name = replacement.create(GPU_CATEGORY_TEXTURE, residentBytes(texture, top));
+		glState.bindTexture(UPLOAD_UNIT, GL_TEXTURE_2D, name);
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (glext::textureStorage)
+		{
+			glext::TexStorage2D(GL_TEXTURE_2D, count, format.internalFormat, (GLsizei)texture.file->width(top), (GLsizei)texture.file->height(top));
+		}
+		else
+		{
+			for (uint32_t level = top; level < texture.levels; level++)
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)(level - top), format.internalFormat, (GLsizei)texture.file->width(level),
+					(GLsizei)texture.file->height(level), 0, (GLsizei)texture.file->levelBytes(level), NULL);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		for (uint32_t level = top; level < texture.levels; level++)
+		{
+			if (texture.name && level >= texture.resident && glext::copyImage)
+			{
+				glext::CopyImageSubData(texture.name.get(), GL_TEXTURE_2D, (GLint)(level - texture.resident), 0, 0, 0,
+					name, GL_TEXTURE_2D, (GLint)(level - top), 0, 0, 0,
+					(GLsizei)texture.file->width(level), (GLsizei)texture.file->height(level), 1);
+			}
+			else if (staging->isAvailable())
+			{
+				staging->uploadCompressedLevel((int)(level - top), texture.file->width(level), texture.file->height(level),
+					format.internalFormat, format.blockWidth, format.blockHeight, format.blockBytes, texture.file->levelData(level));
+			}
+			else
+			{
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)(level - top), 0, 0, (GLsizei)texture.file->width(level), (GLsizei)texture.file->height(level),
+					format.internalFormat, (GLsizei)texture.file->levelBytes(level), texture.file->levelData(level));
+			}
+		}
+
+		// the old texture is only retired: the copies above and draws of frames in flight still read it
+		texture.name = std::move(replacement);
+		texture.bindlessHandle = 0;
+		texture.resident = top;
+		if (bindless)
+		{
+			// the sampler state is frozen from here on, so the handle only comes after the parameters
+			texture.bindlessHandle = glext::GetTextureHandle(name);
+			glext::MakeTextureHandleResident(texture.bindlessHandle);
+			texture.name.setBindlessHandle(texture.bindlessHandle);
+		}
+		changes++;
+	}
+};
+
+#endif
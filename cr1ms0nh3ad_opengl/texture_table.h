@@ -0,0 +1,204 @@
+#ifndef TEXTURE_TABLE_H
+#define TEXTURE_TABLE_H
+
+#include <glad/glad.h>
+
+#include "gl_buffers.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "ktx2.h"
+#include "texture_streamer.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+enum TextureTableMode
+{
+	TEXTURE_TABLE_NONE,
+	TEXTURE_TABLE_BINDLESS,		// streamed textures, handles in an SSBO
+	TEXTURE_TABLE_ARRAY			// one GL_TEXTURE_2D_ARRAY, a layer per entry
+};
+
+inline const char* textureTableModeName(TextureTableMode mode)
+{
+	return mode == TEXTURE_TABLE_BINDLESS ? "bindless" : (mode == TEXTURE_TABLE_ARRAY ? "array" : "none");
+}
+
+// textures a shader picks by index, so a whole multi-draw samples them without a bind in between
+// -----------------------------------------------------------------------------------------------
+// Entries are TextureStreamer handles; a draw carries its entry index in its per-draw data. With
+// bindless handles (the streamer must have had enableBindless() before its add()s) the table is an
+// SSBO of 64 bit handles at HANDLES_BINDING, rewritten whenever the streamer replaced a texture, and
+// the entries keep streaming: request() forwards to the streamer. Without them the entries are baked
+// once into a 2D array on ARRAY_UNIT, from the level that fits ARRAY_MAX_SIZE down, so they have to
+// share format and size and don't stream (an array's layers all have the same mip chain). Either way
+// bind() is one call per batch, not per draw. The shader side of both is in the batch shaders (see
+// main.cpp): BINDLESS reads handles[index], otherwise the array is sampled at layer index.
+class TextureTable
+{
+public:
+	static const uint32_t NO_TEXTURE = 0xFFFFFFFFu;
+	static const unsigned int HANDLES_BINDING = 6;
+	static const unsigned int ARRAY_UNIT = 1;
+	static const uint32_t ARRAY_MAX_SIZE = 256;
+
+	bool init(TextureStreamer& textureStreamer, const std::vector<uint32_t>& streamerHandles, bool bindless)
+	{
+		streamer = &textureStreamer;
+		entries = streamerHandles;
+		tableMode = TEXTURE_TABLE_NONE;
+		if (entries.empty())
+		{
+			return false;
+		}
+		if (bindless && streamer->bindlessHandle(entries[0]) != 0)
+		{
+			handleBuffer.create(GPU_CATEGORY_TEXTURE, entries.size() * sizeof(uint64_t));
+			glbuffers::data(handleBuffer.get(), entries.size() * sizeof(uint64_t), NULL, GL_DYNAMIC_DRAW);
+			handles.resize(entries.size());
+			seenGeneration = streamer->generation() - 1;
+			tableMode = TEXTURE_TABLE_BINDLESS;
+			update();
+			return true;
+		}
+		if (buildArray())
+		{
+			tableMode = TEXTURE_TABLE_ARRAY;
+			return true;
+		}
+		return false;
+	}
+
+	void destroy()
+	{
+		handleBuffer.reset();
+		arrayTexture.reset();
+		tableMode = TEXTURE_TABLE_NONE;
+	}
+
+	TextureTableMode mode() const
+	{
+		return tableMode;
+	}
+
+	uint32_t size() const
+	{
+		return tableMode == TEXTURE_TABLE_NONE ? 0 : (uint32_t)entries.size();
+	}
+
+	// a draw shows entry across about screenPixels (bindless entries stream, array layers don't)
+	void request(uint32_t entry, float screenPixels)
+	{
+		if (tableMode == TEXTURE_TABLE_BINDLESS && entry < entries.size())
+		{
+			streamer->request(entries[entry], screenPixels);
+		}
+	}
+
+	// GL thread, after TextureStreamer::update(): pick up handles of textures it replaced
+	void update()
+	{
+		if (tableMode != TEXTURE_TABLE_BINDLESS || seenGeneration == streamer->generation())
+		{
+			return;
+		}
+		seenGeneration = streamer->generation();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			handles[i] = streamer->bindlessHandle(entries[i]);
+		}
+		glbuffers::subData(handleBuffer.get(), 0, handles.size() * sizeof(uint64_t), handles.data());
+	}
+
+	// before a draw that samples the table
+	void bind()
+	{
+		if (tableMode == TEXTURE_TABLE_BINDLESS)
+		{
+			glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, HANDLES_BINDING, handleBuffer.get(), 0, entries.size() * sizeof(uint64_t));
+		}
+		else if (tableMode == TEXTURE_TABLE_ARRAY)
+		{
+			glState.bindTexture(ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, arrayTexture.get());
+		}
+	}
+
+private:
+	TextureStreamer* streamer = NULL;
+	std::vector<uint32_t> entries;
+	TextureTableMode tableMode = TEXTURE_TABLE_NONE;
+	GpuBuffer handleBuffer;
+	std::vector<uint64_t> handles;		// sized once, so an update allocates nothing
+	uint32_t seenGeneration = 0;
+	GpuTexture arrayTexture;
+
+	bool buildArray()
+	{
+		const TextureFile* first = streamer->file(entries[0]);
+		if (first == NULL)
+		{
+			return false;
+		}
+		for (uint32_t entry : entries)
+		{
+			const TextureFile* file = streamer->file(entry);
+			if (file == NULL || file->format().vkFormat != first->format().vkFormat || file->width() != first->width()
+				|| file->height() != first->height() || file->levelCount() != first->levelCount())
+			{
+				std::cout << "ERROR::TEXTURE_TABLE::ARRAY_ENTRIES_DIFFER (an array needs one format and size)" << std::endl;
+				return false;
+			}
+		}
+
+		const TextureFormat& format = first->format();
+		uint32_t top = 0;
+		while (top + 1 < first->levelCount() && (first->width(top) > first->height(top) ? first->width(top) : first->height(top)) > ARRAY_MAX_SIZE)
+		{
+			top++;
+		}
+		GLsizei levels = (GLsizei)(first->levelCount() - top);
+		GLsizei layers = (GLsizei)entries.size();
+		arrayTexture.create(GPU_CATEGORY_TEXTURE);
+		glState.bindTexture(ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, arrayTexture.get());
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (glext::textureStorage)
+		{
+			glext::TexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format.internalFormat, (GLsizei)first->width(top), (GLsizei)first->height(top), layers);
+		}
+		else
+		{
+			for (uint32_t level = top; level < first->levelCount(); level++)
+			{
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)(level - top), format.internalFormat, (GLsizei)first->width(level),
+					(GLsizei)first->height(level), layers, 0, (GLsizei)(first->levelBytes(level) * layers), NULL);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		// a one time upload at startup, straight from the file mappings
+		size_t bytes = 0;
+		for (size_t layer = 0; layer < entries.size(); layer++)
+		{
+			const TextureFile* file = streamer->file(entries[layer]);
+			for (uint32_t level = top; level < file->levelCount(); level++)
+			{
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)(level - top), 0, 0, (GLint)layer, (GLsizei)file->width(level),
+					(GLsizei)file->height(level), 1, format.internalFormat, (GLsizei)file->levelBytes(level), file->levelData(level));
+				bytes += file->levelBytes(level);
+			}
+		}
+		arrayTexture.setBytes(bytes);
+		std::cout << "TEXTURE_TABLE::ARRAY " << layers << " layers of " << first->width(top) << "x" << first->height(top) << " "
+			<< format.name << ", " << bytes / 1024 << " KB" << std::endl;
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef VERTEX_QUANTIZE_H
+#define VERTEX_QUANTIZE_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// vertex attribute compression
+// ----------------------------
+// Bake-time packing of float attributes into the formats the vertex fetch decodes for free (half
+// floats, normalized integers), plus the little the shader has to do itself (the bounding box and
+// the octahedral normal, see shaders/include/vertex_decode.glsl). quantizeVertices (mesh_file.h)
+// repacks by attribute location, these being the ones every mesh program agrees on; 1-3 belong to
+// the sprite instances and the batch draw id.
+//   position  3 x float  12 B -> 3 x half (+2 B padding) over the bounding box      8 B
+//   normal    3 x float  12 B -> octahedral x, y as snorm10 in INT_2_10_10_10_REV    4 B
+//   uv        2 x float   8 B -> 2 x unorm16 (clamped to [0, 1])                   4 B
+//   color     4 x float  16 B -> 4 x unorm8                                        4 B
+// Anything else is copied as it is.
+const uint32_t MESH_POSITION_LOCATION = 0;
+const uint32_t MESH_NORMAL_LOCATION = 4;
+const uint32_t MESH_UV_LOCATION = 5;
+const uint32_t MESH_COLOR_LOCATION = 6;
+
+// the bounding box decode (center, extent) reaches the shader as two vertex attributes of the mesh's
+// VAO that every vertex reads the same value of (see loadMesh), so no draw path has to set uniforms
+const uint32_t MESH_POSITION_CENTER_LOCATION = 14;
+const uint32_t MESH_POSITION_EXTENT_LOCATION = 15;
+
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFFu;
+	if (((bits >> 23) & 0xFF) == 0xFF)
+	{
+		return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0));		// inf / nan
+	}
+	if (exponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00u);
+	}
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return (uint16_t)sign;
+		}
+		// subnormal: shift the implicit one in, round to nearest even
+		mantissa |= 0x800000u;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		half += rest > halfway || (rest == halfway && (half & 1)) ? 1 : 0;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFFu;
+	half += rest > 0x1000u || (rest == 0x1000u && (half & 1)) ? 1 : 0;		// may carry into the exponent, which is right
+	return (uint16_t)(sign | half);
+}
+
+inline float halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FFu;
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// subnormal: normalize
+			int shift = 0;
+			while ((mantissa & 0x400u) == 0)
+			{
+				mantissa <<= 1;
+				shift++;
+			}
+			bits = sign | ((uint32_t)(127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3FFu) << 13);
+		}
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// unit vector -> the octahedron folded onto [-1, 1]^2 (decodeNormal in the shader undoes it)
+inline void octahedralEncode(const float normal[3], float out[2])
+{
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	float x = length > 0.0f ? normal[0] / length : 0.0f;
+	float y = length > 0.0f ? normal[1] / length : 0.0f;
+	if (normal[2] < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	out[0] = x;
+	out[1] = y;
+}
+
+// x, y, z as signed normalized 10 bit, w as 2 bit, in GL_INT_2_10_10_10_REV order (x in the low bits)
+inline uint32_t packSnorm1010102(float x, float y, float z, float w)
+{
+	auto snorm = [](float value, float range, uint32_t mask)
+	{
+		value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+		return (uint32_t)(int32_t)lroundf(value * range) & mask;
+	};
+	return snorm(x, 511.0f, 0x3FFu) | (snorm(y, 511.0f, 0x3FFu) << 10) | (snorm(z, 511.0f, 0x3FFu) << 20) | (snorm(w, 1.0f, 0x3u) << 30);
+}
+
+inline uint16_t packUnorm16(float value)
+{
+	value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+	return (uint16_t)lroundf(value * 65535.0f);
+}
+
+inline uint8_t packUnorm8(float value)
+{
+	value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+	return (uint8_t)lroundf(value * 255.0f);
+}
+
+// the stored position of a quantized mesh is (position - center) / extent per axis, in [-1, 1];
+// an axis the mesh doesn't extend along (the flat z of the 2D shapes) stores 0 and has extent 0
+inline void boundsDecode(const float boundsMin[3], const float boundsMax[3], float center[3], float extent[3])
+{
+	for (int k = 0; k < 3; k++)
+	{
+		center[k] = 0.5f * (boundsMin[k] + boundsMax[k]);
+		extent[k] = 0.5f * (boundsMax[k] - boundsMin[k]);
+	}
+}
+
+#endif